@@ -24,6 +24,7 @@
 	#include <fcntl.h>
 	#include <pthread.h>
 	#include <arpa/inet.h>
+	#include <sys/mman.h>
 
 	#include <dirent.h>
 
@@ -42,6 +43,7 @@
 	#include <direct.h>
 	#include <errno.h>
 	#include <wincrypt.h>
+	#include <io.h>
 #else
 	#error NOT IMPLEMENTED
 #endif
@@ -317,6 +319,41 @@ unsigned io_write_newline(IOHANDLE io)
 #endif
 }
 
+void *io_map(IOHANDLE io, unsigned size)
+{
+	if(!size)
+		return 0;
+#if defined(CONF_FAMILY_UNIX)
+	{
+		void *data = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fileno((FILE*)io), 0);
+		return data == MAP_FAILED ? 0 : data;
+	}
+#elif defined(CONF_FAMILY_WINDOWS)
+	{
+		void *data;
+		HANDLE mapping = CreateFileMapping((HANDLE)_get_osfhandle(_fileno((FILE*)io)), NULL, PAGE_WRITECOPY, 0, size, NULL);
+		if(!mapping)
+			return 0;
+		data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, size);
+		CloseHandle(mapping);
+		return data;
+	}
+#else
+	return 0;
+#endif
+}
+
+void io_unmap(void *data, unsigned size)
+{
+	if(!data)
+		return;
+#if defined(CONF_FAMILY_UNIX)
+	munmap(data, size);
+#elif defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#endif
+}
+
 int io_close(IOHANDLE io)
 {
 	fclose((FILE*)io);
@@ -374,6 +411,20 @@ void thread_yield()
 #endif
 }
 
+int cpu_count()
+{
+#if defined(CONF_FAMILY_UNIX)
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#elif defined(CONF_FAMILY_WINDOWS)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+	return 1;
+#endif
+}
+
 void thread_sleep(int milliseconds)
 {
 #if defined(CONF_FAMILY_UNIX)
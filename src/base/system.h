@@ -296,6 +296,34 @@ long int io_tell(IOHANDLE io);
 */
 long int io_length(IOHANDLE io);
 
+/*
+	Function: io_map
+		Maps the content of a file opened for reading into memory.
+		Writes to the memory stay private to the process.
+
+	Parameters:
+		io - Handle to the file.
+		size - Number of bytes to map from the start of the file.
+
+	Returns:
+		Returns a pointer to the content or 0 if the file can't be
+		mapped, the caller has to read it then.
+
+	Remarks:
+		The mapping stays valid after the file is closed.
+*/
+void *io_map(IOHANDLE io, unsigned size);
+
+/*
+	Function: io_unmap
+		Unmaps memory returned by <io_map>.
+
+	Parameters:
+		data - Pointer returned by <io_map>.
+		size - Size that was passed to <io_map>.
+*/
+void io_unmap(void *data, unsigned size);
+
 /*
 	Function: io_close
 		Closes a file.
@@ -386,6 +414,12 @@ void thread_destroy(void *thread);
 */
 void thread_yield();
 
+/*
+	Function: cpu_count
+		Returns the number of processors that are online, at least 1.
+*/
+int cpu_count();
+
 /*
 	Function: thread_detach
 		Puts the thread in the detached thread, guaranteeing that
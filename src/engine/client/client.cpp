@@ -798,6 +798,9 @@ const char *CClient::LoadMap(const char *pName, const char *pFilename, unsigned
 		return aErrorMsg;
 	}
 
+	// the layers and images get loaded right after this
+	m_pMap->Prefetch();
+
 	// stop demo recording if we loaded a new map
 	DemoRecorder_Stop();
 
@@ -27,6 +27,8 @@ public:
 	virtual bool Load(const char *pMapName, class IKernel* pKernel) = 0;
 	virtual bool IsLoaded() = 0;
 	virtual void Unload() = 0;
+	virtual void Prefetch() = 0; // decompresses all data up front on several threads
+	virtual void Prefetch(const int *pIndices, int Num) = 0;
 	virtual unsigned Crc() = 0;
 };
 
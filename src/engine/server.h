@@ -11,8 +11,18 @@ struct sGame{
 	class IGameServer *m_pGameServer;
 	unsigned int m_uiGameID;
 	sGame* m_pNext;
+	class CInputLogRecorder *m_pInputLog;
+	class CDemoRecorder *m_pDemoRecorder;
+	class CDemoRecorder *m_pReplay;
+	class CSnapIDPool *m_pIDPool;
+
+	// a game without clients stops ticking and snapping until someone joins
+	bool m_Hibernating;
+	int m_HibernateTick;
+	int m_EmptySinceTick; // -1 while it has clients
 	
-	sGame() : m_pGameServer(0), m_uiGameID(GAME_ID_INVALID), m_pNext(0){
+	sGame() : m_pGameServer(0), m_uiGameID(GAME_ID_INVALID), m_pNext(0), m_pInputLog(0), m_pDemoRecorder(0), m_pReplay(0), m_pIDPool(0),
+		m_Hibernating(false), m_HibernateTick(0), m_EmptySinceTick(-1){
 		
 	}
 	class IGameServer *GameServer() { return m_pGameServer; }
@@ -77,6 +87,18 @@ public:
 		return SendMsg(&Packer, Flags, ClientID);
 	}
 
+	// packs the message once for all the clients, it is recorded at most once
+	virtual int SendMsgToClients(CMsgPacker *pMsg, int Flags, const int *pClientIDs, int NumClientIDs) = 0;
+
+	template<class T>
+	int SendPackMsgToClients(T *pMsg, int Flags, const int *pClientIDs, int NumClientIDs)
+	{
+		CMsgPacker Packer(pMsg->MsgID());
+		if (pMsg->Pack(&Packer))
+			return -1;
+		return SendMsgToClients(&Packer, Flags, pClientIDs, NumClientIDs);
+	}
+
 	virtual void SetClientName(int ClientID, char const *pName) = 0;
 	virtual void SetClientClan(int ClientID, char const *pClan) = 0;
 	virtual void SetClientCountry(int ClientID, int Country) = 0;
@@ -84,12 +106,21 @@ public:
 	virtual void SetClientVersion(int ClientID, int Version) = 0;
 	virtual void SetClientUnknownFlags(int ClientID, int UnknownFlags) = 0;
 
-	virtual int SnapNewID() = 0;
-	virtual void SnapFreeID(int ID) = 0;
+	// snapshot ids are allocated per game
+	virtual int SnapNewID(class IGameServer *pGameServer) = 0;
+	virtual void SnapFreeID(class IGameServer *pGameServer, int ID) = 0;
 	virtual void *SnapNewItem(int Type, int ID, int Size) = 0;
+	// items with a cost may be left out for a client over its snapshot budget, the cheapest are kept
+	virtual void *SnapNewItem(int Type, int ID, int Size, int Cost) = 0;
 
 	virtual void SnapSetStaticsize(int ItemType, int Size) = 0;
 
+	// something shown in the server browser changed
+	virtual void ExpireServerInfo() = 0;
+
+	// no client goes longer than this many ticks without a snapshot once it is ingame
+	virtual int MaxSnapInterval() const = 0;
+
 	enum
 	{
 		RCON_CID_SERV=-1,
@@ -134,6 +165,10 @@ public:
 	virtual void OnSnap(int ClientID) = 0;
 	virtual void OnPostSnap() = 0;
 
+	// the game is not ticked or snapped while it hibernates, the server tick goes on
+	virtual void OnHibernate() = 0;
+	virtual void OnWakeUp(int HibernatedTicks) = 0;
+
 	virtual void OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID) = 0;
 
 	virtual void OnClientConnected(int ClientID, int PreferedTeam = -2) = 0;
@@ -144,10 +179,15 @@ public:
 
 	virtual bool IsClientReady(int ClientID) = 0;
 	virtual bool IsClientPlayer(int ClientID) = 0;
+	// active players get every snapshot, spectators and afk players fewer
+	virtual bool IsClientActive(int ClientID) = 0;
 
 	virtual const char *GameType() = 0;
 	virtual const char *Version() = 0;
 	virtual const char *NetVersion() = 0;
+
+	// hash over the simulation state, used to verify input replays
+	virtual unsigned WorldHash() = 0;
 };
 
 extern IGameServer *CreateGameServer();
@@ -0,0 +1,384 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/storage.h>
+
+#include "inputlog.h"
+
+static const unsigned char gs_aInputLogMarker[8] = {'T', 'W', 'I', 'N', 'L', 'O', 'G', 0};
+static const unsigned char gs_InputLogVersion = 1;
+
+static void WriteBigEndian(unsigned char *pDst, unsigned Value)
+{
+	pDst[0] = (Value>>24)&0xff;
+	pDst[1] = (Value>>16)&0xff;
+	pDst[2] = (Value>>8)&0xff;
+	pDst[3] = (Value)&0xff;
+}
+
+static unsigned ReadBigEndian(const unsigned char *pSrc)
+{
+	return (pSrc[0]<<24)|(pSrc[1]<<16)|(pSrc[2]<<8)|pSrc[3];
+}
+
+CInputLogRecorder::CInputLogRecorder()
+{
+	m_File = 0;
+	m_LastTick = 0;
+	m_NumRecords = 0;
+	m_BufferSize = 0;
+}
+
+CInputLogRecorder::~CInputLogRecorder()
+{
+	Stop();
+}
+
+int CInputLogRecorder::Start(IStorage *pStorage, IConsole *pConsole, const char *pFilename, const char *pMap, unsigned MapCrc, unsigned GameID, int StartTick, unsigned Seed)
+{
+	if(m_File)
+		return -1;
+
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "unable to open '%s' for recording", pFilename);
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "inputlog", aBuf);
+		return -1;
+	}
+
+	CInputLogHeader Header;
+	mem_zero(&Header, sizeof(Header));
+	mem_copy(Header.m_aMarker, gs_aInputLogMarker, sizeof(Header.m_aMarker));
+	Header.m_Version = gs_InputLogVersion;
+	str_copy(Header.m_aMapName, pMap, sizeof(Header.m_aMapName));
+	WriteBigEndian(Header.m_aMapCrc, MapCrc);
+	WriteBigEndian(Header.m_aGameID, GameID);
+	WriteBigEndian(Header.m_aStartTick, StartTick);
+	WriteBigEndian(Header.m_aSeed, Seed);
+	str_timestamp(Header.m_aTimestamp, sizeof(Header.m_aTimestamp));
+	io_write(File, &Header, sizeof(Header));
+
+	m_File = File;
+	m_LastTick = StartTick;
+	m_NumRecords = 0;
+	m_BufferSize = 0;
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "recording inputs of game %u to '%s'", GameID, pFilename);
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "inputlog", aBuf);
+	return 0;
+}
+
+int CInputLogRecorder::Stop()
+{
+	if(!m_File)
+		return -1;
+
+	Flush();
+	io_close(m_File);
+	m_File = 0;
+	return 0;
+}
+
+void CInputLogRecorder::Flush()
+{
+	if(m_BufferSize)
+		io_write(m_File, m_aBuffer, m_BufferSize);
+	m_BufferSize = 0;
+}
+
+void CInputLogRecorder::Write(const CPacker *pPacker)
+{
+	if(pPacker->Error())
+		return;
+
+	if(m_BufferSize + pPacker->Size() > BUFFER_SIZE)
+		Flush();
+	mem_copy(m_aBuffer+m_BufferSize, pPacker->Data(), pPacker->Size());
+	m_BufferSize += pPacker->Size();
+	m_NumRecords++;
+}
+
+void CInputLogRecorder::RecordTick(int Tick)
+{
+	if(!m_File)
+		return;
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddInt(INPUTLOG_TICK);
+	Packer.AddInt(Tick-m_LastTick);
+	m_LastTick = Tick;
+	Write(&Packer);
+}
+
+void CInputLogRecorder::RecordConnect(int ClientID, int PreferedTeam, const char *pName, const char *pClan, int Country)
+{
+	if(!m_File)
+		return;
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddInt(INPUTLOG_CONNECT);
+	Packer.AddInt(ClientID);
+	Packer.AddInt(PreferedTeam);
+	Packer.AddInt(Country);
+	Packer.AddString(pName, -1);
+	Packer.AddString(pClan, -1);
+	Write(&Packer);
+}
+
+void CInputLogRecorder::RecordEnter(int ClientID)
+{
+	if(!m_File)
+		return;
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddInt(INPUTLOG_ENTER);
+	Packer.AddInt(ClientID);
+	Write(&Packer);
+}
+
+void CInputLogRecorder::RecordDrop(int ClientID, bool Force, const char *pReason)
+{
+	if(!m_File)
+		return;
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddInt(INPUTLOG_DROP);
+	Packer.AddInt(ClientID);
+	Packer.AddInt(Force ? 1 : 0);
+	Packer.AddString(pReason ? pReason : "", 128);
+	Write(&Packer);
+}
+
+void CInputLogRecorder::WriteInput(int Type, int ClientID, const int *pInput, int MaxInts)
+{
+	// trailing zeros are not stored, the replayer clears the buffer
+	int NumInts = MaxInts;
+	while(NumInts > 0 && pInput[NumInts-1] == 0)
+		NumInts--;
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddInt(Type);
+	Packer.AddInt(ClientID);
+	Packer.AddInt(NumInts);
+	for(int i = 0; i < NumInts; i++)
+		Packer.AddInt(pInput[i]);
+	Write(&Packer);
+}
+
+void CInputLogRecorder::RecordDirectInput(int ClientID, const int *pInput, int MaxInts)
+{
+	if(m_File)
+		WriteInput(INPUTLOG_DIRECT, ClientID, pInput, MaxInts);
+}
+
+void CInputLogRecorder::RecordPredictedInput(int ClientID, const int *pInput, int MaxInts)
+{
+	if(m_File)
+		WriteInput(INPUTLOG_PREDICTED, ClientID, pInput, MaxInts);
+}
+
+void CInputLogRecorder::RecordMessage(int ClientID, const void *pData, int Size)
+{
+	if(!m_File || Size <= 0 || Size > MAX_RECORD_SIZE/2)
+		return;
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddInt(INPUTLOG_MESSAGE);
+	Packer.AddInt(ClientID);
+	Packer.AddInt(Size);
+	Packer.AddRaw(pData, Size);
+	Write(&Packer);
+}
+
+void CInputLogRecorder::RecordSimulate()
+{
+	if(!m_File)
+		return;
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddInt(INPUTLOG_SIMULATE);
+	Write(&Packer);
+}
+
+void CInputLogRecorder::RecordSnap()
+{
+	if(!m_File)
+		return;
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddInt(INPUTLOG_SNAP);
+	Write(&Packer);
+}
+
+void CInputLogRecorder::RecordHash(unsigned Hash)
+{
+	if(!m_File)
+		return;
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddInt(INPUTLOG_HASH);
+	Packer.AddInt((int)Hash);
+	Write(&Packer);
+}
+
+
+CInputLogReader::CInputLogReader()
+{
+	mem_zero(&m_Header, sizeof(m_Header));
+	m_pData = 0;
+	m_DataSize = 0;
+	m_Tick = 0;
+}
+
+CInputLogReader::~CInputLogReader()
+{
+	Close();
+}
+
+int CInputLogReader::Open(IStorage *pStorage, const char *pFilename)
+{
+	Close();
+
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
+		return -1;
+
+	// io_length rewinds the file, so get it before reading anything
+	int FileSize = (int)io_length(File);
+	if(io_read(File, &m_Header, sizeof(m_Header)) != sizeof(m_Header) ||
+		mem_comp(m_Header.m_aMarker, gs_aInputLogMarker, sizeof(gs_aInputLogMarker)) != 0 ||
+		m_Header.m_Version != gs_InputLogVersion)
+	{
+		io_close(File);
+		return -1;
+	}
+	m_Header.m_aMapName[sizeof(m_Header.m_aMapName)-1] = 0;
+
+	// the whole log is kept in memory, strings are sanitized in place
+	m_DataSize = FileSize - (int)sizeof(m_Header);
+	m_pData = (unsigned char *)mem_alloc(m_DataSize > 0 ? m_DataSize : 1, 1);
+	if(m_DataSize > 0 && io_read(File, m_pData, m_DataSize) != (unsigned)m_DataSize)
+	{
+		io_close(File);
+		Close();
+		return -1;
+	}
+	io_close(File);
+
+	m_Unpacker.Reset(m_pData, m_DataSize);
+	m_Tick = StartTick();
+	return 0;
+}
+
+void CInputLogReader::Close()
+{
+	if(m_pData)
+		mem_free(m_pData);
+	m_pData = 0;
+	m_DataSize = 0;
+}
+
+bool CInputLogReader::NextRecord(CRecord *pRecord)
+{
+	if(!m_pData)
+		return false;
+
+	// running out of data at the start of a record is the regular end of the log
+	CUnpacker &Unpacker = m_Unpacker;
+	pRecord->m_Type = Unpacker.GetInt();
+	if(Unpacker.Error())
+		return false;
+	pRecord->m_ClientID = -1;
+	switch(pRecord->m_Type)
+	{
+	case INPUTLOG_TICK:
+		m_Tick += Unpacker.GetInt();
+		break;
+	case INPUTLOG_CONNECT:
+		pRecord->m_ClientID = Unpacker.GetInt();
+		pRecord->m_PreferedTeam = Unpacker.GetInt();
+		pRecord->m_Country = Unpacker.GetInt();
+		pRecord->m_pName = Unpacker.GetString(CUnpacker::SANITIZE_CC);
+		pRecord->m_pClan = Unpacker.GetString(CUnpacker::SANITIZE_CC);
+		break;
+	case INPUTLOG_ENTER:
+		pRecord->m_ClientID = Unpacker.GetInt();
+		break;
+	case INPUTLOG_DROP:
+		pRecord->m_ClientID = Unpacker.GetInt();
+		pRecord->m_Force = Unpacker.GetInt();
+		pRecord->m_pReason = Unpacker.GetString(CUnpacker::SANITIZE_CC);
+		break;
+	case INPUTLOG_DIRECT:
+	case INPUTLOG_PREDICTED:
+	{
+		pRecord->m_ClientID = Unpacker.GetInt();
+		int NumInts = Unpacker.GetInt();
+		if(NumInts < 0 || NumInts > MAX_INPUT_SIZE)
+			return false;
+		mem_zero(pRecord->m_aInput, sizeof(pRecord->m_aInput));
+		for(int i = 0; i < NumInts; i++)
+			pRecord->m_aInput[i] = Unpacker.GetInt();
+		break;
+	}
+	case INPUTLOG_MESSAGE:
+		pRecord->m_ClientID = Unpacker.GetInt();
+		pRecord->m_DataSize = Unpacker.GetInt();
+		pRecord->m_pData = Unpacker.GetRaw(pRecord->m_DataSize);
+		break;
+	case INPUTLOG_SIMULATE:
+	case INPUTLOG_SNAP:
+		break;
+	case INPUTLOG_HASH:
+		pRecord->m_Hash = (unsigned)Unpacker.GetInt();
+		break;
+	default:
+		return false;
+	}
+
+	if(Unpacker.Error())
+		return false;
+
+	// only the global records go without a client
+	bool Global = pRecord->m_Type == INPUTLOG_TICK || pRecord->m_Type == INPUTLOG_SIMULATE ||
+		pRecord->m_Type == INPUTLOG_SNAP || pRecord->m_Type == INPUTLOG_HASH;
+	if(!Global && (pRecord->m_ClientID < 0 || pRecord->m_ClientID >= MAX_CLIENTS))
+		return false;
+
+	pRecord->m_Tick = m_Tick;
+	return true;
+}
+
+unsigned CInputLogReader::MapCrc() const
+{
+	return ReadBigEndian(m_Header.m_aMapCrc);
+}
+
+unsigned CInputLogReader::GameID() const
+{
+	return ReadBigEndian(m_Header.m_aGameID);
+}
+
+int CInputLogReader::StartTick() const
+{
+	return (int)ReadBigEndian(m_Header.m_aStartTick);
+}
+
+unsigned CInputLogReader::Seed() const
+{
+	return ReadBigEndian(m_Header.m_aSeed);
+}
@@ -0,0 +1,145 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SERVER_INPUTLOG_H
+#define ENGINE_SERVER_INPUTLOG_H
+
+#include <base/system.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/protocol.h>
+
+/*
+	Input log: everything a game instance got from its clients, in the
+	order it was applied, so a round can be re-simulated offline.
+
+	Every record starts with its type, followed by packed ints:
+		TICK		tick delta
+		CONNECT		cid, prefered team, country, name, clan
+		ENTER		cid
+		DROP		cid, force, reason
+		DIRECT		cid, num ints, ints
+		PREDICTED	cid, num ints, ints
+		MESSAGE		cid, size, raw packet data
+		SIMULATE	-
+		SNAP		-
+		HASH		world hash after the tick
+
+	SIMULATE marks where OnTick ran, so drops caused by the tick itself
+	(kicks, votes) stay behind it.
+*/
+
+enum
+{
+	INPUTLOG_TICK=0,
+	INPUTLOG_CONNECT,
+	INPUTLOG_ENTER,
+	INPUTLOG_DROP,
+	INPUTLOG_DIRECT,
+	INPUTLOG_PREDICTED,
+	INPUTLOG_MESSAGE,
+	INPUTLOG_SIMULATE,
+	INPUTLOG_SNAP,
+	INPUTLOG_HASH,
+	NUM_INPUTLOG_TYPES
+};
+
+struct CInputLogHeader
+{
+	unsigned char m_aMarker[8];
+	unsigned char m_Version;
+	char m_aMapName[64];
+	unsigned char m_aMapCrc[4];
+	unsigned char m_aGameID[4];
+	unsigned char m_aStartTick[4];
+	unsigned char m_aSeed[4];
+	char m_aTimestamp[20];
+};
+
+class CInputLogRecorder
+{
+	enum
+	{
+		BUFFER_SIZE=64*1024,
+		MAX_RECORD_SIZE=4*1024,
+	};
+
+	IOHANDLE m_File;
+	int m_LastTick;
+	int m_NumRecords;
+	int m_BufferSize;
+	unsigned char m_aBuffer[BUFFER_SIZE];
+
+	void Write(const class CPacker *pPacker);
+	void WriteInput(int Type, int ClientID, const int *pInput, int MaxInts);
+	void Flush();
+
+public:
+	CInputLogRecorder();
+	~CInputLogRecorder();
+
+	int Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pMap, unsigned MapCrc, unsigned GameID, int StartTick, unsigned Seed);
+	int Stop();
+
+	void RecordTick(int Tick);
+	void RecordConnect(int ClientID, int PreferedTeam, const char *pName, const char *pClan, int Country);
+	void RecordEnter(int ClientID);
+	void RecordDrop(int ClientID, bool Force, const char *pReason);
+	void RecordDirectInput(int ClientID, const int *pInput, int MaxInts);
+	void RecordPredictedInput(int ClientID, const int *pInput, int MaxInts);
+	void RecordMessage(int ClientID, const void *pData, int Size);
+	void RecordSimulate();
+	void RecordSnap();
+	void RecordHash(unsigned Hash);
+
+	bool IsRecording() const { return m_File != 0; }
+	int NumRecords() const { return m_NumRecords; }
+};
+
+class CInputLogReader
+{
+	CInputLogHeader m_Header;
+	unsigned char *m_pData;
+	int m_DataSize;
+	CUnpacker m_Unpacker;
+	int m_Tick;
+
+public:
+	struct CRecord
+	{
+		int m_Type;
+		int m_Tick;
+		int m_ClientID;
+
+		// CONNECT, DROP
+		int m_PreferedTeam;
+		int m_Country;
+		int m_Force;
+		const char *m_pName;
+		const char *m_pClan;
+		const char *m_pReason;
+
+		// DIRECT, PREDICTED, MESSAGE
+		int m_aInput[MAX_INPUT_SIZE];
+		const void *m_pData;
+		int m_DataSize;
+
+		// HASH
+		unsigned m_Hash;
+	};
+
+	CInputLogReader();
+	~CInputLogReader();
+
+	int Open(class IStorage *pStorage, const char *pFilename);
+	void Close();
+
+	// returns false at the end of the log or on a broken record
+	bool NextRecord(CRecord *pRecord);
+
+	const char *MapName() const { return m_Header.m_aMapName; }
+	unsigned MapCrc() const;
+	unsigned GameID() const;
+	int StartTick() const;
+	unsigned Seed() const;
+};
+
+#endif
@@ -1,6 +1,8 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 
+#include <algorithm>
+
 #include <base/math.h>
 #include <base/system.h>
 
@@ -25,6 +27,8 @@
 #include <engine/shared/protocol.h>
 #include <engine/shared/snapshot.h>
 
+#include <game/mapitems.h>
+
 #include <mastersrv/mastersrv.h>
 
 #include "register.h"
@@ -64,92 +68,126 @@ sMap::~sMap() {
 	}
 }
 
-CSnapIDPool::CSnapIDPool()
+CSnapIDPool::CSnapIDPool(int ReuseDelay)
 {
+	m_pUsed = 0;
+	m_pFreed = 0;
+	m_Size = 0;
+	m_ReuseDelay = ReuseDelay;
 	Reset();
 }
 
+CSnapIDPool::~CSnapIDPool()
+{
+	mem_free(m_pUsed);
+	mem_free(m_pFreed);
+}
+
 void CSnapIDPool::Reset()
 {
-	for(int i = 0; i < MAX_IDS; i++)
+	if(m_Size != MIN_IDS)
 	{
-		m_aIDs[i].m_Next = i+1;
-		m_aIDs[i].m_State = 0;
-	}
-
-	m_aIDs[MAX_IDS-1].m_Next = -1;
-	m_FirstFree = 0;
-	m_FirstTimed = -1;
-	m_LastTimed = -1;
-	m_Usage = 0;
+		if(m_pUsed)
+			mem_free(m_pUsed);
+		if(m_pFreed)
+			mem_free(m_pFreed);
+		m_Size = MIN_IDS;
+		m_pUsed = (unsigned *)mem_alloc(m_Size/32*sizeof(unsigned), 1);
+		m_pFreed = (CFreedID *)mem_alloc(m_Size*sizeof(CFreedID), 1);
+	}
+
+	mem_zero(m_pUsed, m_Size/32*sizeof(unsigned));
+	m_FirstFreed = 0;
+	m_NumFreed = 0;
+	m_SearchWord = 0;
 	m_InUsage = 0;
+	m_HighWater = 0;
 }
 
-
-void CSnapIDPool::RemoveFirstTimeout()
+void CSnapIDPool::Grow()
 {
-	int NextTimed = m_aIDs[m_FirstTimed].m_Next;
+	int NewSize = m_Size*2;
 
-	// add it to the free list
-	m_aIDs[m_FirstTimed].m_Next = m_FirstFree;
-	m_aIDs[m_FirstTimed].m_State = 0;
-	m_FirstFree = m_FirstTimed;
+	unsigned *pUsed = (unsigned *)mem_alloc(NewSize/32*sizeof(unsigned), 1);
+	mem_zero(pUsed, NewSize/32*sizeof(unsigned));
+	mem_copy(pUsed, m_pUsed, m_Size/32*sizeof(unsigned));
 
-	// remove it from the timed list
-	m_FirstTimed = NextTimed;
-	if(m_FirstTimed == -1)
-		m_LastTimed = -1;
+	// unwrap the ring while copying it
+	CFreedID *pFreed = (CFreedID *)mem_alloc(NewSize*sizeof(CFreedID), 1);
+	for(int i = 0; i < m_NumFreed; i++)
+		pFreed[i] = m_pFreed[(m_FirstFreed+i)%m_Size];
 
-	m_Usage--;
+	mem_free(m_pUsed);
+	mem_free(m_pFreed);
+	m_pUsed = pUsed;
+	m_pFreed = pFreed;
+	m_FirstFreed = 0;
+	m_SearchWord = m_Size/32;
+	m_Size = NewSize;
 }
 
-int CSnapIDPool::NewID()
+void CSnapIDPool::ReleaseFirstFreed()
 {
-	int64 Now = time_get();
-
-	// process timed ids
-	while(m_FirstTimed != -1 && m_aIDs[m_FirstTimed].m_Timeout < Now)
-		RemoveFirstTimeout();
-
-	int ID = m_FirstFree;
-	dbg_assert(ID != -1, "id error");
-	if(ID == -1)
-		return ID;
-	m_FirstFree = m_aIDs[m_FirstFree].m_Next;
-	m_aIDs[ID].m_State = 1;
-	m_Usage++;
-	m_InUsage++;
-	return ID;
+	int ID = m_pFreed[m_FirstFreed].m_ID;
+	m_pUsed[ID/32] &= ~(1u<<(ID%32));
+	m_FirstFreed = (m_FirstFreed+1)%m_Size;
+	m_NumFreed--;
 }
 
-void CSnapIDPool::TimeoutIDs()
+int CSnapIDPool::NewID(int Tick)
 {
-	// process timed ids
-	while(m_FirstTimed != -1)
-		RemoveFirstTimeout();
+	// release the ids that waited long enough
+	while(m_NumFreed && Tick-m_pFreed[m_FirstFreed].m_Tick >= m_ReuseDelay)
+		ReleaseFirstFreed();
+
+	if(Usage() == m_Size)
+	{
+		if(m_Size < MAX_IDS)
+			Grow();
+		else if(m_NumFreed)
+			ReleaseFirstFreed();
+	}
+
+	int NumWords = m_Size/32;
+	for(int i = 0; i < NumWords; i++)
+	{
+		int Word = (m_SearchWord+i)%NumWords;
+		if(m_pUsed[Word] == 0xffffffffu)
+			continue;
+
+		int Bit = 0;
+		while(m_pUsed[Word]&(1u<<Bit))
+			Bit++;
+		m_pUsed[Word] |= 1u<<Bit;
+		m_SearchWord = Word;
+
+		m_InUsage++;
+		m_HighWater = max(m_HighWater, m_InUsage);
+		return Word*32+Bit;
+	}
+
+	dbg_assert(0, "id error");
+	return -1;
 }
 
-void CSnapIDPool::FreeID(int ID)
+void CSnapIDPool::FreeID(int ID, int Tick)
 {
 	if(ID < 0)
 		return;
-	dbg_assert(m_aIDs[ID].m_State == 1, "id is not alloced");
+	dbg_assert(ID < m_Size && (m_pUsed[ID/32]&(1u<<(ID%32))), "id is not alloced");
 
+	// every id is in the ring at most once, so it can not overflow
+	CFreedID *pFreed = &m_pFreed[(m_FirstFreed+m_NumFreed)%m_Size];
+	pFreed->m_ID = ID;
+	pFreed->m_Tick = Tick;
+	m_NumFreed++;
 	m_InUsage--;
-	m_aIDs[ID].m_State = 2;
-	m_aIDs[ID].m_Timeout = time_get()+time_freq()*5;
-	m_aIDs[ID].m_Next = -1;
+}
 
-	if(m_LastTimed != -1)
-	{
-		m_aIDs[m_LastTimed].m_Next = ID;
-		m_LastTimed = ID;
-	}
-	else
-	{
-		m_FirstTimed = ID;
-		m_LastTimed = ID;
-	}
+void CSnapIDPool::TimeoutIDs()
+{
+	while(m_NumFreed)
+		ReleaseFirstFreed();
 }
 
 
@@ -282,31 +320,93 @@ void CServerBan::ConBanExt(IConsole::IResult *pResult, void *pUser)
 }
 
 
+void CServer::CClient::CInputTiming::Reset()
+{
+	m_NumReceived = 0;
+	m_NumLate = 0;
+	m_NumDuplicate = 0;
+	m_NumMissing = 0;
+	m_NumDropped = 0;
+	m_TimeLeftSum = 0;
+	m_TimeLeftMin = 0;
+	m_TimeLeftMax = 0;
+}
+
+void CServer::CClient::CInputTiming::Add(int TimeLeft)
+{
+	if(!m_NumReceived || TimeLeft < m_TimeLeftMin)
+		m_TimeLeftMin = TimeLeft;
+	if(!m_NumReceived || TimeLeft > m_TimeLeftMax)
+		m_TimeLeftMax = TimeLeft;
+	m_TimeLeftSum += TimeLeft;
+	m_NumReceived++;
+}
+
+void CServer::CClient::CSnapRateControl::Reset()
+{
+	m_Interval = 1;
+	m_LastSnapTick = -1;
+	m_WindowStart = -1;
+	m_NumAcked = 0;
+	m_NumBytes = 0;
+}
+
+void CServer::CClient::AckSnapshot(int Tick)
+{
+	if(Tick < 0)
+	{
+		// the client lost track, the next snapshot is a full one
+		m_LastDeltaBase = -1;
+		m_NumDeltaBases = 0;
+		return;
+	}
+
+	// acks can arrive out of order
+	if(Tick < m_LastDeltaBase || (m_NumDeltaBases && Tick <= m_aDeltaBases[0]))
+		return;
+
+	m_SnapRateControl.m_NumAcked++;
+	for(int i = min(m_NumDeltaBases, (int)MAX_DELTA_BASES-1); i > 0; i--)
+		m_aDeltaBases[i] = m_aDeltaBases[i-1];
+	m_aDeltaBases[0] = Tick;
+	m_NumDeltaBases = min(m_NumDeltaBases+1, (int)MAX_DELTA_BASES);
+}
+
 void CServer::CClient::Reset()
 {
 	// reset input
-	for(int i = 0; i < 200; i++)
+	for(int i = 0; i < INPUT_WINDOW; i++)
 		m_aInputs[i].m_GameTick = -1;
-	m_CurrentInput = 0;
 	mem_zero(&m_LatestInput, sizeof(m_LatestInput));
+	m_InputTiming.Reset();
 
 	m_Snapshots.PurgeAll();
 	m_LastAckedSnapshot = -1;
 	m_LastInputTick = -1;
 	m_SnapRate = CClient::SNAPRATE_INIT;
+	m_SnapRateControl.Reset();
+	m_LastDeltaBase = -1;
+	m_NumDeltaBases = 0;
+	m_NumStarved = 0;
 	m_Score = 0;
 	m_Version = -1;
 	m_UnknownFlags = 0;
 }
 
-CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
+CServer::CServer()
 {
 	m_TickSpeed = SERVER_TICK_SPEED;
 
 	m_pGames = new sGame;
+	m_pGames->m_pIDPool = NewIDPool();
 	m_pMaps = NULL;
+	m_pWarmMaps = 0;
+	m_pMapJobs = 0;
+	m_aWarmMapsConfig[0] = 0;
+	m_pRecordGame = 0;
 
 	m_CurrentGameTick = 0;
+	m_IDPoolTick = 0;
 	m_RunServer = 1;
 	m_StopServerWhenEmpty = 0;
 
@@ -319,6 +419,9 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 	m_RconAuthLevel = AUTHED_ADMIN;
 	
 	m_PlayerCount = 0;
+	m_InputReplay = false;
+	m_NumSnapItemsDropped = 0;
+	ExpireServerInfo();
 
 	Init();
 }
@@ -354,7 +457,11 @@ int CServer::TrySetClientName(int ClientID, const char *pName)
 		}
 
 	// set the client name
-	str_copy(m_aClients[ClientID].m_aName, pName, MAX_NAME_LENGTH);
+	if(str_comp(m_aClients[ClientID].m_aName, pName) != 0)
+	{
+		str_copy(m_aClients[ClientID].m_aName, pName, MAX_NAME_LENGTH);
+		ExpireServerInfo();
+	}
 	return 0;
 }
 
@@ -397,7 +504,11 @@ void CServer::SetClientClan(int ClientID, const char *pClan)
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY || !pClan)
 		return;
 
-	str_copy(m_aClients[ClientID].m_aClan, pClan, MAX_CLAN_LENGTH);
+	if(str_comp(m_aClients[ClientID].m_aClan, pClan) != 0)
+	{
+		str_copy(m_aClients[ClientID].m_aClan, pClan, MAX_CLAN_LENGTH);
+		ExpireServerInfo();
+	}
 }
 
 void CServer::SetClientCountry(int ClientID, int Country)
@@ -405,14 +516,22 @@ void CServer::SetClientCountry(int ClientID, int Country)
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY)
 		return;
 
-	m_aClients[ClientID].m_Country = Country;
+	if(m_aClients[ClientID].m_Country != Country)
+	{
+		m_aClients[ClientID].m_Country = Country;
+		ExpireServerInfo();
+	}
 }
 
 void CServer::SetClientScore(int ClientID, int Score)
 {
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY)
 		return;
-	m_aClients[ClientID].m_Score = Score;
+	if(m_aClients[ClientID].m_Score != Score)
+	{
+		m_aClients[ClientID].m_Score = Score;
+		ExpireServerInfo();
+	}
 }
 
 void CServer::SetClientVersion(int ClientID, int Version)
@@ -565,6 +684,9 @@ bool CServer::ClientIngame(int ClientID)
 
 int CServer::MaxClients() const
 {
+	// the net server is never opened for an input replay
+	if(m_InputReplay)
+		return g_Config.m_SvMaxClients;
 	return m_NetServer.MaxClients();
 }
 
@@ -573,74 +695,243 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 	return SendMsgEx(pMsg, Flags, ClientID, false);
 }
 
-int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
+bool CServer::PrepareMsgChunk(CNetChunk *pPacket, CMsgPacker *pMsg, int Flags, bool System, int ClientID)
 {
-	CNetChunk Packet;
-	if(!pMsg)
-		return -1;
+	// nothing leaves the process while replaying an input log
+	if(m_InputReplay)
+		return false;
 
-	mem_zero(&Packet, sizeof(CNetChunk));
+	mem_zero(pPacket, sizeof(CNetChunk));
 
-	Packet.m_ClientID = ClientID;
-	Packet.m_pData = pMsg->Data();
-	Packet.m_DataSize = pMsg->Size();
+	pPacket->m_pData = pMsg->Data();
+	pPacket->m_DataSize = pMsg->Size();
 
 	// HACK: modify the message id in the packet and store the system flag
-	*((unsigned char*)Packet.m_pData) <<= 1;
+	*((unsigned char*)pPacket->m_pData) <<= 1;
 	if(System)
-		*((unsigned char*)Packet.m_pData) |= 1;
+		*((unsigned char*)pPacket->m_pData) |= 1;
 
 	if(Flags&MSGFLAG_VITAL)
-		Packet.m_Flags |= NETSENDFLAG_VITAL;
+		pPacket->m_Flags |= NETSENDFLAG_VITAL;
 	if(Flags&MSGFLAG_FLUSH)
-		Packet.m_Flags |= NETSENDFLAG_FLUSH;
+		pPacket->m_Flags |= NETSENDFLAG_FLUSH;
 
-	// write message to demo recorder
-	if(!(Flags&MSGFLAG_NORECORD))
-		m_DemoRecorder.RecordMessage(pMsg->Data(), pMsg->Size());
-
-	if(!(Flags&MSGFLAG_NOSEND))
+	// write message to the demos of its game, demo players ignore system messages
+	if(!(Flags&MSGFLAG_NORECORD) && !System)
 	{
-		if(ClientID == -1)
+		sGame *pGame = RecordGame(ClientID);
+		if(pGame)
+			RecordMessage(pGame, pMsg->Data(), pMsg->Size());
+		else if(ClientID == -1)
 		{
-			// broadcast
-			int i;
-			for(i = 0; i < MAX_CLIENTS; i++)
-				if(m_aClients[i].m_State == CClient::STATE_INGAME)
-				{
-					Packet.m_ClientID = i;
-					m_NetServer.Send(&Packet);
-				}
+			// a broadcast from outside the game callbacks (rcon, console) reaches every game
+			for(sGame *p = m_pGames; p; p = p->m_pNext)
+				RecordMessage(p, pMsg->Data(), pMsg->Size());
 		}
-		else
-			m_NetServer.Send(&Packet);
+	}
+
+	return !(Flags&MSGFLAG_NOSEND);
+}
+
+int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
+{
+	CNetChunk Packet;
+	if(!pMsg)
+		return -1;
+	if(!PrepareMsgChunk(&Packet, pMsg, Flags, System, ClientID))
+		return 0;
+
+	if(ClientID == -1)
+	{
+		// broadcast
+		int i;
+		for(i = 0; i < MAX_CLIENTS; i++)
+			if(m_aClients[i].m_State == CClient::STATE_INGAME)
+			{
+				Packet.m_ClientID = i;
+				m_NetServer.Send(&Packet);
+			}
+	}
+	else
+	{
+		Packet.m_ClientID = ClientID;
+		m_NetServer.Send(&Packet);
+	}
+	return 0;
+}
+
+int CServer::SendMsgToClients(CMsgPacker *pMsg, int Flags, const int *pClientIDs, int NumClientIDs)
+{
+	CNetChunk Packet;
+	if(!pMsg)
+		return -1;
+	if(!PrepareMsgChunk(&Packet, pMsg, Flags, false, -1))
+		return 0;
+
+	for(int i = 0; i < NumClientIDs; i++)
+	{
+		Packet.m_ClientID = pClientIDs[i];
+		m_NetServer.Send(&Packet);
 	}
 	return 0;
 }
 
+int CServer::MinSnapInterval() const
+{
+	return g_Config.m_SvHighBandwidth ? 1 : 2;
+}
+
+int CServer::MaxSnapInterval() const
+{
+	if(!g_Config.m_SvSnapRateControl)
+		return MinSnapInterval();
+	return max(MinSnapInterval(), max(g_Config.m_SvSnapIdleInterval, g_Config.m_SvSnapMaxInterval));
+}
+
+void CServer::UpdateSnapRate(int ClientID)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	CClient::CSnapRateControl *pRate = &pClient->m_SnapRateControl;
+
+	int Target = MinSnapInterval();
+	if(!g_Config.m_SvSnapRateControl)
+	{
+		pRate->m_Interval = Target;
+		return;
+	}
+
+	sGame *pGame = GetGame(pClient->m_uiGameID);
+	if(pGame && !pGame->GameServer()->IsClientActive(ClientID))
+		Target = max(Target, g_Config.m_SvSnapIdleInterval);
+
+	if(pRate->m_WindowStart < 0 || pRate->m_WindowStart > Tick())
+	{
+		pRate->m_Interval = Target;
+		pRate->m_WindowStart = Tick();
+		pRate->m_NumAcked = 0;
+		pRate->m_NumBytes = 0;
+		return;
+	}
+
+	// going idle takes effect right away, everything else once per window
+	if(Tick()-pRate->m_WindowStart < SERVER_TICK_SPEED)
+	{
+		pRate->m_Interval = max(pRate->m_Interval, Target);
+		return;
+	}
+
+	// the acks of the window are for the snapshots sent one round trip earlier
+	int RttTicks = pClient->m_Latency*SERVER_TICK_SPEED/1000;
+	int NumSent = 0;
+	for(CSnapshotStorage::CHolder *pHolder = pClient->m_Snapshots.m_pFirst; pHolder; pHolder = pHolder->m_pNext)
+		if(pHolder->m_Tick >= pRate->m_WindowStart-RttTicks && pHolder->m_Tick < Tick()-RttTicks)
+			NumSent++;
+
+	int Window = Tick()-pRate->m_WindowStart;
+	bool Lossy = NumSent >= 4 && pRate->m_NumAcked*4 < NumSent*3;
+	bool OverBudget = g_Config.m_SvSnapBandwidth && pRate->m_NumBytes*SERVER_TICK_SPEED/Window > g_Config.m_SvSnapBandwidth;
+
+	if(Lossy || OverBudget)
+		pRate->m_Interval = min(pRate->m_Interval+1, MaxSnapInterval());
+	else if(pRate->m_Interval > Target)
+		pRate->m_Interval--;
+	pRate->m_Interval = clamp(max(pRate->m_Interval, Target), MinSnapInterval(), MaxSnapInterval());
+
+	pRate->m_WindowStart = Tick();
+	pRate->m_NumAcked = 0;
+	pRate->m_NumBytes = 0;
+}
+
+bool CServer::SnapDue(int ClientID)
+{
+	CClient::CSnapRateControl *pRate = &m_aClients[ClientID].m_SnapRateControl;
+	UpdateSnapRate(ClientID);
+	return pRate->m_LastSnapTick < 0 || pRate->m_LastSnapTick > Tick() || Tick()-pRate->m_LastSnapTick >= pRate->m_Interval;
+}
+
+void CServer::LimitSnapshot(int ClientID)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	int Budget = CSnapshot::MAX_SIZE;
+	if(g_Config.m_SvSnapBudget)
+		Budget = min(Budget, g_Config.m_SvSnapBudget);
+
+	// the longer an item was held back, the cheaper it gets
+	if(pClient->m_NumStarved)
+	{
+		for(int i = 0; i < m_SnapshotBuilder.NumItems(); i++)
+		{
+			int Cost = m_SnapshotBuilder.GetItemCost(i);
+			if(Cost == CSnapshotBuilder::COST_ESSENTIAL)
+				continue;
+			int *pKey = std::lower_bound(pClient->m_aStarvedKeys, pClient->m_aStarvedKeys+pClient->m_NumStarved, m_SnapshotBuilder.GetItem(i)->Key());
+			if(pKey == pClient->m_aStarvedKeys+pClient->m_NumStarved || *pKey != m_SnapshotBuilder.GetItem(i)->Key())
+				continue;
+			int Age = Tick()-pClient->m_aStarvedSince[pKey-pClient->m_aStarvedKeys];
+			m_SnapshotBuilder.SetItemCost(i, max(Cost-Age*(int)CClient::STARVED_COST_PER_TICK, CSnapshotBuilder::COST_ESSENTIAL+1));
+		}
+	}
+
+	int aDropped[CClient::MAX_STARVED_ITEMS];
+	int NumDropped = m_SnapshotBuilder.Limit(Budget, aDropped, CClient::MAX_STARVED_ITEMS);
+	m_NumSnapItemsDropped += NumDropped;
+	NumDropped = min(NumDropped, (int)CClient::MAX_STARVED_ITEMS);
+	std::sort(aDropped, aDropped+NumDropped);
+
+	// items that are still held back keep their age
+	int aSince[CClient::MAX_STARVED_ITEMS];
+	for(int i = 0, s = 0; i < NumDropped; i++)
+	{
+		while(s < pClient->m_NumStarved && pClient->m_aStarvedKeys[s] < aDropped[i])
+			s++;
+		aSince[i] = s < pClient->m_NumStarved && pClient->m_aStarvedKeys[s] == aDropped[i] ? pClient->m_aStarvedSince[s] : Tick();
+	}
+	mem_copy(pClient->m_aStarvedKeys, aDropped, NumDropped*sizeof(int));
+	mem_copy(pClient->m_aStarvedSince, aSince, NumDropped*sizeof(int));
+	pClient->m_NumStarved = NumDropped;
+}
+
 void CServer::DoSnapshot()
 {
 	sGame* p = m_pGames;
 	while(p != NULL){	
-		p->GameServer()->OnPreSnap();
+		if(!p->m_Hibernating) {
+			if(p->m_pInputLog) p->m_pInputLog->RecordSnap();
+			p->GameServer()->OnPreSnap();
+		}
 		p = p->m_pNext;
 	}
 
-	// create snapshot for demo recording
-	if(m_DemoRecorder.IsRecording())
+	// create snapshots for the demos of each game, at the global rate
+	if(g_Config.m_SvHighBandwidth || (m_CurrentGameTick%2) == 0)
 	{
-		char aData[CSnapshot::MAX_SIZE];
-		int SnapshotSize;
+		for(p = m_pGames; p; p = p->m_pNext)
+		{
+			bool Recording = p->m_pDemoRecorder && p->m_pDemoRecorder->IsRecording();
+			if((!Recording && !p->m_pReplay) || p->m_Hibernating)
+				continue;
 
-		// build snap and possibly add some messages
-		m_SnapshotBuilder.Init();
-		GameServer()->OnSnap(-1);
-		SnapshotSize = m_SnapshotBuilder.Finish(aData);
+			char aData[CSnapshot::MAX_SIZE];
+			int SnapshotSize;
 
-		// write snapshot
-		m_DemoRecorder.RecordSnapshot(Tick(), aData, SnapshotSize);
+			// build snap and possibly add some messages
+			m_pRecordGame = p;
+			m_SnapshotBuilder.Init();
+			p->GameServer()->OnSnap(-1);
+			SnapshotSize = m_SnapshotBuilder.Finish(aData);
+			m_pRecordGame = 0;
+
+			// write snapshot
+			if(Recording)
+				p->m_pDemoRecorder->RecordSnapshot(Tick(), aData, SnapshotSize);
+			if(p->m_pReplay)
+				p->m_pReplay->RecordSnapshot(Tick(), aData, SnapshotSize);
+		}
 	}
 
+	// snapshot parts are sent by the flush after the tick, together with anything else queued
+	int SnapFlags = g_Config.m_SvCoalescePackets ? 0 : MSGFLAG_FLUSH;
+
 	// create snapshots for all clients
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
@@ -656,16 +947,19 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick()%(10*SERVER_TICK_SPEED/50)) != 0)
 			continue;
 
+		if(!SnapDue(i))
+			continue;
+
 		{
 			char aData[CSnapshot::MAX_SIZE];
 			CSnapshot *pData = (CSnapshot*)aData;	// Fix compiler warning for strict-aliasing
 			char aDeltaData[CSnapshot::MAX_SIZE];
+			char aTryDeltaData[CSnapshot::MAX_SIZE];
 			char aCompData[CSnapshot::MAX_SIZE];
 			int SnapshotSize;
 			int Crc;
 			static CSnapshot EmptySnap;
 			CSnapshot *pDeltashot = &EmptySnap;
-			int DeltashotSize;
 			int DeltaTick = -1;
 			int DeltaSize;
 
@@ -673,6 +967,7 @@ void CServer::DoSnapshot()
 
 			sGame* p = GetGame(m_aClients[i].m_uiGameID);
 			if(p != NULL) p->GameServer()->OnSnap(i);
+			LimitSnapshot(i);
 
 			// finish snapshot
 			SnapshotSize = m_SnapshotBuilder.Finish(pData);
@@ -688,20 +983,49 @@ void CServer::DoSnapshot()
 			// find snapshot that we can preform delta against
 			EmptySnap.Clear();
 
+			// of the acked snapshots the client still has, use the one giving the smallest delta
+			char *pDeltaData = aDeltaData;
+			char *pTryDeltaData = aTryDeltaData;
+			DeltaSize = -1;
+			for(int b = 0; b < m_aClients[i].m_NumDeltaBases; b++)
 			{
-				DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
-				else
+				CSnapshot *pBase;
+				int BaseTick = m_aClients[i].m_aDeltaBases[b];
+				if(m_aClients[i].m_Snapshots.Get(BaseTick, 0, &pBase, 0) < 0)
+					continue;
+
+				int Size = m_SnapshotDelta.CreateDelta(pBase, pData, pTryDeltaData);
+				if(DeltaSize < 0 || Size < DeltaSize)
+				{
+					DeltaSize = Size;
+					DeltaTick = BaseTick;
+					char *pTemp = pDeltaData;
+					pDeltaData = pTryDeltaData;
+					pTryDeltaData = pTemp;
+				}
+			}
+
+			if(DeltaTick >= 0)
+			{
+				// the client purges everything older than the base once it gets this snapshot
+				if(DeltaTick > m_aClients[i].m_LastDeltaBase)
 				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
+					m_aClients[i].m_LastDeltaBase = DeltaTick;
+					while(m_aClients[i].m_NumDeltaBases && m_aClients[i].m_aDeltaBases[m_aClients[i].m_NumDeltaBases-1] < DeltaTick)
+						m_aClients[i].m_NumDeltaBases--;
 				}
 			}
+			else
+			{
+				// no acked package found, force client to recover rate
+				if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
+					m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
+
+				// create delta
+				DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, pDeltaData);
+			}
 
-			// create delta
-			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+			m_aClients[i].m_SnapRateControl.m_LastSnapTick = m_CurrentGameTick;
 
 			if(DeltaSize)
 			{
@@ -710,8 +1034,9 @@ void CServer::DoSnapshot()
 				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
 				int NumPackets;
 
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData);
+				SnapshotSize = CVariableInt::Compress(pDeltaData, DeltaSize, aCompData);
 				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
+				m_aClients[i].m_SnapRateControl.m_NumBytes += SnapshotSize;
 
 				for(int n = 0, Left = SnapshotSize; Left; n++)
 				{
@@ -726,7 +1051,7 @@ void CServer::DoSnapshot()
 						Msg.AddInt(Crc);
 						Msg.AddInt(Chunk);
 						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
+						SendMsgEx(&Msg, SnapFlags, i, true);
 					}
 					else
 					{
@@ -738,7 +1063,7 @@ void CServer::DoSnapshot()
 						Msg.AddInt(Crc);
 						Msg.AddInt(Chunk);
 						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
+						SendMsgEx(&Msg, SnapFlags, i, true);
 					}
 				}
 			}
@@ -747,14 +1072,14 @@ void CServer::DoSnapshot()
 				CMsgPacker Msg(NETMSG_SNAPEMPTY);
 				Msg.AddInt(m_CurrentGameTick);
 				Msg.AddInt(m_CurrentGameTick-DeltaTick);
-				SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
+				SendMsgEx(&Msg, SnapFlags, i, true);
 			}
 		}
 	}
 
 	p = m_pGames;
 	while(p != NULL){
-		p->GameServer()->OnPostSnap();
+		if(!p->m_Hibernating) p->GameServer()->OnPostSnap();
 		p = p->m_pNext;
 	}
 }
@@ -775,6 +1100,7 @@ int CServer::NewClientCallbackImpl(int ClientID, void *pUser)
 	pThis->m_aClients[ClientID].Reset();
 
 	++pThis->m_PlayerCount;
+	pThis->ExpireServerInfo();
 
 	return 0;
 }
@@ -806,8 +1132,12 @@ int CServer::DelClientCallback(int ClientID, const char *pReason, void *pUser, b
 	// notify the mod about the drop, if the mod says, that the connection can't be free'd, we don't drop the connection
 	if(pThis->m_aClients[ClientID].m_State >= CClient::STATE_READY) {
 		sGame* p = pThis->GetGame(pThis->m_aClients[ClientID].m_uiGameID);
-		if(p != NULL) 
+		if(p != NULL) {
+			if(p->m_pInputLog) p->m_pInputLog->RecordDrop(ClientID, ForceDisconnect, pReason);
+			pThis->m_pRecordGame = p;
 			CanDrop = p->GameServer()->OnClientDrop(ClientID, pReason, ForceDisconnect);
+			pThis->m_pRecordGame = 0;
+		}
 		
 	}
 
@@ -819,6 +1149,7 @@ int CServer::DelClientCallback(int ClientID, const char *pReason, void *pUser, b
 		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
 
 		pThis->m_aClients[ClientID].m_State = CClient::STATE_EMPTY;
+		pThis->ExpireServerInfo();
 		pThis->m_aClients[ClientID].m_aName[0] = 0;
 		pThis->m_aClients[ClientID].m_aClan[0] = 0;
 		pThis->m_aClients[ClientID].m_Country = -1;
@@ -1117,12 +1448,18 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
 				m_aClients[ClientID].m_State = CClient::STATE_READY;
 				if(m_aClients[ClientID].m_uiGameID == GAME_ID_INVALID) {
+					if(m_pGames->m_pInputLog) m_pGames->m_pInputLog->RecordConnect(ClientID, m_aClients[ClientID].m_PreferedTeam, m_aClients[ClientID].m_aName, m_aClients[ClientID].m_aClan, m_aClients[ClientID].m_Country);
+					WakeGame(m_pGames);
 					GameServer()->OnClientConnected(ClientID, m_aClients[ClientID].m_PreferedTeam);
 					m_aClients[ClientID].m_uiGameID = 0;
 				}
 				else {		
 					sGame* p = GetGame(m_aClients[ClientID].m_uiGameID);
-					if(p != NULL) p->GameServer()->OnClientConnected(ClientID, m_aClients[ClientID].m_PreferedTeam);					
+					if(p != NULL) {
+						WakeGame(p);
+						if(p->m_pInputLog) p->m_pInputLog->RecordConnect(ClientID, m_aClients[ClientID].m_PreferedTeam, m_aClients[ClientID].m_aName, m_aClients[ClientID].m_aClan, m_aClients[ClientID].m_Country);
+						p->GameServer()->OnClientConnected(ClientID, m_aClients[ClientID].m_PreferedTeam);
+					}
 				}
 				SendConnectionReady(ClientID);
 			}
@@ -1142,16 +1479,22 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 					char aBuf[256];
 					str_format(aBuf, sizeof(aBuf), "player has entered the game. ClientID=%x addr=%s", ClientID, aAddrStr);
 					Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
-					m_aClients[ClientID].m_State = CClient::STATE_INGAME;					
+					m_aClients[ClientID].m_State = CClient::STATE_INGAME;
+					ExpireServerInfo();
 				
 					sGame* p = GetGame(m_aClients[ClientID].m_uiGameID);
-					if(p != NULL) p->GameServer()->OnClientEnter(ClientID);
+					if(p != NULL) {
+						if(p->m_pInputLog) p->m_pInputLog->RecordEnter(ClientID);
+						m_pRecordGame = p;
+						p->GameServer()->OnClientEnter(ClientID);
+						m_pRecordGame = 0;
+					}
 				}
 			}
 		}
 		else if(Msg == NETMSG_INPUT)
 		{
-			CClient::CInput *pInput;
+			CClient *pClient = &m_aClients[ClientID];
 			int64 TagTime;
 
 			m_aClients[ClientID].m_LastAckedSnapshot = Unpacker.GetInt();
@@ -1164,15 +1507,17 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 
 			if(m_aClients[ClientID].m_LastAckedSnapshot > 0)
 				m_aClients[ClientID].m_SnapRate = CClient::SNAPRATE_FULL;
+			m_aClients[ClientID].AckSnapshot(m_aClients[ClientID].m_LastAckedSnapshot);
 
 			if(m_aClients[ClientID].m_Snapshots.Get(m_aClients[ClientID].m_LastAckedSnapshot, &TagTime, 0, 0) >= 0)
 				m_aClients[ClientID].m_Latency = (int)(((time_get()-TagTime)*1000)/time_freq());
 
 			// add message to report the input timing
 			// skip packets that are old
-			if(IntendedTick > m_aClients[ClientID].m_LastInputTick)
+			if(IntendedTick > pClient->m_LastInputTick)
 			{
 				int TimeLeft = ((TickStartTime(IntendedTick)-time_get())*1000) / time_freq();
+				pClient->m_InputTiming.Add(TimeLeft);
 
 				CMsgPacker Msg(NETMSG_INPUTTIMING);
 				Msg.AddInt(IntendedTick);
@@ -1180,27 +1525,40 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				SendMsgEx(&Msg, 0, ClientID, true);
 			}
 
-			m_aClients[ClientID].m_LastInputTick = IntendedTick;
-
-			pInput = &m_aClients[ClientID].m_aInputs[m_aClients[ClientID].m_CurrentInput];
-
-			if(IntendedTick <= Tick())
-				IntendedTick = Tick()+1;
-
-			pInput->m_GameTick = IntendedTick;
+			pClient->m_LastInputTick = IntendedTick;
 
+			mem_zero(pClient->m_LatestInput.m_aData, sizeof(pClient->m_LatestInput.m_aData));
 			for(int i = 0; i < Size/4; i++)
-				pInput->m_aData[i] = Unpacker.GetInt();
+				pClient->m_LatestInput.m_aData[i] = Unpacker.GetInt();
 
-			mem_copy(m_aClients[ClientID].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE*sizeof(int));
+			// queue the input in the slot of the tick it gets applied on
+			bool Late = IntendedTick <= Tick();
+			if(Late)
+			{
+				IntendedTick = Tick()+1;
+				pClient->m_InputTiming.m_NumLate++;
+			}
 
-			m_aClients[ClientID].m_CurrentInput++;
-			m_aClients[ClientID].m_CurrentInput %= 200;
+			if(IntendedTick - Tick() > CClient::INPUT_WINDOW)
+				pClient->m_InputTiming.m_NumDropped++;
+			else if(!pClient->GetInput(IntendedTick) || !Late)
+			{
+				CClient::CInput *pInput = &pClient->m_aInputs[IntendedTick%CClient::INPUT_WINDOW];
+				if(pInput->m_GameTick == IntendedTick)
+					pClient->m_InputTiming.m_NumDuplicate++;
+				pInput->m_GameTick = IntendedTick;
+				mem_copy(pInput->m_aData, pClient->m_LatestInput.m_aData, sizeof(pInput->m_aData));
+			}
+			else
+				pClient->m_InputTiming.m_NumDuplicate++;
 
 			// call the mod with the fresh input data
 			if(m_aClients[ClientID].m_State == CClient::STATE_INGAME) {		
 				sGame* p = GetGame(m_aClients[ClientID].m_uiGameID);
-				if(p != NULL) p->GameServer()->OnClientDirectInput(ClientID, m_aClients[ClientID].m_LatestInput.m_aData);
+				if(p != NULL) {
+					if(p->m_pInputLog) p->m_pInputLog->RecordDirectInput(ClientID, m_aClients[ClientID].m_LatestInput.m_aData, MAX_INPUT_SIZE);
+					p->GameServer()->OnClientDirectInput(ClientID, m_aClients[ClientID].m_LatestInput.m_aData);
+				}
 			}
 		}
 		else if(Msg == NETMSG_RCON_CMD)
@@ -1317,15 +1675,18 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 		// game message
 		if((pPacket->m_Flags&NET_CHUNKFLAG_VITAL) != 0 && m_aClients[ClientID].m_State >= CClient::STATE_READY){
 			sGame* p = GetGame(m_aClients[ClientID].m_uiGameID);
-			if(p != NULL) p->GameServer()->OnMessage(Msg, &Unpacker, ClientID);
+			if(p != NULL) {
+				if(p->m_pInputLog) p->m_pInputLog->RecordMessage(ClientID, pPacket->m_pData, pPacket->m_DataSize);
+				m_pRecordGame = p;
+				p->GameServer()->OnMessage(Msg, &Unpacker, ClientID);
+				m_pRecordGame = 0;
+			}
 		}
 	}
 }
 
-void CServer::SendServerInfo(const NETADDR *pAddr, int Token, bool Extended)
+void CServer::PackServerInfo(CPacker *pPacker, bool Extended)
 {
-	CNetChunk Packet;
-	CPacker p;
 	char aBuf[128];
 
 	// count the players
@@ -1335,8 +1696,8 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, bool Extended)
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
 		{
 			bool InGame = false;
-			sGame* p = GetGame(m_aClients[i].m_uiGameID);
-			if(p != NULL) InGame = p->GameServer()->IsClientPlayer(i);
+			sGame* g = GetGame(m_aClients[i].m_uiGameID);
+			if(g != NULL) InGame = g->GameServer()->IsClientPlayer(i);
 			if(InGame)
 				PlayerCount++;
 
@@ -1344,50 +1705,42 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, bool Extended)
 		}
 	}
 
-	p.Reset();
-
 	int MaxClients = m_NetServer.MaxClients();
 
-	if(Extended) p.AddRaw(SERVERBROWSE_INFO64, sizeof(SERVERBROWSE_INFO64));
-	else p.AddRaw(SERVERBROWSE_INFO, sizeof(SERVERBROWSE_INFO));
-
-	str_format(aBuf, sizeof(aBuf), "%d", Token);
-	p.AddString(aBuf, 6);
-
-	p.AddString(GameServer()->Version(), 32); 
+	pPacker->AddString(GameServer()->Version(), 32); 
 	//ddnet code
 	if (Extended)
 	{
 		if (m_NetServer.MaxClients() <= DDNET_MAX_CLIENTS){
-			p.AddString(g_Config.m_SvName, 256);
+			pPacker->AddString(g_Config.m_SvName, 256);
 		} else
 		{
 			str_format(aBuf, sizeof(aBuf), "%s [%d/%d]", g_Config.m_SvName, ClientCount, m_NetServer.MaxClients());
-			p.AddString(aBuf, 256);
+			pPacker->AddString(aBuf, 256);
 		}
 	}
 	else
 	{
 		if (m_NetServer.MaxClients() <= VANILLA_MAX_CLIENTS)
-			p.AddString(g_Config.m_SvName, 64);
+			pPacker->AddString(g_Config.m_SvName, 64);
 		else
 		{
 			// 									v support 32 slots or more than 64
 			str_format(aBuf, sizeof(aBuf), "%s 64+[%d/%d]", g_Config.m_SvName, ClientCount, m_NetServer.MaxClients());
-			p.AddString(aBuf, 64);
+			pPacker->AddString(aBuf, 64);
 		}
 	}
-	p.AddString(GetMapName(), 32);
+	pPacker->AddString(GetMapName(), 32);
 
 	// gametype
-	p.AddString(GameServer()->GameType(), 16);
+	pPacker->AddString(GameServer()->GameType(), 16);
 
 	// flags
 	int i = 0;
 	if(g_Config.m_Password[0]) // password set
 		i |= SERVER_FLAG_PASSWORD;
 	str_format(aBuf, sizeof(aBuf), "%d", i);
-	p.AddString(aBuf, 2);
+	pPacker->AddString(aBuf, 2);
 
 	//Ddnet.tw code
 	if (!Extended)
@@ -1415,14 +1768,14 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, bool Extended)
 	if (PlayerCount > ClientCount)
 		PlayerCount = ClientCount;
 
-	str_format(aBuf, sizeof(aBuf), "%d", PlayerCount); p.AddString(aBuf, 3); // num players
-	str_format(aBuf, sizeof(aBuf), "%d", ((m_NetServer.MaxClients() - g_Config.m_SvSpectatorSlots) > MaxClients) ? MaxClients : (m_NetServer.MaxClients() - g_Config.m_SvSpectatorSlots)); p.AddString(aBuf, 3); // max players
-	str_format(aBuf, sizeof(aBuf), "%d", ClientCount); p.AddString(aBuf, 3); // num clients
-	str_format(aBuf, sizeof(aBuf), "%d", MaxClients); p.AddString(aBuf, 3); // max clients
+	str_format(aBuf, sizeof(aBuf), "%d", PlayerCount); pPacker->AddString(aBuf, 3); // num players
+	str_format(aBuf, sizeof(aBuf), "%d", ((m_NetServer.MaxClients() - g_Config.m_SvSpectatorSlots) > MaxClients) ? MaxClients : (m_NetServer.MaxClients() - g_Config.m_SvSpectatorSlots)); pPacker->AddString(aBuf, 3); // max players
+	str_format(aBuf, sizeof(aBuf), "%d", ClientCount); pPacker->AddString(aBuf, 3); // num clients
+	str_format(aBuf, sizeof(aBuf), "%d", MaxClients); pPacker->AddString(aBuf, 3); // max clients
 
 	//ddnet code
 	if (Extended)
-		p.AddInt(0);
+		pPacker->AddInt(0);
 
 	int count = 0;
 	for(i = 0; i < MAX_CLIENTS; i++)
@@ -1433,16 +1786,43 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, bool Extended)
 			if (Extended && count >= DDNET_MAX_CLIENTS) break;
 			++count;
 
-			p.AddString(ClientName(i), MAX_NAME_LENGTH); // client name
-			p.AddString(ClientClan(i), MAX_CLAN_LENGTH); // client clan
-			str_format(aBuf, sizeof(aBuf), "%d", m_aClients[i].m_Country); p.AddString(aBuf, 6); // client country
-			str_format(aBuf, sizeof(aBuf), "%d", m_aClients[i].m_Score); p.AddString(aBuf, 6); // client score
+			pPacker->AddString(ClientName(i), MAX_NAME_LENGTH); // client name
+			pPacker->AddString(ClientClan(i), MAX_CLAN_LENGTH); // client clan
+			str_format(aBuf, sizeof(aBuf), "%d", m_aClients[i].m_Country); pPacker->AddString(aBuf, 6); // client country
+			str_format(aBuf, sizeof(aBuf), "%d", m_aClients[i].m_Score); pPacker->AddString(aBuf, 6); // client score
 			bool InGame = false;
 			sGame* g = GetGame(m_aClients[i].m_uiGameID);
 			if(g != NULL) InGame = g->GameServer()->IsClientPlayer(i);
-			str_format(aBuf, sizeof(aBuf), "%d", InGame?1:0); p.AddString(aBuf, 2); // is player?
+			str_format(aBuf, sizeof(aBuf), "%d", InGame?1:0); pPacker->AddString(aBuf, 2); // is player?
 		}
 	}
+}
+
+void CServer::SendServerInfo(const NETADDR *pAddr, int Token, bool Extended)
+{
+	CServerInfoCache *pCache = &m_aServerInfoCache[Extended ? 1 : 0];
+	if(!pCache->m_Valid)
+	{
+		CPacker Info;
+		Info.Reset();
+		PackServerInfo(&Info, Extended);
+		mem_copy(pCache->m_aData, Info.Data(), Info.Size());
+		pCache->m_Size = Info.Size();
+		pCache->m_Valid = true;
+	}
+
+	// only the token differs between the responses
+	CNetChunk Packet;
+	CPacker p;
+	char aBuf[16];
+
+	p.Reset();
+	if(Extended) p.AddRaw(SERVERBROWSE_INFO64, sizeof(SERVERBROWSE_INFO64));
+	else p.AddRaw(SERVERBROWSE_INFO, sizeof(SERVERBROWSE_INFO));
+
+	str_format(aBuf, sizeof(aBuf), "%d", Token);
+	p.AddString(aBuf, 6);
+	p.AddRaw(pCache->m_aData, pCache->m_Size);
 
 	Packet.m_ClientID = -1;
 	Packet.m_Address = *pAddr;
@@ -1452,8 +1832,33 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, bool Extended)
 	m_NetServer.Send(&Packet);
 }
 
+bool CServer::ServerInfoRateLimited(const NETADDR *pAddr)
+{
+	if(!g_Config.m_SvServerInfoPerSecond)
+		return false;
+
+	CNetAddrTable::CEntry *pEntry = m_ServerInfoRequests.Find(pAddr, Tick());
+	if(!pEntry)
+	{
+		// a flood of new (spoofed) addresses gets no answers instead of growing the table
+		if(m_ServerInfoRequests.Num() >= MAX_SERVERINFO_REQUEST_ADDRS)
+			m_ServerInfoRequests.Expire(Tick(), 0, 0);
+		if(m_ServerInfoRequests.Num() >= MAX_SERVERINFO_REQUEST_ADDRS)
+			return true;
+		pEntry = m_ServerInfoRequests.Set(pAddr, Tick()+TickSpeed(), 0);
+	}
+	return pEntry->m_Data++ >= g_Config.m_SvServerInfoPerSecond;
+}
+
+void CServer::ExpireServerInfo()
+{
+	m_aServerInfoCache[0].m_Valid = false;
+	m_aServerInfoCache[1].m_Valid = false;
+}
+
 void CServer::UpdateServerInfo()
 {
+	ExpireServerInfo();
 	for(int i = 0; i < MAX_CLIENTS; ++i)
 	{
 		if (m_aClients[i].m_State != CClient::STATE_EMPTY) {
@@ -1494,7 +1899,7 @@ void CServer::PumpNetwork()
 					ServerInfo = true;
 					Extended = true;
 				}
-				if (ServerInfo) {
+				if (ServerInfo && !ServerInfoRateLimited(&Packet.m_Address)) {
 
 					SendServerInfo(&Packet.m_Address, ((unsigned char *)Packet.m_pData)[sizeof(SERVERBROWSE_GETINFO)], Extended);
 				}
@@ -1633,10 +2038,7 @@ int CServer::LoadMap(const char *pMapName)
 		return 0;
 
 	// stop recording when we change map
-	m_DemoRecorder.Stop();
-
-	// reinit snapshot ids
-	m_IDPool.TimeoutIDs();
+	DemoStop(m_pGames);
 
 	// get the crc of the map
 	m_CurrentMapCrc = m_pMap->Crc();
@@ -1660,81 +2062,201 @@ int CServer::LoadMap(const char *pMapName)
 	return 1;
 }
 
-IMap* CServer::LoadAndGetMap(const char *pMapName, unsigned int pGameID)
+sMap *CServer::PrepareMap(const char *pMapName)
 {
-	IEngineMap *pEngineMap = CreateEngineMap();
-
-	//DATAFILE *df;
+	// also runs on the job pool, so only the storage and the new map are touched here.
+	// the layers and the collision are built by the game's OnInit on the main thread
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
 
-	/*df = datafile_load(buf);
-	if(!df)
-	return 0;*/
-
-	// check for valid standard map
-	if (!m_MapChecker.ReadAndValidateMap(Storage(), aBuf, IStorage::TYPE_ALL))
-	{
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapchecker", "invalid standard map");
-		return 0;
-	}
-
-	if (!pEngineMap->Load(aBuf, Kernel()))
+	IEngineMap *pEngineMap = CreateEngineMap();
+	if(!pEngineMap->Load(aBuf, Kernel()))
 	{
 		delete pEngineMap;
 		return 0;
 	}
 
-	sMap* map = m_pMaps;
-	if (map == NULL) {
-		map = new sMap;
-		m_pMaps = map;
-	}
-	else {
-		while (map->m_pNextMap != NULL) {
-			map = map->m_pNextMap;
-		}
-		if (map->m_pNextMap == NULL) {
-			map->m_pNextMap = new sMap;
-			map = map->m_pNextMap;
+	// the server only reads the game layer, decompress it now so the game's OnInit finds it in the datafile cache
+	int Start, Num;
+	pEngineMap->GetType(MAPITEMTYPE_LAYER, &Start, &Num);
+	for(int i = 0; i < Num; i++)
+	{
+		CMapItemLayer *pLayer = (CMapItemLayer *)pEngineMap->GetItem(Start+i, 0, 0);
+		if(pLayer->m_Type == LAYERTYPE_TILES && (((CMapItemLayerTilemap *)pLayer)->m_Flags&TILESLAYERFLAG_GAME))
+		{
+			int Index = ((CMapItemLayerTilemap *)pLayer)->m_Data;
+			pEngineMap->Prefetch(&Index, 1);
+			break;
 		}
 	}
-	map->m_pMap = pEngineMap;
-	map->m_uiGameID = pGameID;
-	
-	// get the crc of the map
-	map->m_CurrentMapCrc = pEngineMap->Crc();
-	char aBufMsg[256];
-	str_format(aBufMsg, sizeof(aBufMsg), "%s crc is %08x", aBuf, map->m_CurrentMapCrc);
-	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBufMsg);
-
-	str_copy(map->m_aCurrentMap, pMapName, sizeof(map->m_aCurrentMap));
-	//map_set(df);
 
 	// load complete map into memory for download
+	IOHANDLE File = Storage()->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
 	{
-		IOHANDLE File = Storage()->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
-		map->m_CurrentMapSize = (int)io_length(File);
-		if (map->m_pCurrentMapData)
-			mem_free(map->m_pCurrentMapData);
-		map->m_pCurrentMapData = (unsigned char *)mem_alloc(map->m_CurrentMapSize, 1);
-		io_read(File, map->m_pCurrentMapData, map->m_CurrentMapSize);
-		io_close(File);
+		delete pEngineMap;
+		return 0;
 	}
 
-	return pEngineMap;
+	sMap *pMap = new sMap;
+	pMap->m_pMap = pEngineMap;
+	pMap->m_CurrentMapCrc = pEngineMap->Crc();
+	str_copy(pMap->m_aCurrentMap, pMapName, sizeof(pMap->m_aCurrentMap));
+	pMap->m_CurrentMapSize = (int)io_length(File);
+	pMap->m_pCurrentMapData = (unsigned char *)mem_alloc(pMap->m_CurrentMapSize, 1);
+	io_read(File, pMap->m_pCurrentMapData, pMap->m_CurrentMapSize);
+	io_close(File);
+	return pMap;
 }
 
+int CServer::PrepareMapJob(void *pUser)
+{
+	CMapJob *pJob = (CMapJob *)pUser;
+	pJob->m_pMap = pJob->m_pServer->PrepareMap(pJob->m_aMapName);
+	return pJob->m_pMap ? 0 : -1;
+}
 
-bool CServer::ChangeMap(const char *pMapName, unsigned int pGameID){
-	sMap* pMap = m_pMaps;
-	while(pMap){
-		if(pMap->m_uiGameID == pGameID){
-			char aBuf[512];
-			str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
-			
-			// check for valid standard map
-			if (!m_MapChecker.ReadAndValidateMap(Storage(), aBuf, IStorage::TYPE_ALL))
+void CServer::AddMapJob(const char *pMapName)
+{
+	CMapJob *pJob = new CMapJob;
+	pJob->m_pServer = this;
+	str_copy(pJob->m_aMapName, pMapName, sizeof(pJob->m_aMapName));
+	pJob->m_pMap = 0;
+	pJob->m_pNext = m_pMapJobs;
+	m_pMapJobs = pJob;
+	Kernel()->RequestInterface<IEngine>()->AddJob(&pJob->m_Job, PrepareMapJob, pJob);
+}
+
+static bool IsWarmMapListed(const char *pList, const char *pMapName)
+{
+	int Length = str_length(pMapName);
+	char aList[256];
+	str_copy(aList, pList, sizeof(aList));
+	for(char *p = str_skip_whitespaces(aList); *p; p = str_skip_whitespaces(p))
+	{
+		char *pEnd = str_skip_to_whitespace(p);
+		if(pEnd-p == Length && str_comp_num(p, pMapName, Length) == 0)
+			return true;
+		p = pEnd;
+	}
+	return false;
+}
+
+void CServer::UpdateMapJobs()
+{
+	char aBuf[256];
+
+	// commit finished jobs
+	CMapJob **ppJob = &m_pMapJobs;
+	while(*ppJob)
+	{
+		CMapJob *pJob = *ppJob;
+		if(pJob->m_Job.Status() != CJob::STATE_DONE)
+		{
+			ppJob = &pJob->m_pNext;
+			continue;
+		}
+		*ppJob = pJob->m_pNext;
+
+		if(!pJob->m_pMap)
+		{
+			str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", pJob->m_aMapName);
+			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+		}
+		else if(IsWarmMapListed(m_aWarmMapsConfig, pJob->m_aMapName))
+		{
+			pJob->m_pMap->m_pNextMap = m_pWarmMaps;
+			m_pWarmMaps = pJob->m_pMap;
+		}
+		else
+			delete pJob->m_pMap;
+		delete pJob;
+	}
+
+	if(str_comp(m_aWarmMapsConfig, g_Config.m_SvWarmMaps) == 0)
+		return;
+	str_copy(m_aWarmMapsConfig, g_Config.m_SvWarmMaps, sizeof(m_aWarmMapsConfig));
+
+	// drop warm maps that are not listed anymore
+	sMap **ppMap = &m_pWarmMaps;
+	while(*ppMap)
+	{
+		sMap *pMap = *ppMap;
+		if(IsWarmMapListed(m_aWarmMapsConfig, pMap->m_aCurrentMap))
+		{
+			ppMap = &pMap->m_pNextMap;
+			continue;
+		}
+		*ppMap = pMap->m_pNextMap;
+		delete pMap;
+	}
+
+	// load the listed maps that are neither warm nor loading
+	char aList[256];
+	str_copy(aList, m_aWarmMapsConfig, sizeof(aList));
+	for(char *p = str_skip_whitespaces(aList); *p; p = str_skip_whitespaces(p))
+	{
+		char *pName = p;
+		p = str_skip_to_whitespace(p);
+		if(*p)
+			*p++ = 0;
+
+		bool Found = false;
+		for(sMap *pMap = m_pWarmMaps; pMap && !Found; pMap = pMap->m_pNextMap)
+			Found = str_comp(pMap->m_aCurrentMap, pName) == 0;
+		for(CMapJob *pJob = m_pMapJobs; pJob && !Found; pJob = pJob->m_pNext)
+			Found = str_comp(pJob->m_aMapName, pName) == 0;
+		if(!Found)
+			AddMapJob(pName);
+	}
+}
+
+void CServer::ClearMapJobs()
+{
+	while(m_pMapJobs)
+	{
+		CMapJob *pJob = m_pMapJobs;
+		while(pJob->m_Job.Status() != CJob::STATE_DONE)
+			thread_sleep(1);
+		m_pMapJobs = pJob->m_pNext;
+		delete pJob->m_pMap;
+		delete pJob;
+	}
+
+	while(m_pWarmMaps)
+	{
+		sMap *pMap = m_pWarmMaps;
+		m_pWarmMaps = pMap->m_pNextMap;
+		delete pMap;
+	}
+}
+
+sMap *CServer::TakeWarmMap(const char *pMapName)
+{
+	for(sMap **ppMap = &m_pWarmMaps; *ppMap; ppMap = &(*ppMap)->m_pNextMap)
+	{
+		sMap *pMap = *ppMap;
+		if(str_comp(pMap->m_aCurrentMap, pMapName) != 0)
+			continue;
+
+		// refill the pool, the reload finds the data in the datafile cache
+		*ppMap = pMap->m_pNextMap;
+		pMap->m_pNextMap = 0;
+		AddMapJob(pMapName);
+		return pMap;
+	}
+	return 0;
+}
+
+bool CServer::ChangeMap(const char *pMapName, unsigned int pGameID){
+	sMap* pMap = m_pMaps;
+	while(pMap){
+		if(pMap->m_uiGameID == pGameID){
+			char aBuf[512];
+			str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
+			
+			// check for valid standard map
+			if (!m_MapChecker.ReadAndValidateMap(Storage(), aBuf, IStorage::TYPE_ALL))
 			{
 				Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapchecker", "invalid standard map");
 				return false;
@@ -1784,6 +2306,9 @@ int CServer::Run()
 	//
 	m_PrintCBIndex = Console()->RegisterPrintCallback(g_Config.m_ConsoleOutputLevel, SendRconLineAuthed, this);
 
+	if(g_Config.m_SvInputReplay[0])
+		return RunInputReplay(g_Config.m_SvInputReplay);
+
 	// load map
 	if(!LoadMap(g_Config.m_SvMap))
 	{
@@ -1821,6 +2346,8 @@ int CServer::Run()
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 
 	GameServer()->OnInit();
+	InputLogStart(m_pGames);
+	ReplayStart(m_pGames);
 	str_format(aBuf, sizeof(aBuf), "version %s", GameServer()->NetVersion());
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 
@@ -1831,6 +2358,9 @@ int CServer::Run()
 	{
 		int64 ReportTime = time_get();
 		int ReportInterval = 3;
+		int ReportTick = m_CurrentGameTick;
+		NETSTATS PrevStats;
+		net_stats(&PrevStats);
 
 		m_Lastheartbeat = 0;
 		m_GameStartTime = time_get();
@@ -1862,8 +2392,14 @@ int CServer::Run()
 					}
 
 					// new map loaded
+					InputLogStop(m_pGames);
+					ReplayStop(m_pGames);
+					m_ServerInfoRequests.Clear();
 					GameServer()->OnShutdown();
 
+					// the clients load the new map, so the ids can be reused right away
+					m_pGames->m_pIDPool->TimeoutIDs();
+
 					for(int c = 0; c < MAX_CLIENTS; c++)
 					{
 						if(m_aClients[c].m_State <= CClient::STATE_AUTH)
@@ -1879,6 +2415,10 @@ int CServer::Run()
 					m_CurrentGameTick = 0;
 					Kernel()->ReregisterInterface(GameServer());
 					GameServer()->OnInit();
+					m_pGames->m_Hibernating = false;
+					m_pGames->m_EmptySinceTick = -1;
+					InputLogStart(m_pGames);
+					ReplayStart(m_pGames);
 					UpdateServerInfo();
 				}
 				else
@@ -1889,33 +2429,50 @@ int CServer::Run()
 				}
 			}
 
+			UpdateMapJobs();
+
 			while(t > TickStartTime(m_CurrentGameTick+1))
 			{
 				m_CurrentGameTick++;
+				m_IDPoolTick++;
 				NewTicks++;
 
+				UpdateHibernation();
+
+				if(m_CurrentGameTick%TickSpeed() == 0)
+					m_ServerInfoRequests.Expire(m_CurrentGameTick, 0, 0);
+
 				if(m_PlayerCount){
+					for(sGame* p = m_pGames; p; p = p->m_pNext)
+						if(p->m_pInputLog) p->m_pInputLog->RecordTick(Tick());
+
 					// apply new input
 					for(int c = 0; c < MAX_CLIENTS; c++)
 					{
-						if(m_aClients[c].m_State == CClient::STATE_EMPTY)
+						if(m_aClients[c].m_State != CClient::STATE_INGAME)
 							continue;
-						for(int i = 0; i < 200; i++)
+						CClient::CInput *pInput = m_aClients[c].GetInput(Tick());
+						if(!pInput)
 						{
-							if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
-							{
-								if(m_aClients[c].m_State == CClient::STATE_INGAME) {
-									sGame* p = GetGame(m_aClients[c].m_uiGameID);
-									if(p != NULL) p->GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);				
-								}
-								break;
-							}
+							m_aClients[c].m_InputTiming.m_NumMissing++;
+							continue;
+						}
+						sGame* p = GetGame(m_aClients[c].m_uiGameID);
+						if(p != NULL) {
+							if(p->m_pInputLog) p->m_pInputLog->RecordPredictedInput(c, pInput->m_aData, MAX_INPUT_SIZE);
+							p->GameServer()->OnClientPredictedInput(c, pInput->m_aData);
 						}
 					}
 
 					sGame* p = m_pGames;
 					while(p != NULL){	
-						p->GameServer()->OnTick();
+						if(!p->m_Hibernating) {
+							if(p->m_pInputLog) p->m_pInputLog->RecordSimulate();
+							m_pRecordGame = p;
+							p->GameServer()->OnTick();
+							m_pRecordGame = 0;
+							if(p->m_pInputLog) p->m_pInputLog->RecordHash(p->GameServer()->WorldHash());
+						}
 						p = p->m_pNext;
 					}
 				} else {
@@ -1926,9 +2483,28 @@ int CServer::Run()
 			// snap game
 			if(NewTicks)
 			{
-				if(g_Config.m_SvHighBandwidth || (m_CurrentGameTick%2) == 0)
+				// with rate control every client has its own snapshot interval
+				if(g_Config.m_SvSnapRateControl || g_Config.m_SvHighBandwidth || (m_CurrentGameTick%2) == 0)
+				{
 					DoSnapshot();
 
+					// everything queued for a client during the tick shares as few packets as possible,
+					// messages sent with MSGFLAG_FLUSH still leave right away
+					if(g_Config.m_SvCoalescePackets)
+					{
+						// clients waiting for their next snapshot keep their messages for it
+						for(int i = 0; i < MAX_CLIENTS; i++)
+						{
+							const CClient::CSnapRateControl *pRate = &m_aClients[i].m_SnapRateControl;
+							if(m_aClients[i].m_State == CClient::STATE_EMPTY)
+								continue;
+							if(m_aClients[i].m_State != CClient::STATE_INGAME || pRate->m_LastSnapTick < 0 ||
+								m_CurrentGameTick-pRate->m_LastSnapTick >= pRate->m_Interval || pRate->m_LastSnapTick == m_CurrentGameTick)
+								m_NetServer.Flush(i);
+						}
+					}
+				}
+
 				UpdateClientRconCommands();
 			}
 
@@ -1939,25 +2515,43 @@ int CServer::Run()
 
 			if(ReportTime < time_get())
 			{
+				NETSTATS Stats;
+				net_stats(&Stats);
 				if(g_Config.m_Debug)
 				{
-					/*
-					static NETSTATS prev_stats;
-					NETSTATS stats;
-					netserver_stats(net, &stats);
-
-					perf_next();
-
-					if(config.dbg_pref)
-						perf_dump(&rootscope);
-
-					dbg_msg("server", "send=%8d recv=%8d",
-						(stats.send_bytes - prev_stats.send_bytes)/reportinterval,
-						(stats.recv_bytes - prev_stats.recv_bytes)/reportinterval);
+					int NumClients = 0;
+					for(int c = 0; c < MAX_CLIENTS; c++)
+						if(m_aClients[c].m_State != CClient::STATE_EMPTY)
+							NumClients++;
 
-					prev_stats = stats;
-					*/
+					int NumTicks = m_CurrentGameTick-ReportTick;
+					if(NumClients && NumTicks > 0)
+					{
+						dbg_msg("server", "send=%8d recv=%8d packets/client/tick=%.2f snap items dropped=%d",
+							(Stats.sent_bytes-PrevStats.sent_bytes)/ReportInterval,
+							(Stats.recv_bytes-PrevStats.recv_bytes)/ReportInterval,
+							(Stats.sent_packets-PrevStats.sent_packets)/(float)(NumClients*NumTicks),
+							m_NumSnapItemsDropped);
+					}
+					int NumActive = 0, NumHibernating = 0;
+					for(sGame *p = m_pGames; p; p = p->m_pNext)
+					{
+						if(p->m_Hibernating) NumHibernating++;
+						else NumActive++;
+					}
+					dbg_msg("server", "games active=%d hibernating=%d", NumActive, NumHibernating);
+					for(sGame *p = m_pGames; p; p = p->m_pNext)
+					{
+						if(!p->m_pDemoRecorder || !p->m_pDemoRecorder->IsRecording())
+							continue;
+						int Queued, Peak, Dropped;
+						p->m_pDemoRecorder->TakeQueueStats(&Queued, &Peak, &Dropped);
+						dbg_msg("server", "game %u demo queue=%d peak=%d dropped=%d", p->m_uiGameID, Queued, Peak, Dropped);
+					}
 				}
+				PrevStats = Stats;
+				ReportTick = m_CurrentGameTick;
+				m_NumSnapItemsDropped = 0;
 
 				ReportTime += time_freq()*ReportInterval;
 			}
@@ -1975,6 +2569,16 @@ int CServer::Run()
 		m_Econ.Shutdown();
 	}
 
+	ClearMapJobs();
+
+	for(sGame* p = m_pGames; p; p = p->m_pNext)
+	{
+		InputLogStop(p);
+		ReplayStop(p);
+		delete p->m_pDemoRecorder;
+		p->m_pDemoRecorder = 0;
+	}
+
 	GameServer()->OnShutdown();
 	m_pMap->Unload();
 
@@ -2027,6 +2631,25 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 	}
 }
 
+void CServer::ConInputTiming(IConsole::IResult *pResult, void *pUser)
+{
+	char aBuf[256];
+	CServer* pThis = static_cast<CServer *>(pUser);
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(pThis->m_aClients[i].m_State != CClient::STATE_INGAME)
+			continue;
+
+		const CClient::CInputTiming *pTiming = &pThis->m_aClients[i].m_InputTiming;
+		int TimeLeftAvg = pTiming->m_NumReceived ? (int)(pTiming->m_TimeLeftSum/pTiming->m_NumReceived) : 0;
+		str_format(aBuf, sizeof(aBuf), "id=%d name='%s' received=%d late=%d duplicate=%d missing=%d dropped=%d timeleft=%d/%d/%dms",
+			i, pThis->m_aClients[i].m_aName, pTiming->m_NumReceived, pTiming->m_NumLate, pTiming->m_NumDuplicate,
+			pTiming->m_NumMissing, pTiming->m_NumDropped, pTiming->m_TimeLeftMin, TimeLeftAvg, pTiming->m_TimeLeftMax);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", aBuf);
+	}
+}
+
 void CServer::ConShutdown(IConsole::IResult *pResult, void *pUser)
 {
 	((CServer *)pUser)->m_RunServer = 0;
@@ -2041,12 +2664,13 @@ void CServer::DemoRecorder_HandleAutoStart()
 {
 	if(g_Config.m_SvAutoDemoRecord)
 	{
-		m_DemoRecorder.Stop();
+		sGame *pGame = CallingGame();
+		DemoStop(pGame);
 		char aFilename[128];
 		char aDate[20];
 		str_timestamp(aDate, sizeof(aDate));
-		str_format(aFilename, sizeof(aFilename), "demos/%s_%s.demo", "auto/autorecord", aDate);
-		m_DemoRecorder.Start(Storage(), m_pConsole, aFilename, GameServer()->NetVersion(), m_aCurrentMap, m_CurrentMapCrc, "server");
+		str_format(aFilename, sizeof(aFilename), "demos/%s_%u_%s.demo", "auto/autorecord", pGame->m_uiGameID, aDate);
+		DemoStart(pGame, aFilename);
 		if(g_Config.m_SvAutoDemoMax)
 		{
 			// clean up auto recorded demos
@@ -2058,7 +2682,308 @@ void CServer::DemoRecorder_HandleAutoStart()
 
 bool CServer::DemoRecorder_IsRecording()
 {
-	return m_DemoRecorder.IsRecording();
+	sGame *pGame = CallingGame();
+	return (pGame->m_pDemoRecorder && pGame->m_pDemoRecorder->IsRecording()) || pGame->m_pReplay;
+}
+
+sGame *CServer::CallingGame()
+{
+	// outside the game callbacks it is the main game, as before there were several
+	return m_pRecordGame ? m_pRecordGame : m_pGames;
+}
+
+sGame *CServer::RecordGame(int ClientID)
+{
+	if(ClientID >= 0)
+		return GetGame(m_aClients[ClientID].m_uiGameID);
+
+	// a broadcast from outside the game callbacks has no single game
+	return m_pRecordGame;
+}
+
+void CServer::RecordMessage(sGame *pGame, const void *pData, int Size)
+{
+	if(pGame->m_pDemoRecorder && pGame->m_pDemoRecorder->IsRecording())
+		pGame->m_pDemoRecorder->RecordMessage(pData, Size);
+	if(pGame->m_pReplay)
+		pGame->m_pReplay->RecordMessage(pData, Size);
+}
+
+bool CServer::GetGameMap(sGame *pGame, const char **ppMapName, unsigned *pMapCrc)
+{
+	*ppMapName = m_aCurrentMap;
+	*pMapCrc = m_CurrentMapCrc;
+	if(pGame->m_uiGameID != 0)
+	{
+		sMap *pMap = m_pMaps;
+		while(pMap && pMap->m_uiGameID != pGame->m_uiGameID)
+			pMap = pMap->m_pNextMap;
+		if(!pMap)
+			return false;
+		*ppMapName = pMap->m_aCurrentMap;
+		*pMapCrc = pMap->m_CurrentMapCrc;
+	}
+	return true;
+}
+
+int CServer::DemoStart(sGame *pGame, const char *pFilename)
+{
+	const char *pMapName;
+	unsigned MapCrc;
+	if(!GetGameMap(pGame, &pMapName, &MapCrc))
+		return -1;
+
+	if(!pGame->m_pDemoRecorder)
+		pGame->m_pDemoRecorder = new CDemoRecorder(&m_SnapshotDelta);
+	return pGame->m_pDemoRecorder->Start(Storage(), Console(), pFilename, pGame->GameServer()->NetVersion(), pMapName, MapCrc, "server");
+}
+
+void CServer::DemoStop(sGame *pGame)
+{
+	if(pGame->m_pDemoRecorder)
+		pGame->m_pDemoRecorder->Stop();
+}
+
+void CServer::ReplayStart(sGame *pGame)
+{
+	if(!g_Config.m_SvReplaySeconds || m_InputReplay || pGame->m_pReplay)
+		return;
+
+	pGame->m_pReplay = new CDemoRecorder(&m_SnapshotDelta);
+	pGame->m_pReplay->StartReplay(Console(), g_Config.m_SvReplaySeconds);
+}
+
+void CServer::ReplayStop(sGame *pGame)
+{
+	delete pGame->m_pReplay;
+	pGame->m_pReplay = 0;
+}
+
+bool CServer::GameHasClients(unsigned GameID) const
+{
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		if(m_aClients[c].m_State != CClient::STATE_EMPTY && m_aClients[c].m_uiGameID == GameID)
+			return true;
+	}
+	return false;
+}
+
+void CServer::HibernateGame(sGame *pGame)
+{
+	pGame->m_Hibernating = true;
+	pGame->m_HibernateTick = m_CurrentGameTick;
+
+	// nothing happens that could be replayed
+	ReplayStop(pGame);
+	pGame->GameServer()->OnHibernate();
+
+	char aBuf[64];
+	str_format(aBuf, sizeof(aBuf), "game %u hibernates", pGame->m_uiGameID);
+	Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
+}
+
+void CServer::WakeGame(sGame *pGame)
+{
+	if(!pGame)
+		return;
+	pGame->m_EmptySinceTick = -1;
+	if(!pGame->m_Hibernating)
+		return;
+
+	// the tick restarts from 0 when the first game changes map
+	pGame->m_Hibernating = false;
+	pGame->GameServer()->OnWakeUp(max(m_CurrentGameTick-pGame->m_HibernateTick, 0));
+	ReplayStart(pGame);
+
+	char aBuf[64];
+	str_format(aBuf, sizeof(aBuf), "game %u woke up", pGame->m_uiGameID);
+	Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
+}
+
+void CServer::UpdateHibernation()
+{
+	for(sGame *p = m_pGames; p; p = p->m_pNext)
+	{
+		// recordings need every tick
+		bool Recording = p->m_pInputLog || (p->m_pDemoRecorder && p->m_pDemoRecorder->IsRecording());
+		if(GameHasClients(p->m_uiGameID) || Recording || !g_Config.m_SvHibernateDelay)
+		{
+			WakeGame(p);
+			continue;
+		}
+		if(p->m_Hibernating)
+			continue;
+
+		if(p->m_EmptySinceTick < 0 || p->m_EmptySinceTick > m_CurrentGameTick)
+			p->m_EmptySinceTick = m_CurrentGameTick;
+		if(m_CurrentGameTick-p->m_EmptySinceTick >= g_Config.m_SvHibernateDelay*SERVER_TICK_SPEED)
+			HibernateGame(p);
+	}
+}
+
+void CServer::InputLogStart(sGame *pGame)
+{
+	if(!g_Config.m_SvInputLog || m_InputReplay || pGame->m_pInputLog)
+		return;
+
+	const char *pMapName;
+	unsigned MapCrc;
+	if(!GetGameMap(pGame, &pMapName, &MapCrc))
+		return;
+
+	// reseed so the replay draws the same random numbers
+	unsigned Seed;
+	secure_random_fill(&Seed, sizeof(Seed));
+	srand(Seed);
+
+	char aFilename[128];
+	char aDate[20];
+	str_timestamp(aDate, sizeof(aDate));
+	str_format(aFilename, sizeof(aFilename), "inputlogs/%s_%u_%s.til", pMapName, pGame->m_uiGameID, aDate);
+	Storage()->CreateFolder("inputlogs", IStorage::TYPE_SAVE);
+
+	pGame->m_pInputLog = new CInputLogRecorder;
+	if(pGame->m_pInputLog->Start(Storage(), Console(), aFilename, pMapName, MapCrc, pGame->m_uiGameID, Tick(), Seed) != 0)
+	{
+		delete pGame->m_pInputLog;
+		pGame->m_pInputLog = 0;
+	}
+}
+
+void CServer::InputLogStop(sGame *pGame)
+{
+	if(!pGame->m_pInputLog)
+		return;
+
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "stopped recording inputs of game %u, %d records", pGame->m_uiGameID, pGame->m_pInputLog->NumRecords());
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "inputlog", aBuf);
+
+	delete pGame->m_pInputLog;
+	pGame->m_pInputLog = 0;
+}
+
+int CServer::RunInputReplay(const char *pFilename)
+{
+	char aBuf[256];
+	CInputLogReader Reader;
+	if(Reader.Open(Storage(), pFilename) != 0)
+	{
+		str_format(aBuf, sizeof(aBuf), "failed to open input log '%s'", pFilename);
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
+		return -1;
+	}
+
+	if(!LoadMap(Reader.MapName()))
+	{
+		str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", Reader.MapName());
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
+		return -1;
+	}
+	if(m_CurrentMapCrc != Reader.MapCrc())
+	{
+		str_format(aBuf, sizeof(aBuf), "map crc mismatch, log=%08x map=%08x", Reader.MapCrc(), m_CurrentMapCrc);
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
+	}
+	if(Reader.GameID() != 0)
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", "log is from an additional game instance, replaying with the default game config");
+
+	// no sockets, drops caused by the simulation itself go through the normal callback
+	m_InputReplay = true;
+	m_NetServer.SetCallbacks(NewClientCallback, NewClientNoAuthCallback, DelClientCallback, this);
+	m_CurrentGameTick = Reader.StartTick();
+	srand(Reader.Seed());
+	GameServer()->OnInit();
+	m_pConsole->StoreCommands(false);
+
+	int NumTicks = 0;
+	int NumMismatches = 0;
+	int FirstMismatch = -1;
+	int64 StartTime = time_get();
+
+	CInputLogReader::CRecord Record;
+	while(Reader.NextRecord(&Record))
+	{
+		int ClientID = Record.m_ClientID;
+		switch(Record.m_Type)
+		{
+		case INPUTLOG_TICK:
+			m_IDPoolTick += Record.m_Tick-m_CurrentGameTick;
+			m_CurrentGameTick = Record.m_Tick;
+			break;
+		case INPUTLOG_CONNECT:
+			m_aClients[ClientID].Reset();
+			m_aClients[ClientID].m_State = CClient::STATE_READY;
+			m_aClients[ClientID].m_uiGameID = 0;
+			m_aClients[ClientID].m_Authed = AUTHED_NO;
+			m_aClients[ClientID].m_PreferedTeam = Record.m_PreferedTeam;
+			m_aClients[ClientID].m_Country = Record.m_Country;
+			str_copy(m_aClients[ClientID].m_aName, Record.m_pName, MAX_NAME_LENGTH);
+			str_copy(m_aClients[ClientID].m_aClan, Record.m_pClan, MAX_CLAN_LENGTH);
+			++m_PlayerCount;
+			GameServer()->OnClientConnected(ClientID, Record.m_PreferedTeam);
+			break;
+		case INPUTLOG_ENTER:
+			m_aClients[ClientID].m_State = CClient::STATE_INGAME;
+			GameServer()->OnClientEnter(ClientID);
+			break;
+		case INPUTLOG_DROP:
+			if(m_aClients[ClientID].m_State != CClient::STATE_EMPTY)
+				DelClientCallback(ClientID, Record.m_pReason, this, Record.m_Force != 0);
+			break;
+		case INPUTLOG_DIRECT:
+			if(m_aClients[ClientID].m_State == CClient::STATE_INGAME)
+				GameServer()->OnClientDirectInput(ClientID, Record.m_aInput);
+			break;
+		case INPUTLOG_PREDICTED:
+			if(m_aClients[ClientID].m_State == CClient::STATE_INGAME)
+				GameServer()->OnClientPredictedInput(ClientID, Record.m_aInput);
+			break;
+		case INPUTLOG_MESSAGE:
+			if(m_aClients[ClientID].m_State >= CClient::STATE_READY)
+			{
+				CUnpacker Unpacker;
+				Unpacker.Reset(Record.m_pData, Record.m_DataSize);
+				int Msg = Unpacker.GetInt() >> 1;
+				if(!Unpacker.Error())
+					GameServer()->OnMessage(Msg, &Unpacker, ClientID);
+			}
+			break;
+		case INPUTLOG_SIMULATE:
+			GameServer()->OnTick();
+			NumTicks++;
+			break;
+		case INPUTLOG_SNAP:
+			DoSnapshot();
+			break;
+		case INPUTLOG_HASH:
+			if(GameServer()->WorldHash() != Record.m_Hash)
+			{
+				if(FirstMismatch < 0)
+					FirstMismatch = Tick();
+				NumMismatches++;
+			}
+			break;
+		}
+	}
+
+	int64 Duration = time_get() - StartTime;
+	str_format(aBuf, sizeof(aBuf), "replayed %d ticks in %.3fs (%.1f ticks/s)", NumTicks, Duration/(float)time_freq(),
+		Duration ? NumTicks*(float)time_freq()/Duration : 0.0f);
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
+	if(NumMismatches)
+		str_format(aBuf, sizeof(aBuf), "world hash mismatch on %d ticks, first at tick %d", NumMismatches, FirstMismatch);
+	else
+		str_format(aBuf, sizeof(aBuf), "world hash matched on all ticks");
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
+
+	GameServer()->OnShutdown();
+	m_pMap->Unload();
+
+	if(m_pCurrentMapData)
+		mem_free(m_pCurrentMapData);
+	return NumMismatches ? 1 : 0;
 }
 
 void CServer::ConRecord(IConsole::IResult *pResult, void *pUser)
@@ -2066,6 +2991,13 @@ void CServer::ConRecord(IConsole::IResult *pResult, void *pUser)
 	CServer* pServer = (CServer *)pUser;
 	char aFilename[128];
 
+	sGame *pGame = pServer->GetGame(pResult->NumArguments() > 1 ? pResult->GetInteger(1) : 0);
+	if(!pGame)
+	{
+		pServer->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", "No game with that id");
+		return;
+	}
+
 	if(pResult->NumArguments())
 		str_format(aFilename, sizeof(aFilename), "demos/%s.demo", pResult->GetString(0));
 	else
@@ -2074,12 +3006,47 @@ void CServer::ConRecord(IConsole::IResult *pResult, void *pUser)
 		str_timestamp(aDate, sizeof(aDate));
 		str_format(aFilename, sizeof(aFilename), "demos/demo_%s.demo", aDate);
 	}
-	pServer->m_DemoRecorder.Start(pServer->Storage(), pServer->Console(), aFilename, pServer->GameServer()->NetVersion(), pServer->m_aCurrentMap, pServer->m_CurrentMapCrc, "server");
+	pServer->DemoStart(pGame, aFilename);
 }
 
 void CServer::ConStopRecord(IConsole::IResult *pResult, void *pUser)
 {
-	((CServer *)pUser)->m_DemoRecorder.Stop();
+	CServer* pServer = (CServer *)pUser;
+	sGame *pGame = pServer->GetGame(pResult->NumArguments() ? pResult->GetInteger(0) : 0);
+	if(pGame)
+		pServer->DemoStop(pGame);
+}
+
+void CServer::ConSaveReplay(IConsole::IResult *pResult, void *pUser)
+{
+	CServer* pServer = (CServer *)pUser;
+	char aFilename[128];
+
+	sGame *pGame = pServer->GetGame(pResult->NumArguments() ? pResult->GetInteger(0) : 0);
+	if(!pGame)
+	{
+		pServer->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", "No game with that id");
+		return;
+	}
+	if(!pGame->m_pReplay)
+	{
+		pServer->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", "No replay kept for that game, check sv_replay_seconds");
+		return;
+	}
+
+	if(pResult->NumArguments() > 1)
+		str_format(aFilename, sizeof(aFilename), "demos/%s.demo", pResult->GetString(1));
+	else
+	{
+		char aDate[20];
+		str_timestamp(aDate, sizeof(aDate));
+		str_format(aFilename, sizeof(aFilename), "demos/replay_%u_%s.demo", pGame->m_uiGameID, aDate);
+	}
+
+	const char *pMapName;
+	unsigned MapCrc;
+	if(pServer->GetGameMap(pGame, &pMapName, &MapCrc))
+		pGame->m_pReplay->SaveReplay(pServer->Storage(), aFilename, pGame->GameServer()->NetVersion(), pMapName, MapCrc, "server");
 }
 
 void CServer::ConMapReload(IConsole::IResult *pResult, void *pUser)
@@ -2166,8 +3133,15 @@ void CServer::ConStartGame(IConsole::IResult *pResult, void *pUser){
 	CServer *pThis = static_cast<CServer *>(pUser);
 	
 	if(pResult->NumArguments() == 1)
-	{	
-		pThis->StartGameServer(pResult->GetString(0));
+	{
+		// the game exists when the command returns, so scripts can use it right away.
+		// only a warm map skips loading here
+		if(pThis->StartGameServer(pResult->GetString(0), 0) < 0)
+		{
+			char aBuf[256];
+			str_format(aBuf, sizeof(aBuf), "failed to start a game with map '%s'", pResult->GetString(0));
+			pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+		}
 	}
 }
 
@@ -2198,6 +3172,7 @@ void CServer::ConServerStatus(IConsole::IResult *pResult, void *pUser){
 	CServer *pThis = static_cast<CServer *>(pUser);
 	
 	char aBuf[1024];
+	int NumActive = 0, NumHibernating = 0;
 
 	sGame* pGame = pThis->m_pGames;
 	while(pGame){
@@ -2207,10 +3182,24 @@ void CServer::ConServerStatus(IConsole::IResult *pResult, void *pUser){
 			pMap = pMap->m_pNextMap;
 		}
 		
-		str_format(aBuf, sizeof(aBuf), "id=%u map=%s", pGame->m_uiGameID, (pMap) ? pMap->m_aCurrentMap : ((pGame->m_uiGameID == 0) ? pThis->m_aCurrentMap : ""));
+		str_format(aBuf, sizeof(aBuf), "id=%u map=%s snap_ids=%d/%d peak=%d%s", pGame->m_uiGameID, (pMap) ? pMap->m_aCurrentMap : ((pGame->m_uiGameID == 0) ? pThis->m_aCurrentMap : ""),
+			pGame->m_pIDPool->Usage(), pGame->m_pIDPool->Size(), pGame->m_pIDPool->HighWater(), pGame->m_Hibernating ? " (hibernating)" : "");
 		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", aBuf);
+		if(pGame->m_Hibernating) NumHibernating++;
+		else NumActive++;
 		pGame = pGame->m_pNext;
 	}
+
+	str_format(aBuf, sizeof(aBuf), "%d active, %d hibernating", NumActive, NumHibernating);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", aBuf);
+
+	int NumWarm = 0, NumLoading = 0;
+	for(sMap *pMap = pThis->m_pWarmMaps; pMap; pMap = pMap->m_pNextMap)
+		NumWarm++;
+	for(CMapJob *pJob = pThis->m_pMapJobs; pJob; pJob = pJob->m_pNext)
+		NumLoading++;
+	str_format(aBuf, sizeof(aBuf), "%d warm maps, %d loading", NumWarm, NumLoading);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", aBuf);
 }
 
 void CServer::RegisterCommands()
@@ -2228,17 +3217,20 @@ void CServer::RegisterCommands()
 	Console()->Register("moveplayergame", "i?i", CFGFLAG_SERVER, ConMovePlayerToGame, this, "Move a player by id to a game by id");
 	Console()->Register("serverstatus", "", CFGFLAG_SERVER, ConServerStatus, this, "List all game server");
 	Console()->Register("status", "", CFGFLAG_SERVER, ConStatus, this, "List players");
+	Console()->Register("input_timing", "", CFGFLAG_SERVER, ConInputTiming, this, "List input timing statistics of the players");
 	Console()->Register("shutdown", "", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("shutdownwhenempty", "", CFGFLAG_SERVER, ConShutdownEmpty, this, "Shut down, when the server is empty");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
 
-	Console()->Register("record", "?s", CFGFLAG_SERVER|CFGFLAG_STORE, ConRecord, this, "Record to a file");
-	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
+	Console()->Register("record", "?si", CFGFLAG_SERVER|CFGFLAG_STORE, ConRecord, this, "Record a game by its ID (default 0) to a file");
+	Console()->Register("stoprecord", "?i", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording a game by its ID (default 0)");
+	Console()->Register("save_replay", "?is", CFGFLAG_SERVER, ConSaveReplay, this, "Save the last sv_replay_seconds of a game by its ID (default 0) to a demo");
 
 	Console()->Register("reload", "", CFGFLAG_SERVER, ConMapReload, this, "Reload the map");
 
 	Console()->Chain("sv_name", ConchainSpecialInfoupdate, this);
 	Console()->Chain("password", ConchainSpecialInfoupdate, this);
+	Console()->Chain("sv_spectator_slots", ConchainSpecialInfoupdate, this);
 
 	Console()->Chain("sv_max_clients_per_ip", ConchainMaxclientsperipUpdate, this);
 	Console()->Chain("mod_command", ConchainModCommandUpdate, this);
@@ -2251,6 +3243,25 @@ void CServer::RegisterCommands()
 
 
 int CServer::StartGameServer(const char* pMap, CConfiguration* pConfig){
+	sMap *pPrepared = TakeWarmMap(pMap);
+	if(!pPrepared)
+		pPrepared = PrepareMap(pMap);
+	if(!pPrepared)
+		return -1;
+	return CommitGameServer(pPrepared, pConfig);
+}
+
+int CServer::CommitGameServer(sMap *pPrepared, CConfiguration* pConfig){
+	char aBuf[256];
+
+	// check for valid standard map
+	if(!m_MapChecker.IsMapValid(pPrepared->m_aCurrentMap, pPrepared->m_CurrentMapCrc, pPrepared->m_CurrentMapSize))
+	{
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapchecker", "invalid standard map");
+		delete pPrepared;
+		return -1;
+	}
+
 	unsigned int freeGameID = 1;
 		
 	sGame* g = m_pGames;
@@ -2259,40 +3270,38 @@ int CServer::StartGameServer(const char* pMap, CConfiguration* pConfig){
 		++freeGameID;
 		g = g->m_pNext;
 	}
-	
-	IMap* map = LoadAndGetMap(pMap, freeGameID);
-	
-	if(map){
-		if(g->m_pNext){
-			sGame* gtmp = g->m_pNext;
-			
-			g->m_pNext = new sGame;
-			g = g->m_pNext;
-			g->m_pNext = gtmp;
-		} else {			
-			g->m_pNext = new sGame;
-			g = g->m_pNext;			
-		}
-		
-		g->m_pGameServer = CreateGameServer();
-		g->m_uiGameID = freeGameID;
+
+	pPrepared->m_uiGameID = freeGameID;
+	sMap** ppMap = &m_pMaps;
+	while(*ppMap)
+		ppMap = &(*ppMap)->m_pNextMap;
+	*ppMap = pPrepared;
+
+	str_format(aBuf, sizeof(aBuf), "maps/%s.map crc is %08x", pPrepared->m_aCurrentMap, pPrepared->m_CurrentMapCrc);
+	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
+
+	if(g->m_pNext){
+		sGame* gtmp = g->m_pNext;
 		
-		/*for(int c = 0; c < MAX_CLIENTS; c++)
-		{
-			if(pThis->m_aClients[c].m_State <= CClient::STATE_AUTH)
-				continue;
-			pThis->GameServer()->OnClientDrop(c, "", true);
-			pThis->m_aClients[c].m_uiGameID = freeGameID;
-			pThis->SendMap(c, freeGameID);
-			pThis->m_aClients[c].Reset();
-			pThis->m_aClients[c].m_State = CClient::STATE_CONNECTING;
-		}*/
-
-		if(pConfig) g->m_pGameServer->OnInit(Kernel(), map, pConfig);
-		else g->m_pGameServer->OnInit(Kernel(), map);
-	} else return -1;
-	
+		g->m_pNext = new sGame;
+		g = g->m_pNext;
+		g->m_pNext = gtmp;
+	} else {			
+		g->m_pNext = new sGame;
+		g = g->m_pNext;			
+	}
 	
+	g->m_pGameServer = CreateGameServer();
+	g->m_uiGameID = freeGameID;
+	g->m_pIDPool = NewIDPool();
+
+	if(pConfig) g->m_pGameServer->OnInit(Kernel(), pPrepared->m_pMap, pConfig);
+	else g->m_pGameServer->OnInit(Kernel(), pPrepared->m_pMap);
+	InputLogStart(g);
+	ReplayStart(g);
+
+	str_format(aBuf, sizeof(aBuf), "started game %u with map '%s'", freeGameID, pPrepared->m_aCurrentMap);
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 	return freeGameID;	
 }
 
@@ -2333,12 +3342,18 @@ void CServer::StopGameServer(unsigned int GameID, int MoveToGameID){
 
 				pGame->m_pNext->GameServer()->OnClientDrop(c, "", true);
 				m_aClients[c].m_uiGameID = MoveToGameID == -1 ? 0 : MoveToGameID;
+				WakeGame(GetGame(m_aClients[c].m_uiGameID));
 				SendMap(c, MoveToGameID == -1 ? 0 : MoveToGameID);
 				m_aClients[c].Reset();
 				m_aClients[c].m_State = CClient::STATE_CONNECTING;
 			}
 
+			InputLogStop(pGame->m_pNext);
+			DemoStop(pGame->m_pNext);
+			ReplayStop(pGame->m_pNext);
+			delete pGame->m_pNext->m_pDemoRecorder;
 			delete pGame->m_pNext->m_pGameServer;
+			delete pGame->m_pNext->m_pIDPool;
 			sGame* pDeleteGame = pGame->m_pNext;
 			pGame->m_pNext = pGame->m_pNext->m_pNext;
 			delete pDeleteGame;
@@ -2361,9 +3376,11 @@ void CServer::MovePlayerToGameServer(int PlayerID, unsigned int GameID){
 		sGame* pGame = GetGame(GameID);
 		if (pGame) {
 			if (pGame->m_uiGameID == GameID) {
+				if(pGameLeave->m_pInputLog) pGameLeave->m_pInputLog->RecordDrop(PlayerID, true, "");
 				pGameLeave->GameServer()->OnClientDrop(PlayerID, "", true);
 
 				m_aClients[PlayerID].m_uiGameID = GameID;
+				WakeGame(pGame);
 				SendMap(PlayerID, GameID);
 				m_aClients[PlayerID].Reset();
 				m_aClients[PlayerID].m_State = CClient::STATE_CONNECTING;
@@ -2404,7 +3421,11 @@ bool CServer::ChangeGameServerMap(unsigned int GameID, const char* pMapName){
 			}
 
 			// new map loaded
+			InputLogStop(g);
+			DemoStop(g);
+			ReplayStop(g);
 			g->GameServer()->OnShutdown();
+			g->m_pIDPool->TimeoutIDs();
 
 			for(int c = 0; c < MAX_CLIENTS; c++)
 			{
@@ -2425,6 +3446,10 @@ bool CServer::ChangeGameServerMap(unsigned int GameID, const char* pMapName){
 			}
 			
 			if(pMap) g->GameServer()->OnInit(Kernel(), pMap->m_pMap, g->GameServer()->m_Config);
+			g->m_Hibernating = false;
+			g->m_EmptySinceTick = -1;
+			InputLogStart(g);
+			ReplayStart(g);
 			
 			return true;
 		} else return false;
@@ -2432,6 +3457,15 @@ bool CServer::ChangeGameServerMap(unsigned int GameID, const char* pMapName){
 }
 
 
+sGame *CServer::FindGame(const IGameServer *pGameServer)
+{
+	sGame *pGame = m_pGames;
+	while(pGame && pGame->m_pGameServer != pGameServer)
+		pGame = pGame->m_pNext;
+	dbg_assert(pGame != 0, "game server without a game");
+	return pGame;
+}
+
 sGame* CServer::GetGame(unsigned int GameID){
 	sGame* p = m_pGames;
 	while(p != NULL){
@@ -2443,14 +3477,14 @@ sGame* CServer::GetGame(unsigned int GameID){
 	return NULL;
 }
 
-int CServer::SnapNewID()
+int CServer::SnapNewID(IGameServer *pGameServer)
 {
-	return m_IDPool.NewID();
+	return FindGame(pGameServer)->m_pIDPool->NewID(m_IDPoolTick);
 }
 
-void CServer::SnapFreeID(int ID)
+void CServer::SnapFreeID(IGameServer *pGameServer, int ID)
 {
-	m_IDPool.FreeID(ID);
+	FindGame(pGameServer)->m_pIDPool->FreeID(ID, m_IDPoolTick);
 }
 
 
@@ -2461,6 +3495,13 @@ void *CServer::SnapNewItem(int Type, int ID, int Size)
 	return ID < 0 ? 0 : m_SnapshotBuilder.NewItem(Type, ID, Size);
 }
 
+void *CServer::SnapNewItem(int Type, int ID, int Size, int Cost)
+{
+	dbg_assert(Type >= 0 && Type <=0xffff, "incorrect type");
+	dbg_assert(ID >= 0 && ID <=0xffff, "incorrect id");
+	return ID < 0 ? 0 : m_SnapshotBuilder.NewItem(Type, ID, Size, max(Cost, CSnapshotBuilder::COST_ESSENTIAL+1));
+}
+
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
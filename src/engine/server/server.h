@@ -4,47 +4,67 @@
 #define ENGINE_SERVER_SERVER_H
 
 #include <engine/server.h>
+#include <engine/shared/addrtable.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/snapshot.h>
 #include <engine/shared/network.h>
 #include <engine/shared/econ.h>
 #include <engine/masterserver.h>
 #include <engine/shared/demo.h>
+#include <engine/server/inputlog.h>
 #include <engine/server/register.h>
 #include <engine/shared/mapchecker.h>
-
+#include <engine/shared/jobs.h>
+
+/*
+	Snapshot ids of one game, they only have to be unique among the items
+	a client of that game sees. A set bit marks an id that is in use or
+	still waits in the ring of freed ids, clients may interpolate an old
+	item with a new one if its id comes back too early. The bitmap starts
+	small and doubles when it runs full.
+*/
 class CSnapIDPool
 {
 	enum
 	{
+		MIN_IDS = 256,
 		MAX_IDS = 16*1024,
 	};
 
-	class CID
+	class CFreedID
 	{
 	public:
-		short m_Next;
-		short m_State; // 0 = free, 1 = alloced, 2 = timed
-		int m_Timeout;
+		int m_ID;
+		int m_Tick;
 	};
 
-	CID m_aIDs[MAX_IDS];
+	unsigned *m_pUsed;
+	CFreedID *m_pFreed; // ring, oldest first
+	int m_Size;
+	int m_FirstFreed;
+	int m_NumFreed;
+	int m_SearchWord;
+	int m_ReuseDelay;
 
-	int m_FirstFree;
-	int m_FirstTimed;
-	int m_LastTimed;
-	int m_Usage;
 	int m_InUsage;
+	int m_HighWater;
 
-public:
+	void Grow();
+	void ReleaseFirstFreed();
 
-	CSnapIDPool();
+public:
+	CSnapIDPool(int ReuseDelay);
+	~CSnapIDPool();
 
 	void Reset();
-	void RemoveFirstTimeout();
-	int NewID();
+	int NewID(int Tick);
+	void FreeID(int ID, int Tick);
 	void TimeoutIDs();
-	void FreeID(int ID);
+
+	int Size() const { return m_Size; }
+	int InUsage() const { return m_InUsage; }
+	int Usage() const { return m_InUsage+m_NumFreed; }
+	int HighWater() const { return m_HighWater; }
 };
 
 
@@ -70,6 +90,19 @@ class CServer : public IServer
 {
 	sGame *m_pGames;
 	sMap *m_pMaps;
+	sMap *m_pWarmMaps; // prepared maps without a game, taken by StartGameServer
+
+	// loads a map on the engine's job pool, for a new game or the warm pool
+	struct CMapJob
+	{
+		CJob m_Job;
+		class CServer *m_pServer;
+		char m_aMapName[64];
+		sMap *m_pMap;
+		CMapJob *m_pNext;
+	};
+	CMapJob *m_pMapJobs;
+	char m_aWarmMapsConfig[256];
 	class IConsole *m_pConsole;
 	class IStorage *m_pStorage;
 
@@ -86,6 +119,7 @@ public:
 		AUTHED_ADMIN,
 
 		MAX_RCONCMD_SEND=16,
+		MAX_SERVERINFO_REQUEST_ADDRS=4096,
 	};
 
 	enum {
@@ -111,6 +145,11 @@ public:
 			SNAPRATE_RECOVER
 		};
 
+		enum
+		{
+			INPUT_WINDOW=256, // ticks ahead an input can be queued
+		};
+
 		class CInput
 		{
 		public:
@@ -118,6 +157,23 @@ public:
 			int m_GameTick; // the tick that was chosen for the input
 		};
 
+		// when inputs arrive compared to the tick they were sent for
+		class CInputTiming
+		{
+		public:
+			int m_NumReceived;
+			int m_NumLate; // intended tick was already simulated
+			int m_NumDuplicate; // replaced an input for the same tick
+			int m_NumMissing; // ticks simulated without an input
+			int m_NumDropped; // too far ahead for the window
+			int64 m_TimeLeftSum; // ms until the intended tick started
+			int m_TimeLeftMin;
+			int m_TimeLeftMax;
+
+			void Reset();
+			void Add(int TimeLeft);
+		};
+
 		// connection state info
 		int m_State;
 		int m_Latency = 0;
@@ -134,8 +190,45 @@ public:
 		CSnapshotStorage m_Snapshots;
 
 		CInput m_LatestInput;
-		CInput m_aInputs[200]; // TODO: handle input better
-		int m_CurrentInput;
+		CInput m_aInputs[INPUT_WINDOW]; // slot is the tick modulo the window
+		CInputTiming m_InputTiming;
+
+		enum
+		{
+			MAX_DELTA_BASES=3, // acked snapshots a delta is tried against
+		};
+
+		// picks the ticks between snapshots from activity, loss and bandwidth
+		class CSnapRateControl
+		{
+		public:
+			int m_Interval;
+			int m_LastSnapTick;
+			int m_WindowStart; // -1 until the first snapshot
+			int m_NumAcked; // snapshots acked during the window
+			int m_NumBytes; // snapshot bytes sent during the window
+
+			void Reset();
+		};
+		CSnapRateControl m_SnapRateControl;
+
+		// the client keeps every snapshot it got from the newest delta base on,
+		// so snapshots it acked since then can all serve as base
+		int m_LastDeltaBase;
+		int m_aDeltaBases[MAX_DELTA_BASES]; // newest first
+		int m_NumDeltaBases;
+		void AckSnapshot(int Tick);
+
+		enum
+		{
+			MAX_STARVED_ITEMS=512,
+			STARVED_COST_PER_TICK=50, // an item held back for a second outranks one 2500 units closer
+		};
+
+		// items left out of the last snapshot because of the budget, sorted by key
+		int m_aStarvedKeys[MAX_STARVED_ITEMS];
+		int m_aStarvedSince[MAX_STARVED_ITEMS];
+		int m_NumStarved;
 
 		char m_aName[MAX_NAME_LENGTH];
 		char m_aClan[MAX_CLAN_LENGTH];
@@ -149,13 +242,13 @@ public:
 		const IConsole::CCommandInfo *m_pRconCmdToSend;
 
 		void Reset();
+		CInput *GetInput(int GameTick) { CInput *pInput = &m_aInputs[GameTick%INPUT_WINDOW]; return pInput->m_GameTick == GameTick ? pInput : 0; }
 	};
     int GetClientPing(int ClientID) const;
 	CClient m_aClients[MAX_CLIENTS];
 
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
-	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
 	CServerBan m_ServerBan;
@@ -164,6 +257,7 @@ public:
 
 	int64 m_GameStartTime;
 	//int m_CurrentGameTick;
+	int m_IDPoolTick; // unlike the game tick it keeps counting over map changes
 	int m_RunServer;
 	int m_StopServerWhenEmpty;
 	int m_MapReload;
@@ -179,7 +273,20 @@ public:
 	unsigned char *m_pCurrentMapData;
 	int m_CurrentMapSize;
 
-	CDemoRecorder m_DemoRecorder;
+	sGame *m_pRecordGame; // the game whose callbacks run, gets the recorded messages without a client
+	bool m_InputReplay;
+	int m_NumSnapItemsDropped;
+
+	// server info responses without the token, packed on the first request after a change
+	class CServerInfoCache
+	{
+	public:
+		bool m_Valid;
+		int m_Size;
+		unsigned char m_aData[NET_MAX_PAYLOAD];
+	};
+	CServerInfoCache m_aServerInfoCache[2]; // vanilla, 64 slots
+	CNetAddrTable m_ServerInfoRequests; // requests per address during the current second
 	CRegister m_Register;
 	CMapChecker m_MapChecker;
 
@@ -203,6 +310,34 @@ public:
 	void DemoRecorder_HandleAutoStart();
 	bool DemoRecorder_IsRecording();
 
+	sGame *RecordGame(int ClientID);
+	sGame *CallingGame();
+	void RecordMessage(sGame *pGame, const void *pData, int Size);
+	bool GetGameMap(sGame *pGame, const char **ppMapName, unsigned *pMapCrc);
+	int DemoStart(sGame *pGame, const char *pFilename);
+	void DemoStop(sGame *pGame);
+	void ReplayStart(sGame *pGame);
+	void ReplayStop(sGame *pGame);
+
+	void InputLogStart(sGame *pGame);
+	void InputLogStop(sGame *pGame);
+	int RunInputReplay(const char *pFilename);
+
+	bool GameHasClients(unsigned GameID) const;
+	void HibernateGame(sGame *pGame);
+	void WakeGame(sGame *pGame);
+	void UpdateHibernation();
+	sGame *FindGame(const class IGameServer *pGameServer);
+	CSnapIDPool *NewIDPool() const { return new CSnapIDPool(SERVER_TICK_SPEED*5); }
+
+	sMap *PrepareMap(const char *pMapName);
+	static int PrepareMapJob(void *pUser);
+	void AddMapJob(const char *pMapName);
+	void UpdateMapJobs();
+	void ClearMapJobs();
+	sMap *TakeWarmMap(const char *pMapName);
+	int CommitGameServer(sMap *pMap, struct CConfiguration *pConfig);
+
 	//int Tick()
 	int64 TickStartTime(int Tick);
 	//int TickSpeed()
@@ -220,9 +355,16 @@ public:
 	int MaxClients() const;
 
 	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID);
+	virtual int SendMsgToClients(CMsgPacker *pMsg, int Flags, const int *pClientIDs, int NumClientIDs);
+	bool PrepareMsgChunk(CNetChunk *pPacket, CMsgPacker *pMsg, int Flags, bool System, int ClientID);
 	int SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System);
 
 	void DoSnapshot();
+	void LimitSnapshot(int ClientID);
+	void UpdateSnapRate(int ClientID);
+	bool SnapDue(int ClientID);
+	int MinSnapInterval() const;
+	virtual int MaxSnapInterval() const;
 
 	static int NewClientCallbackImpl(int ClientID, void *pUser);
 	static int NewClientCallback(int ClientID, void *pUser);
@@ -241,14 +383,16 @@ public:
 
 	void ProcessClientPacket(CNetChunk *pPacket);
 
+	void PackServerInfo(class CPacker *pPacker, bool Extended);
 	void SendServerInfo(const NETADDR *pAddr, int Token, bool Extended);
+	bool ServerInfoRateLimited(const NETADDR *pAddr);
 	void UpdateServerInfo();
+	virtual void ExpireServerInfo();
 
 	void PumpNetwork();
 
 	char *GetMapName();
 	int LoadMap(const char *pMapName);
-	class IMap* LoadAndGetMap(const char *pMapName, unsigned int pGameID);
 	bool ChangeMap(const char *pMapName, unsigned int pGameID);
 
 	void InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, IConsole *pConsole);
@@ -260,10 +404,12 @@ public:
 	static void ConMovePlayerToGame(IConsole::IResult *pResult, void *pUser);
 	static void ConServerStatus(IConsole::IResult *pResult, void *pUser);
 	static void ConStatus(IConsole::IResult *pResult, void *pUser);
+	static void ConInputTiming(IConsole::IResult *pResult, void *pUser);
 	static void ConShutdown(IConsole::IResult *pResult, void *pUser);
 	static void ConShutdownEmpty(IConsole::IResult *pResult, void *pUser);
 	static void ConRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
+	static void ConSaveReplay(IConsole::IResult *pResult, void *pUser);
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
 	static void ConLogout(IConsole::IResult *pResult, void *pUser);
 	static void ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
@@ -282,9 +428,10 @@ public:
 
 	virtual struct sGame* GetGame(unsigned int GameID);
 
-	virtual int SnapNewID();
-	virtual void SnapFreeID(int ID);
+	virtual int SnapNewID(class IGameServer *pGameServer);
+	virtual void SnapFreeID(class IGameServer *pGameServer, int ID);
 	virtual void *SnapNewItem(int Type, int ID, int Size);
+	virtual void *SnapNewItem(int Type, int ID, int Size, int Cost);
 	void SnapSetStaticsize(int ItemType, int Size);
 };
 
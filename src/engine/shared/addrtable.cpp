@@ -0,0 +1,166 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+
+#include "addrtable.h"
+
+CNetAddrTable::CNetAddrTable()
+{
+	m_pEntries = 0;
+	m_Size = 0;
+	m_Num = 0;
+	m_PrefixV4 = 32;
+	m_PrefixV6 = 128;
+}
+
+CNetAddrTable::~CNetAddrTable()
+{
+	if(m_pEntries)
+		mem_free(m_pEntries);
+}
+
+void CNetAddrTable::SetPrefix(int PrefixV4, int PrefixV6)
+{
+	m_PrefixV4 = clamp(PrefixV4, 0, 32);
+	m_PrefixV6 = clamp(PrefixV6, 0, 128);
+}
+
+void CNetAddrTable::Clear()
+{
+	if(m_pEntries)
+		mem_zero(m_pEntries, m_Size*sizeof(CEntry));
+	m_Num = 0;
+}
+
+void CNetAddrTable::MakeKey(NETADDR *pKey, const NETADDR *pAddr) const
+{
+	mem_zero(pKey, sizeof(*pKey));
+	pKey->type = pAddr->type&NETTYPE_IPV6 ? NETTYPE_IPV6 : NETTYPE_IPV4;
+
+	int Bytes = pKey->type == NETTYPE_IPV4 ? 4 : 16;
+	int Prefix = pKey->type == NETTYPE_IPV4 ? m_PrefixV4 : m_PrefixV6;
+	for(int i = 0; i < Bytes && Prefix > 0; i++, Prefix -= 8)
+		pKey->ip[i] = Prefix >= 8 ? pAddr->ip[i] : pAddr->ip[i]&(0xff<<(8-Prefix));
+}
+
+unsigned CNetAddrTable::Hash(const NETADDR *pKey)
+{
+	// FNV-1a over the address bytes
+	int Bytes = pKey->type == NETTYPE_IPV4 ? 4 : 16;
+	unsigned Hash = 2166136261u^pKey->type;
+	for(int i = 0; i < Bytes; i++)
+		Hash = (Hash^pKey->ip[i])*16777619u;
+	return Hash;
+}
+
+int CNetAddrTable::Lookup(const NETADDR *pKey) const
+{
+	// returns the slot of the key or the empty slot it would go to
+	int Mask = m_Size-1;
+	int Index = Hash(pKey)&Mask;
+	while(Used(&m_pEntries[Index]) && mem_comp(&m_pEntries[Index].m_Addr, pKey, sizeof(NETADDR)) != 0)
+		Index = (Index+1)&Mask;
+	return Index;
+}
+
+void CNetAddrTable::Grow()
+{
+	CEntry *pOld = m_pEntries;
+	int OldSize = m_Size;
+
+	m_Size = m_Size ? m_Size*2 : MIN_SIZE;
+	m_pEntries = (CEntry *)mem_alloc(m_Size*sizeof(CEntry), 1);
+	mem_zero(m_pEntries, m_Size*sizeof(CEntry));
+
+	for(int i = 0; i < OldSize; i++)
+		if(Used(&pOld[i]))
+			m_pEntries[Lookup(&pOld[i].m_Addr)] = pOld[i];
+	if(pOld)
+		mem_free(pOld);
+}
+
+void CNetAddrTable::RemoveAt(int Index)
+{
+	// shift following entries of the probe sequence back, so no tombstones are needed
+	int Mask = m_Size-1;
+	int Hole = Index;
+	for(int i = (Index+1)&Mask; Used(&m_pEntries[i]); i = (i+1)&Mask)
+	{
+		int Home = Hash(&m_pEntries[i].m_Addr)&Mask;
+		if(((i-Home)&Mask) >= ((i-Hole)&Mask))
+		{
+			m_pEntries[Hole] = m_pEntries[i];
+			Hole = i;
+		}
+	}
+	mem_zero(&m_pEntries[Hole], sizeof(CEntry));
+	m_Num--;
+}
+
+CNetAddrTable::CEntry *CNetAddrTable::Set(const NETADDR *pAddr, int ExpireTick, int Data)
+{
+	// keep the load at most one half
+	if((m_Num+1)*2 > m_Size)
+		Grow();
+
+	NETADDR Key;
+	MakeKey(&Key, pAddr);
+	CEntry *pEntry = &m_pEntries[Lookup(&Key)];
+	if(!Used(pEntry))
+	{
+		pEntry->m_Addr = Key;
+		m_Num++;
+	}
+	pEntry->m_ExpireTick = ExpireTick;
+	pEntry->m_Data = Data;
+	return pEntry;
+}
+
+CNetAddrTable::CEntry *CNetAddrTable::Find(const NETADDR *pAddr, int Tick) const
+{
+	if(!m_Num)
+		return 0;
+
+	NETADDR Key;
+	MakeKey(&Key, pAddr);
+	CEntry *pEntry = &m_pEntries[Lookup(&Key)];
+	if(!Used(pEntry) || Expired(pEntry, Tick))
+		return 0;
+	return pEntry;
+}
+
+bool CNetAddrTable::Remove(const NETADDR *pAddr)
+{
+	if(!m_Num)
+		return false;
+
+	NETADDR Key;
+	MakeKey(&Key, pAddr);
+	int Index = Lookup(&Key);
+	if(!Used(&m_pEntries[Index]))
+		return false;
+	RemoveAt(Index);
+	return true;
+}
+
+int CNetAddrTable::Expire(int Tick, FExpireCallback pfnCallback, void *pUser)
+{
+	int NumExpired = 0;
+	int i = 0;
+	while(i < m_Size && m_Num)
+	{
+		CEntry *pEntry = &m_pEntries[i];
+		if(!Used(pEntry) || !Expired(pEntry, Tick))
+		{
+			i++;
+			continue;
+		}
+
+		if(pfnCallback)
+			pfnCallback(pEntry, pUser);
+		// another entry may be shifted into this slot, so look at it again
+		RemoveAt(i);
+		NumExpired++;
+	}
+	return NumExpired;
+}
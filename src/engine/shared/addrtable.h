@@ -0,0 +1,71 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_ADDRTABLE_H
+#define ENGINE_SHARED_ADDRTABLE_H
+
+#include <base/system.h>
+
+/*
+	Open addressing hash table keyed by network address. Ports are ignored
+	and addresses can be masked to a prefix, so one entry covers a whole
+	IPv6 network. Entries carry an expire tick and count as missing once
+	it is reached, Expire() reclaims them.
+*/
+class CNetAddrTable
+{
+public:
+	enum
+	{
+		NO_EXPIRE=-1,
+	};
+
+	struct CEntry
+	{
+		NETADDR m_Addr;
+		int m_ExpireTick;
+		int m_Data;
+	};
+
+	typedef void (*FExpireCallback)(const CEntry *pEntry, void *pUser);
+
+private:
+	enum
+	{
+		MIN_SIZE=16,
+	};
+
+	CEntry *m_pEntries;
+	int m_Size;
+	int m_Num;
+	int m_PrefixV4;
+	int m_PrefixV6;
+
+	void MakeKey(NETADDR *pKey, const NETADDR *pAddr) const;
+	int Lookup(const NETADDR *pKey) const;
+	void Grow();
+	void RemoveAt(int Index);
+
+	static unsigned Hash(const NETADDR *pKey);
+	static bool Used(const CEntry *pEntry) { return pEntry->m_Addr.type != NETTYPE_INVALID; }
+	static bool Expired(const CEntry *pEntry, int Tick) { return pEntry->m_ExpireTick != NO_EXPIRE && pEntry->m_ExpireTick - Tick <= 0; }
+
+public:
+	CNetAddrTable();
+	~CNetAddrTable();
+
+	// prefix lengths in bits, only change them while the table is empty
+	void SetPrefix(int PrefixV4, int PrefixV6);
+	void Clear();
+
+	// adds the address or updates its entry
+	CEntry *Set(const NETADDR *pAddr, int ExpireTick, int Data);
+	CEntry *Find(const NETADDR *pAddr, int Tick) const;
+	bool Remove(const NETADDR *pAddr);
+
+	// removes every entry expired at Tick, the callback sees them before they go
+	int Expire(int Tick, FExpireCallback pfnCallback, void *pUser);
+
+	int Num() const { return m_Num; }
+};
+
+#endif
@@ -0,0 +1,131 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include "cmdtable.h"
+
+CCommandTable::CCommandTable()
+{
+	m_pEntries = 0;
+	m_Size = 0;
+	m_Num = 0;
+}
+
+CCommandTable::~CCommandTable()
+{
+	if(m_pEntries)
+		mem_free(m_pEntries);
+}
+
+unsigned CCommandTable::Hash(const char *pName)
+{
+	// FNV-1a over the lower case name
+	unsigned Hash = 2166136261u;
+	for(; *pName && !is_whitespace(*pName); pName++)
+	{
+		char c = *pName;
+		if(c >= 'A' && c <= 'Z')
+			c += 'a'-'A';
+		Hash = (Hash^(unsigned char)c)*16777619u;
+	}
+	return Hash;
+}
+
+void CCommandTable::Clear()
+{
+	if(m_pEntries)
+		mem_zero(m_pEntries, m_Size*sizeof(CEntry));
+	m_Num = 0;
+}
+
+void CCommandTable::Grow()
+{
+	CEntry *pOld = m_pEntries;
+	int OldSize = m_Size;
+
+	m_Size = m_Size ? m_Size*2 : MIN_SIZE;
+	m_pEntries = (CEntry *)mem_alloc(m_Size*sizeof(CEntry), 1);
+	mem_zero(m_pEntries, m_Size*sizeof(CEntry));
+
+	int Mask = m_Size-1;
+	for(int i = 0; i < OldSize; i++)
+	{
+		if(!pOld[i].m_pName)
+			continue;
+		int Index = pOld[i].m_Hash&Mask;
+		while(m_pEntries[Index].m_pName)
+			Index = (Index+1)&Mask;
+		m_pEntries[Index] = pOld[i];
+	}
+	if(pOld)
+		mem_free(pOld);
+}
+
+void CCommandTable::RemoveAt(int Index)
+{
+	// shift following entries of the probe sequence back, so no tombstones are needed
+	int Mask = m_Size-1;
+	int Hole = Index;
+	for(int i = (Index+1)&Mask; m_pEntries[i].m_pName; i = (i+1)&Mask)
+	{
+		int Home = m_pEntries[i].m_Hash&Mask;
+		if(((i-Home)&Mask) >= ((i-Hole)&Mask))
+		{
+			m_pEntries[Hole] = m_pEntries[i];
+			Hole = i;
+		}
+	}
+	mem_zero(&m_pEntries[Hole], sizeof(CEntry));
+	m_Num--;
+}
+
+void CCommandTable::Add(const char *pName, void *pData)
+{
+	// keep the load at most one half
+	if((m_Num+1)*2 > m_Size)
+		Grow();
+
+	unsigned Hash = CCommandTable::Hash(pName);
+	int Mask = m_Size-1;
+	int Index = Hash&Mask;
+	while(m_pEntries[Index].m_pName)
+		Index = (Index+1)&Mask;
+
+	m_pEntries[Index].m_pName = pName;
+	m_pEntries[Index].m_Hash = Hash;
+	m_pEntries[Index].m_pData = pData;
+	m_Num++;
+}
+
+bool CCommandTable::Remove(const char *pName, const void *pData)
+{
+	if(!m_Num)
+		return false;
+
+	int Mask = m_Size-1;
+	for(int i = Hash(pName)&Mask; m_pEntries[i].m_pName; i = (i+1)&Mask)
+	{
+		if(m_pEntries[i].m_pData == pData)
+		{
+			RemoveAt(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+void *CCommandTable::Find(const char *pName, int *pIndex) const
+{
+	if(!m_Num)
+		return 0;
+
+	unsigned Hash = CCommandTable::Hash(pName);
+	int Mask = m_Size-1;
+	for(int i = *pIndex < 0 ? Hash&Mask : (*pIndex+1)&Mask; m_pEntries[i].m_pName; i = (i+1)&Mask)
+	{
+		if(m_pEntries[i].m_Hash == Hash && str_comp_nocase_whitespace(m_pEntries[i].m_pName, pName) == 0)
+		{
+			*pIndex = i;
+			return m_pEntries[i].m_pData;
+		}
+	}
+	return 0;
+}
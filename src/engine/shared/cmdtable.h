@@ -0,0 +1,54 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_CMDTABLE_H
+#define ENGINE_SHARED_CMDTABLE_H
+
+#include <base/system.h>
+
+/*
+	Open addressing hash table from command names to the registry's own
+	command structs. Names compare case insensitive and end at the first
+	whitespace, so a whole chat line can be looked up by its first word.
+	A name can be added more than once (commands with other flags or temp
+	commands), Find() walks all entries of a name. The table only keeps
+	the name pointer, it has to stay valid until the entry is removed.
+*/
+class CCommandTable
+{
+	enum
+	{
+		MIN_SIZE=64,
+	};
+
+	struct CEntry
+	{
+		const char *m_pName;
+		unsigned m_Hash;
+		void *m_pData;
+	};
+
+	CEntry *m_pEntries;
+	int m_Size;
+	int m_Num;
+
+	void Grow();
+	void RemoveAt(int Index);
+
+public:
+	CCommandTable();
+	~CCommandTable();
+
+	static unsigned Hash(const char *pName);
+
+	void Clear();
+	void Add(const char *pName, void *pData);
+	bool Remove(const char *pName, const void *pData);
+
+	// returns the next data added under the name, 0 after the last one. start with *pIndex = -1
+	void *Find(const char *pName, int *pIndex) const;
+	void *Find(const char *pName) const { int Index = -1; return Find(pName, &Index); }
+
+	int Num() const { return m_Num; }
+};
+
+#endif
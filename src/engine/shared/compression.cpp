@@ -1,5 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <string.h>
+
 #include <base/system.h>
 
 #include "compression.h"
@@ -60,6 +62,22 @@ const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut
 }
 
 
+// snapshot deltas are mostly small values, which take a single byte without extend bit
+static inline bool IsSmall(int i)
+{
+	return (unsigned)i+64u < 128u;
+}
+
+static inline unsigned char PackSmall(int i)
+{
+	return (unsigned char)(((i>>25)&0x40)|((i^(i>>31))&0x3F));
+}
+
+static inline int UnpackSmall(unsigned char Byte)
+{
+	return (Byte&0x3F)^-((Byte>>6)&1);
+}
+
 long CVariableInt::Decompress(const void *pSrc_, int Size, void *pDst_)
 {
 	const unsigned char *pSrc = (unsigned char *)pSrc_;
@@ -67,7 +85,25 @@ long CVariableInt::Decompress(const void *pSrc_, int Size, void *pDst_)
 	int *pDst = (int *)pDst_;
 	while(pSrc < pEnd)
 	{
-		pSrc = CVariableInt::Unpack(pSrc, pDst);
+		// eight single byte ints at once if none of the bytes is extended
+		if(pEnd - pSrc >= 8)
+		{
+			unsigned long long Word;
+			memcpy(&Word, pSrc, sizeof(Word));
+			if(!(Word&0x8080808080808080ull))
+			{
+				for(int i = 0; i < 8; i++)
+					pDst[i] = UnpackSmall(pSrc[i]);
+				pSrc += 8;
+				pDst += 8;
+				continue;
+			}
+		}
+
+		if(!(*pSrc&0x80))
+			*pDst = UnpackSmall(*pSrc++);
+		else
+			pSrc = CVariableInt::Unpack(pSrc, pDst);
 		pDst++;
 	}
 	return (long)((unsigned char *)pDst-(unsigned char *)pDst_);
@@ -75,15 +111,28 @@ long CVariableInt::Decompress(const void *pSrc_, int Size, void *pDst_)
 
 long CVariableInt::Compress(const void *pSrc_, int Size, void *pDst_)
 {
-	int *pSrc = (int *)pSrc_;
+	const int *pSrc = (int *)pSrc_;
+	const int *pEnd = pSrc + Size/4;
 	unsigned char *pDst = (unsigned char *)pDst_;
-	Size /= 4;
-	while(Size)
+	while(pSrc != pEnd)
 	{
-		pDst = CVariableInt::Pack(pDst, *pSrc);
-		Size--;
+		// four single byte ints at once
+		if(pEnd - pSrc >= 4 && IsSmall(pSrc[0]) && IsSmall(pSrc[1]) && IsSmall(pSrc[2]) && IsSmall(pSrc[3]))
+		{
+			pDst[0] = PackSmall(pSrc[0]);
+			pDst[1] = PackSmall(pSrc[1]);
+			pDst[2] = PackSmall(pSrc[2]);
+			pDst[3] = PackSmall(pSrc[3]);
+			pSrc += 4;
+			pDst += 4;
+			continue;
+		}
+
+		if(IsSmall(*pSrc))
+			*pDst++ = PackSmall(*pSrc);
+		else
+			pDst = CVariableInt::Pack(pDst, *pSrc);
 		pSrc++;
 	}
 	return (long)(pDst-(unsigned char *)pDst_);
 }
-
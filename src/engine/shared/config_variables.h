@@ -87,6 +87,15 @@ MACRO_CONFIG_STR(SvMap, sv_map, 128, "AliveFNG", CFGFLAG_SERVER, "Map to use on
 MACRO_CONFIG_INT(SvMaxClients, sv_max_clients, 8, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients that are allowed on a server")
 MACRO_CONFIG_INT(SvMaxClientsPerIP, sv_max_clients_per_ip, 4, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients with the same IP that can connect to the server")
 MACRO_CONFIG_INT(SvHighBandwidth, sv_high_bandwidth, 0, 0, 1, CFGFLAG_SERVER, "Use high bandwidth mode. Doubles the bandwidth required for the server. LAN use only")
+MACRO_CONFIG_INT(SvSnapRateControl, sv_snap_rate_control, 1, 0, 1, CFGFLAG_SERVER, "Adapt the snapshot rate of every client to its activity, loss and bandwidth")
+MACRO_CONFIG_INT(SvSnapIdleInterval, sv_snap_idle_interval, 3, 1, 10, CFGFLAG_SERVER, "Ticks between snapshots for spectators and idle players when snapshot rate control is on")
+MACRO_CONFIG_INT(SvSnapMaxInterval, sv_snap_max_interval, 5, 1, 10, CFGFLAG_SERVER, "Most ticks between snapshots for a client with loss or over the snapshot bandwidth")
+MACRO_CONFIG_INT(SvSnapBandwidth, sv_snap_bandwidth, 0, 0, 1000000, CFGFLAG_SERVER, "Snapshot bytes per second a client may get before its snapshot rate is lowered (0 = no limit)")
+MACRO_CONFIG_INT(SvSnapBudget, sv_snap_budget, 0, 0, 65536, CFGFLAG_SERVER, "Most bytes of snapshot a client gets, nearby players go first (0 = only the snapshot size limit)")
+MACRO_CONFIG_INT(SvServerInfoPerSecond, sv_server_info_per_second, 20, 0, 1000, CFGFLAG_SERVER, "Server info requests answered per second and address (0 = no limit)")
+MACRO_CONFIG_INT(SvConnlessRate, sv_connless_rate, 40, 0, 10000, CFGFLAG_SERVER, "Connectionless and connect packets per second an address may send before they are dropped (0 = no limit)")
+MACRO_CONFIG_INT(SvConnlessBurst, sv_connless_burst, 80, 1, 10000, CFGFLAG_SERVER, "Connectionless and connect packets an address may send at once")
+MACRO_CONFIG_INT(SvCoalescePackets, sv_coalesce_packets, 1, 0, 1, CFGFLAG_SERVER, "Send everything queued for a client during a tick together after the snapshot instead of flushing every snapshot part")
 MACRO_CONFIG_INT(SvRegister, sv_register, 1, 0, 1, CFGFLAG_SERVER, "Register server with master server for public listing")
 MACRO_CONFIG_STR(SvRconPassword, sv_rcon_password, 32, "", CFGFLAG_SERVER, "Remote console password (full access)")
 MACRO_CONFIG_STR(SvRconModPassword, sv_rcon_mod_password, 32, "", CFGFLAG_SERVER, "Remote console password for moderators (limited access)")
@@ -94,6 +103,11 @@ MACRO_CONFIG_INT(SvRconMaxTries, sv_rcon_max_tries, 3, 0, 100, CFGFLAG_SERVER, "
 MACRO_CONFIG_INT(SvRconBantime, sv_rcon_bantime, 5, 0, 1440, CFGFLAG_SERVER, "The time a client gets banned if remote console authentication fails. 0 makes it just use kick")
 MACRO_CONFIG_INT(SvAutoDemoRecord, sv_auto_demo_record, 0, 0, 1, CFGFLAG_SERVER, "Automatically record demos")
 MACRO_CONFIG_INT(SvAutoDemoMax, sv_auto_demo_max, 10, 0, 1000, CFGFLAG_SERVER, "Maximum number of automatically recorded demos (0 = no limit)")
+MACRO_CONFIG_INT(SvReplaySeconds, sv_replay_seconds, 0, 0, 300, CFGFLAG_SERVER, "Seconds of every game kept in memory for save_replay (0 = off, applies to games started later)")
+MACRO_CONFIG_STR(SvWarmMaps, sv_warm_maps, 256, "", CFGFLAG_SERVER, "Maps kept loaded in the background so startgame can use them right away, separated by spaces")
+MACRO_CONFIG_INT(SvHibernateDelay, sv_hibernate_delay, 10, 0, 3600, CFGFLAG_SERVER, "Seconds a game instance without clients keeps running before it hibernates (0 = never)")
+MACRO_CONFIG_INT(SvInputLog, sv_input_log, 0, 0, 1, CFGFLAG_SERVER, "Record the inputs of every game instance from its start for offline replays")
+MACRO_CONFIG_STR(SvInputReplay, sv_input_replay, 128, "", CFGFLAG_SERVER, "Replay this input log headless instead of running the server")
 
 MACRO_CONFIG_STR(EcBindaddr, ec_bindaddr, 128, "localhost", CFGFLAG_ECON, "Address to bind the external console to. Anything but 'localhost' is dangerous")
 MACRO_CONFIG_INT(EcPort, ec_port, 0, 0, 0, CFGFLAG_ECON, "Port to use for the external console")
@@ -358,13 +358,12 @@ void CConsole::PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPoss
 
 CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	int Index = -1;
+	while(CCommand *pCommand = (CCommand *)m_CommandTable.Find(pName, &Index))
 	{
-		if(pCommand->m_Flags&FlagMask)
-		{
-			if(str_comp_nocase(pCommand->m_pName, pName) == 0)
-				return pCommand;
-		}
+		// the table stops comparing at whitespace, console names have to match as a whole
+		if(pCommand->m_Flags&FlagMask && str_comp_nocase(pCommand->m_pName, pName) == 0)
+			return pCommand;
 	}
 
 	return 0x0;
@@ -735,6 +734,7 @@ void CConsole::AddCommandSorted(CCommand *pCommand)
 			}
 		}
 	}
+	m_CommandTable.Add(pCommand->m_pName, pCommand);
 }
 
 void CConsole::Register(const char *pName, const char *pParams,
@@ -822,6 +822,7 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		m_CommandTable.Remove(pRemoved->m_pName, pRemoved);
 		pRemoved->m_pNext = m_pRecycleList;
 		m_pRecycleList = pRemoved;
 	}
@@ -829,6 +830,10 @@ void CConsole::DeregisterTemp(const char *pName)
 
 void CConsole::DeregisterTempAll()
 {
+	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+		if(pCommand->m_Temp)
+			m_CommandTable.Remove(pCommand->m_pName, pCommand);
+
 	// set non temp as first one
 	for(; m_pFirstCommand && m_pFirstCommand->m_Temp; m_pFirstCommand = m_pFirstCommand->m_pNext);
 
@@ -892,13 +897,11 @@ void CConsole::StoreCommands(bool Store)
 
 const IConsole::CCommandInfo *CConsole::GetCommandInfo(const char *pName, int FlagMask, bool Temp)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	int Index = -1;
+	while(CCommand *pCommand = (CCommand *)m_CommandTable.Find(pName, &Index))
 	{
-		if(pCommand->m_Flags&FlagMask && pCommand->m_Temp == Temp)
-		{
-			if(str_comp_nocase(pCommand->m_pName, pName) == 0)
-				return pCommand;
-		}
+		if(pCommand->m_Flags&FlagMask && pCommand->m_Temp == Temp && str_comp_nocase(pCommand->m_pName, pName) == 0)
+			return pCommand;
 	}
 
 	return 0;
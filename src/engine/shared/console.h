@@ -4,6 +4,7 @@
 #define ENGINE_SHARED_CONSOLE_H
 
 #include <engine/console.h>
+#include "cmdtable.h"
 #include "memheap.h"
 
 class CConsole : public IConsole
@@ -36,6 +37,7 @@ class CConsole : public IConsole
 	bool m_StoreCommands;
 	const char *m_paStrokeStr[2];
 	CCommand *m_pFirstCommand;
+	CCommandTable m_CommandTable;
 
 	class CExecFile
 	{
@@ -64,8 +64,168 @@ struct CDatafile
 	int m_DataStartOffset;
 	char **m_ppDataPtrs;
 	char *m_pData;
+	char *m_pMapped; // the whole file when it could be mapped, the file is closed then
+	unsigned m_FileSize;
+	struct CDataCacheFile *m_pCache;
 };
 
+/*
+	Decompressed data of the files opened lately, shared by all readers of
+	the same file (same crc and size). A block stays unchanged once it is in
+	here, readers get their own copy of it because they may modify the data
+	(the collision rewrites the game layer for example). The only reader of
+	a file takes the blocks over instead, so a single reader like the client
+	does not keep a second copy of everything. Files nobody has open anymore
+	are kept for a while, so reloading a map is cheap too.
+*/
+struct CDataCacheFile
+{
+	unsigned m_Crc;
+	unsigned m_Size;
+	int m_NumData;
+	int m_Refs;
+	char **m_ppData;
+	int *m_pDataSizes;
+	CDataCacheFile *m_pNext;
+};
+
+enum
+{
+	MAX_UNUSED_CACHE_FILES=4,
+	MAX_PREFETCH_THREADS=4,
+};
+
+static LOCK gs_DataCacheLock = lock_create();
+static CDataCacheFile *gs_pFirstCacheFile = 0; // most recently opened first
+
+static void DataCacheFree(CDataCacheFile *pFile)
+{
+	for(int i = 0; i < pFile->m_NumData; i++)
+		mem_free(pFile->m_ppData[i]);
+	mem_free(pFile);
+}
+
+static CDataCacheFile *DataCacheAcquire(unsigned Crc, unsigned Size, int NumData)
+{
+	lock_wait(gs_DataCacheLock);
+
+	CDataCacheFile **ppFile = &gs_pFirstCacheFile;
+	while(*ppFile && ((*ppFile)->m_Crc != Crc || (*ppFile)->m_Size != Size || (*ppFile)->m_NumData != NumData))
+		ppFile = &(*ppFile)->m_pNext;
+
+	CDataCacheFile *pFile = *ppFile;
+	if(pFile)
+		*ppFile = pFile->m_pNext;
+	else
+	{
+		pFile = (CDataCacheFile *)mem_alloc(sizeof(CDataCacheFile) + NumData*(sizeof(char *)+sizeof(int)), 1);
+		pFile->m_Crc = Crc;
+		pFile->m_Size = Size;
+		pFile->m_NumData = NumData;
+		pFile->m_Refs = 0;
+		pFile->m_ppData = (char **)(pFile+1);
+		pFile->m_pDataSizes = (int *)(pFile->m_ppData+NumData);
+		mem_zero(pFile->m_ppData, NumData*(sizeof(char *)+sizeof(int)));
+	}
+	pFile->m_Refs++;
+	pFile->m_pNext = gs_pFirstCacheFile;
+	gs_pFirstCacheFile = pFile;
+
+	// drop the oldest files that are not open anymore
+	int NumUnused = 0;
+	for(ppFile = &gs_pFirstCacheFile; *ppFile;)
+	{
+		if((*ppFile)->m_Refs == 0 && ++NumUnused > MAX_UNUSED_CACHE_FILES)
+		{
+			CDataCacheFile *pUnused = *ppFile;
+			*ppFile = pUnused->m_pNext;
+			DataCacheFree(pUnused);
+		}
+		else
+			ppFile = &(*ppFile)->m_pNext;
+	}
+
+	lock_unlock(gs_DataCacheLock);
+	return pFile;
+}
+
+static void DataCacheRelease(CDataCacheFile *pFile)
+{
+	lock_wait(gs_DataCacheLock);
+	pFile->m_Refs--;
+	lock_unlock(gs_DataCacheLock);
+}
+
+static bool DataCacheFind(CDataCacheFile *pFile, int Index)
+{
+	lock_wait(gs_DataCacheLock);
+	bool Found = pFile->m_ppData[Index] != 0;
+	lock_unlock(gs_DataCacheLock);
+	return Found;
+}
+
+// a private copy of the block, 0 if it is not in the cache
+static char *DataCacheGet(CDataCacheFile *pFile, int Index)
+{
+	lock_wait(gs_DataCacheLock);
+	char *pData = pFile->m_ppData[Index];
+	if(pData && pFile->m_Refs == 1)
+		pFile->m_ppData[Index] = 0;
+	else if(pData)
+	{
+		int Size = pFile->m_pDataSizes[Index];
+		pData = (char *)mem_alloc(Size, 1);
+		mem_copy(pData, pFile->m_ppData[Index], Size);
+	}
+	lock_unlock(gs_DataCacheLock);
+	return pData;
+}
+
+// takes over pData, unless another reader was faster
+static void DataCacheAdd(CDataCacheFile *pFile, int Index, char *pData, int Size)
+{
+	lock_wait(gs_DataCacheLock);
+	if(!pFile->m_ppData[Index])
+	{
+		pFile->m_ppData[Index] = pData;
+		pFile->m_pDataSizes[Index] = Size;
+		pData = 0;
+	}
+	lock_unlock(gs_DataCacheLock);
+	if(pData)
+		mem_free(pData);
+}
+
+// keeps a copy of a block a reader decompressed, if other readers have the file open
+static void DataCacheShare(CDataCacheFile *pFile, int Index, const char *pData, int Size)
+{
+	lock_wait(gs_DataCacheLock);
+	if(!pFile->m_ppData[Index] && pFile->m_Refs > 1)
+	{
+		pFile->m_ppData[Index] = (char *)mem_alloc(Size, 1);
+		mem_copy(pFile->m_ppData[Index], pData, Size);
+		pFile->m_pDataSizes[Index] = Size;
+	}
+	lock_unlock(gs_DataCacheLock);
+}
+
+static char *Decompress(const void *pCompressed, int CompressedSize, int UncompressedSize, int *pSize)
+{
+	if(UncompressedSize < 0)
+		return 0;
+
+	char *pData = (char *)mem_alloc(max(UncompressedSize, 1), 1);
+	unsigned long s = UncompressedSize;
+	if(uncompress((Bytef*)pData, &s, (Bytef*)pCompressed, CompressedSize) != Z_OK || s != (unsigned long)UncompressedSize) // ignore_convention
+	{
+		dbg_msg("datafile", "failed to decompress data");
+		mem_free(pData);
+		return 0;
+	}
+	*pSize = (int)s;
+	return pData;
+}
+
 bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
 {
 	dbg_msg("datafile", "loading. filename='%s'", pFilename);
@@ -77,9 +237,18 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
+	// map the file, the header, items and uncompressed data are used in place then
+	unsigned FileSize = (unsigned)io_length(File);
+	char *pMapped = 0;
+#if !defined(CONF_ARCH_ENDIAN_BIG)
+	pMapped = (char *)io_map(File, FileSize);
+#endif
 
 	// take the CRC of the file and store it
 	unsigned Crc = 0;
+	if(pMapped)
+		Crc = crc32(0, (const Bytef *)pMapped, FileSize); // ignore_convention
+	else
 	{
 		enum
 		{
@@ -102,12 +271,20 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	// TODO: change this header
 	CDatafileHeader Header;
-	io_read(File, &Header, sizeof(Header));
+	if(pMapped)
+	{
+		mem_zero(&Header, sizeof(Header));
+		mem_copy(&Header, pMapped, min(FileSize, (unsigned)sizeof(Header)));
+	}
+	else
+		io_read(File, &Header, sizeof(Header));
 	if(Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
 	{
 		if(Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
 		{
 			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aID[0], Header.m_aID[1], Header.m_aID[2], Header.m_aID[3]);
+			io_unmap(pMapped, FileSize);
+			io_close(File);
 			return 0;
 		}
 	}
@@ -118,6 +295,8 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
 		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
+		io_unmap(pMapped, FileSize);
+		io_close(File);
 		return 0;
 	}
 
@@ -129,31 +308,55 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		Size += Header.m_NumRawData*sizeof(int); // v4 has uncompressed data sizes aswell
 	Size += Header.m_ItemSize;
 
-	unsigned AllocSize = Size;
-	AllocSize += sizeof(CDatafile); // add space for info structure
+	unsigned AllocSize = sizeof(CDatafile); // add space for info structure
 	AllocSize += Header.m_NumRawData*sizeof(void*); // add space for data pointers
+	if(!pMapped)
+		AllocSize += Size;
+
+	unsigned ReadSize = 0;
+	if(pMapped)
+		ReadSize = min(Size, FileSize-min(FileSize, (unsigned)sizeof(CDatafileHeader)));
+	if(pMapped && (ReadSize != Size || sizeof(CDatafileHeader)+Size+Header.m_DataSize > FileSize))
+	{
+		io_unmap(pMapped, FileSize);
+		io_close(File);
+		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
+		return false;
+	}
 
 	CDatafile *pTmpDataFile = (CDatafile*)mem_alloc(AllocSize, 1);
 	pTmpDataFile->m_Header = Header;
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
 	pTmpDataFile->m_ppDataPtrs = (char**)(pTmpDataFile+1);
-	pTmpDataFile->m_pData = (char *)(pTmpDataFile+1)+Header.m_NumRawData*sizeof(char *);
+	pTmpDataFile->m_pData = pMapped ? pMapped+sizeof(CDatafileHeader) : (char *)(pTmpDataFile+1)+Header.m_NumRawData*sizeof(char *);
 	pTmpDataFile->m_File = File;
 	pTmpDataFile->m_Crc = Crc;
+	pTmpDataFile->m_pMapped = pMapped;
+	pTmpDataFile->m_FileSize = FileSize;
 
 	// clear the data pointers
 	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData*sizeof(void*));
 
 	// read types, offsets, sizes and item data
-	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
-	if(ReadSize != Size)
+	if(!pMapped)
 	{
-		io_close(pTmpDataFile->m_File);
-		mem_free(pTmpDataFile);
-		pTmpDataFile = 0;
-		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
-		return false;
+		ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
+		if(ReadSize != Size)
+		{
+			io_close(pTmpDataFile->m_File);
+			mem_free(pTmpDataFile);
+			pTmpDataFile = 0;
+			dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
+			return false;
+		}
+	}
+	else
+	{
+		// everything is read through the mapping
+		io_close(File);
+		pTmpDataFile->m_File = 0;
 	}
+	pTmpDataFile->m_pCache = DataCacheAcquire(Crc, FileSize, Header.m_NumRawData);
 
 	Close();
 	m_pDataFile = pTmpDataFile;
@@ -162,7 +365,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	swap_endian(m_pDataFile->m_pData, sizeof(int), min(static_cast<unsigned>(Header.m_Swaplen), Size) / sizeof(int));
 #endif
 
-	//if(DEBUG)
+	if(DEBUG)
 	{
 		dbg_msg("datafile", "allocsize=%d", AllocSize);
 		dbg_msg("datafile", "readsize=%d", ReadSize);
@@ -264,9 +467,38 @@ int CDataFileReader::GetDataSize(int Index)
 	return m_pDataFile->m_Info.m_pDataOffsets[Index+1]-m_pDataFile->m_Info.m_pDataOffsets[Index];
 }
 
+int CDataFileReader::GetUncompressedDataSize(int Index)
+{
+	if(!m_pDataFile) { return 0; }
+
+	if(m_pDataFile->m_Header.m_Version == 4)
+		return m_pDataFile->m_Info.m_pDataSizes[Index];
+	return GetDataSize(Index);
+}
+
+// the data as stored in the mapped file, 0 if it isn't mapped or the offsets are broken
+const char *CDataFileReader::GetMappedData(int Index)
+{
+	if(!m_pDataFile->m_pMapped)
+		return 0;
+
+	int Offset = m_pDataFile->m_Info.m_pDataOffsets[Index];
+	int DataSize = GetDataSize(Index);
+	if(Offset < 0 || DataSize < 0 || Offset > m_pDataFile->m_Header.m_DataSize - DataSize)
+		return 0;
+	return m_pDataFile->m_pMapped + m_pDataFile->m_DataStartOffset + Offset;
+}
+
+bool CDataFileReader::IsMappedData(int Index) const
+{
+	const char *pData = m_pDataFile->m_ppDataPtrs[Index];
+	return pData && m_pDataFile->m_pMapped && pData >= m_pDataFile->m_pMapped && pData < m_pDataFile->m_pMapped + m_pDataFile->m_FileSize;
+}
+
 void *CDataFileReader::GetDataImpl(int Index, int Swap)
 {
 	if(!m_pDataFile) { return 0; }
+	if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData) { return 0; }
 
 	// load it if needed
 	if(!m_pDataFile->m_ppDataPtrs[Index])
@@ -279,32 +511,48 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 
 		if(m_pDataFile->m_Header.m_Version == 4)
 		{
-			// v4 has compressed data
-			void *pTemp = (char *)mem_alloc(DataSize, 1);
-			unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
-			unsigned long s;
-
-			dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%d", Index, DataSize, UncompressedSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(UncompressedSize, 1);
-
-			// read the compressed data
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, pTemp, DataSize);
+			// v4 has compressed data, another reader of the file may have decompressed it already
+			int UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
+			int Size = UncompressedSize;
+			char *pData = DataCacheGet(m_pDataFile->m_pCache, Index);
+			if(!pData)
+			{
+				if(DEBUG)
+					dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%d", Index, DataSize, UncompressedSize);
+
+				const char *pCompressed = GetMappedData(Index);
+				if(pCompressed)
+					pData = Decompress(pCompressed, DataSize, UncompressedSize, &Size);
+				else if(m_pDataFile->m_File)
+				{
+					// read the compressed data
+					void *pTemp = mem_alloc(DataSize, 1);
+					io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
+					io_read(m_pDataFile->m_File, pTemp, DataSize);
+					pData = Decompress(pTemp, DataSize, UncompressedSize, &Size);
+					mem_free(pTemp);
+				}
+				if(!pData)
+					return 0;
+
+				DataCacheShare(m_pDataFile->m_pCache, Index, pData, Size);
+			}
 
-			// decompress the data, TODO: check for errors
-			s = UncompressedSize;
-			uncompress((Bytef*)m_pDataFile->m_ppDataPtrs[Index], &s, (Bytef*)pTemp, DataSize); // ignore_convention
+			m_pDataFile->m_ppDataPtrs[Index] = pData;
 #if defined(CONF_ARCH_ENDIAN_BIG)
-			SwapSize = s;
+			SwapSize = Size;
 #endif
-
-			// clean up the temporary buffers
-			mem_free(pTemp);
+		}
+		else if(m_pDataFile->m_pMapped)
+		{
+			// uncompressed data is used in place, writes to it stay private to this reader
+			m_pDataFile->m_ppDataPtrs[Index] = (char *)GetMappedData(Index);
 		}
 		else
 		{
 			// load the data
-			dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
+			if(DEBUG)
+				dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
 			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(DataSize, 1);
 			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
 			io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
@@ -319,6 +567,80 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 	return m_pDataFile->m_ppDataPtrs[Index];
 }
 
+struct CPrefetchJob
+{
+	CDataFileReader *m_pReader;
+	struct CDatafile *m_pDataFile;
+	const int *m_pIndices;
+	int m_Num;
+	int m_Next;
+	LOCK m_Lock;
+};
+
+void CDataFileReader::PrefetchThread(void *pUser)
+{
+	CPrefetchJob *pJob = (CPrefetchJob *)pUser;
+	CDatafile *pDataFile = pJob->m_pDataFile;
+	while(1)
+	{
+		lock_wait(pJob->m_Lock);
+		int i = pJob->m_Next++;
+		lock_unlock(pJob->m_Lock);
+		if(i >= pJob->m_Num)
+			break;
+
+		int Index = pJob->m_pIndices[i];
+		int Size;
+		char *pData = Decompress(pJob->m_pReader->GetMappedData(Index), pJob->m_pReader->GetDataSize(Index),
+			pDataFile->m_Info.m_pDataSizes[Index], &Size);
+		if(pData)
+			DataCacheAdd(pDataFile->m_pCache, Index, pData, Size);
+	}
+}
+
+void CDataFileReader::PrefetchData(const int *pIndices, int Num)
+{
+	// only mapped files can be read by several threads at once
+	if(!m_pDataFile || !m_pDataFile->m_pMapped || m_pDataFile->m_Header.m_Version != 4)
+		return;
+
+	// find the blocks nobody has decompressed yet
+	int *pTodo = (int *)mem_alloc(max(Num, 1)*sizeof(int), 1);
+	int NumTodo = 0;
+	for(int i = 0; i < Num; i++)
+	{
+		int Index = pIndices ? pIndices[i] : i;
+		if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData || m_pDataFile->m_ppDataPtrs[Index] ||
+			DataCacheFind(m_pDataFile->m_pCache, Index) || !GetMappedData(Index))
+			continue;
+		pTodo[NumTodo++] = Index;
+	}
+
+	CPrefetchJob Job;
+	Job.m_pReader = this;
+	Job.m_pDataFile = m_pDataFile;
+	Job.m_pIndices = pTodo;
+	Job.m_Num = NumTodo;
+	Job.m_Next = 0;
+	Job.m_Lock = lock_create();
+
+	// this thread helps decompressing
+	void *apThreads[MAX_PREFETCH_THREADS-1];
+	int NumThreads = 0;
+	for(int i = 0; i < min(NumTodo, (int)MAX_PREFETCH_THREADS)-1; i++)
+	{
+		apThreads[NumThreads] = thread_init(PrefetchThread, &Job);
+		if(apThreads[NumThreads])
+			NumThreads++;
+	}
+	PrefetchThread(&Job);
+	for(int i = 0; i < NumThreads; i++)
+		thread_wait(apThreads[i]);
+
+	lock_destroy(Job.m_Lock);
+	mem_free(pTodo);
+}
+
 void *CDataFileReader::GetData(int Index)
 {
 	return GetDataImpl(Index, 0);
@@ -335,7 +657,8 @@ void CDataFileReader::UnloadData(int Index)
 		return;
 
 	//
-	mem_free(m_pDataFile->m_ppDataPtrs[Index]);
+	if(!IsMappedData(Index))
+		mem_free(m_pDataFile->m_ppDataPtrs[Index]);
 	m_pDataFile->m_ppDataPtrs[Index] = 0x0;
 }
 
@@ -408,9 +731,15 @@ bool CDataFileReader::Close()
 	// free the data that is loaded
 	int i;
 	for(i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
-		mem_free(m_pDataFile->m_ppDataPtrs[i]);
+	{
+		if(!IsMappedData(i))
+			mem_free(m_pDataFile->m_ppDataPtrs[i]);
+	}
 
-	io_close(m_pDataFile->m_File);
+	if(m_pDataFile->m_File)
+		io_close(m_pDataFile->m_File);
+	io_unmap(m_pDataFile->m_pMapped, m_pDataFile->m_FileSize);
+	DataCacheRelease(m_pDataFile->m_pCache);
 	mem_free(m_pDataFile);
 	m_pDataFile = 0;
 	return true;
@@ -426,6 +755,8 @@ unsigned CDataFileReader::Crc()
 CDataFileWriter::CDataFileWriter()
 {
 	m_File = 0;
+	m_DataFile = 0;
+	m_NumThreads = 0;
 	m_pItemTypes = static_cast<CItemTypeInfo *>(mem_alloc(sizeof(CItemTypeInfo) * MAX_ITEM_TYPES, 1));
 	m_pItems = static_cast<CItemInfo *>(mem_alloc(sizeof(CItemInfo) * MAX_ITEMS, 1));
 	m_pDatas = static_cast<CDataInfo *>(mem_alloc(sizeof(CDataInfo) * MAX_DATAS, 1));
@@ -433,6 +764,20 @@ CDataFileWriter::CDataFileWriter()
 
 CDataFileWriter::~CDataFileWriter()
 {
+	// never finished, throw the half written file away
+	if(m_File)
+	{
+		StopThreads();
+		for(int i = 0; i < m_NumItems; i++)
+			mem_free(m_pItems[i].m_pData);
+		for(int i = m_NumWrittenDatas; i < m_NumDatas; i++)
+			mem_free(m_pDatas[i].m_pCompressedData);
+		io_close(m_DataFile);
+		io_close(m_File);
+		m_pStorage->RemoveFile(m_aDataFilename, IStorage::TYPE_SAVE);
+		m_pStorage->RemoveFile(m_aTempFilename, IStorage::TYPE_SAVE);
+	}
+
 	mem_free(m_pItemTypes);
 	m_pItemTypes = 0;
 	mem_free(m_pItems);
@@ -441,12 +786,25 @@ CDataFileWriter::~CDataFileWriter()
 	m_pDatas = 0;
 }
 
-bool CDataFileWriter::Open(class IStorage *pStorage, const char *pFilename)
+bool CDataFileWriter::Open(class IStorage *pStorage, const char *pFilename, int MaxThreads)
 {
 	dbg_assert(!m_File, "a file already exists");
-	m_File = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	m_pStorage = pStorage;
+	str_copy(m_aFilename, pFilename, sizeof(m_aFilename));
+	str_format(m_aTempFilename, sizeof(m_aTempFilename), "%s.tmp", pFilename);
+	str_format(m_aDataFilename, sizeof(m_aDataFilename), "%s.data.tmp", pFilename);
+
+	m_File = pStorage->OpenFile(m_aTempFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 	if(!m_File)
 		return false;
+	m_DataFile = pStorage->OpenFile(m_aDataFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!m_DataFile)
+	{
+		io_close(m_File);
+		m_File = 0;
+		pStorage->RemoveFile(m_aTempFilename, IStorage::TYPE_SAVE);
+		return false;
+	}
 
 	m_NumItems = 0;
 	m_NumDatas = 0;
@@ -459,6 +817,22 @@ bool CDataFileWriter::Open(class IStorage *pStorage, const char *pFilename)
 		m_pItemTypes[i].m_Last = -1;
 	}
 
+	m_NextCompress = 0;
+	m_NumWrittenDatas = 0;
+	m_StopThreads = false;
+	m_Lock = lock_create();
+	// with a single processor the workers would only add copying
+	m_NumThreads = 0;
+	int NumThreads = cpu_count() > 1 ? min(cpu_count(), (int)MAX_COMPRESS_THREADS) : 0;
+	if(MaxThreads >= 0)
+		NumThreads = min(MaxThreads, (int)MAX_COMPRESS_THREADS);
+	for(int i = 0; i < NumThreads; i++)
+	{
+		m_apThreads[m_NumThreads] = thread_init(CompressThread, this);
+		if(m_apThreads[m_NumThreads])
+			m_NumThreads++;
+	}
+
 	return true;
 }
 
@@ -498,30 +872,132 @@ int CDataFileWriter::AddItem(int Type, int ID, int Size, void *pData)
 	return m_NumItems-1;
 }
 
+void CDataFileWriter::CompressData(CDataInfo *pInfo, const void *pData)
+{
+	unsigned long s = compressBound(pInfo->m_UncompressedSize);
+	void *pCompData = mem_alloc(s, 1);
+
+	int Result = compress((Bytef*)pCompData, &s, (Bytef*)pData, pInfo->m_UncompressedSize); // ignore_convention
+	if(Result != Z_OK)
+	{
+		dbg_msg("datafile", "compression error %d", Result);
+		dbg_assert(0, "zlib error");
+	}
+
+	pInfo->m_CompressedSize = (int)s;
+	pInfo->m_pCompressedData = pCompData;
+}
+
+// takes the next added data off the queue and compresses it, false if there is none
+bool CDataFileWriter::CompressNext()
+{
+	lock_wait(m_Lock);
+	if(m_NextCompress == m_NumDatas)
+	{
+		lock_unlock(m_Lock);
+		return false;
+	}
+	CDataInfo *pInfo = &m_pDatas[m_NextCompress++];
+	lock_unlock(m_Lock);
+
+	CompressData(pInfo, pInfo->m_pUncompressedData);
+	mem_free(pInfo->m_pUncompressedData);
+	pInfo->m_pUncompressedData = 0;
+
+	lock_wait(m_Lock);
+	pInfo->m_Compressed = true;
+	lock_unlock(m_Lock);
+	return true;
+}
+
+void CDataFileWriter::CompressThread(void *pUser)
+{
+	CDataFileWriter *pSelf = (CDataFileWriter *)pUser;
+	while(1)
+	{
+		if(pSelf->CompressNext())
+			continue;
+
+		// the queue is drained before a stop is looked at
+		lock_wait(pSelf->m_Lock);
+		bool Stop = pSelf->m_StopThreads;
+		lock_unlock(pSelf->m_Lock);
+		if(Stop)
+			break;
+		thread_sleep(1);
+	}
+}
+
+void CDataFileWriter::StopThreads()
+{
+	lock_wait(m_Lock);
+	m_StopThreads = true;
+	lock_unlock(m_Lock);
+	for(int i = 0; i < m_NumThreads; i++)
+		thread_wait(m_apThreads[i]);
+	m_NumThreads = 0;
+
+	lock_destroy(m_Lock);
+}
+
+// writes the datas before Num to the data file in order, waits for the workers if needed
+void CDataFileWriter::WriteCompressedDatas(int Num)
+{
+	while(m_NumWrittenDatas < Num)
+	{
+		CDataInfo *pInfo = &m_pDatas[m_NumWrittenDatas];
+		lock_wait(m_Lock);
+		bool Compressed = pInfo->m_Compressed;
+		lock_unlock(m_Lock);
+		if(!Compressed)
+		{
+			// help out instead of only waiting for the workers
+			if(!CompressNext())
+				thread_sleep(1);
+			continue;
+		}
+
+		if(DEBUG)
+			dbg_msg("datafile", "writing data id=%d size=%d", m_NumWrittenDatas, pInfo->m_CompressedSize);
+		io_write(m_DataFile, pInfo->m_pCompressedData, pInfo->m_CompressedSize);
+		mem_free(pInfo->m_pCompressedData);
+		pInfo->m_pCompressedData = 0;
+		m_NumWrittenDatas++;
+	}
+}
+
 int CDataFileWriter::AddData(int Size, void *pData)
 {
 	if(!m_File) return 0;
 
 	dbg_assert(m_NumDatas < 1024, "too much data");
 
+	// don't hold more than a few datas in memory when the workers fall behind
+	if(m_NumDatas-m_NumWrittenDatas >= MAX_PENDING_DATAS)
+		WriteCompressedDatas(m_NumDatas-MAX_PENDING_DATAS+1);
+
 	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
-	unsigned long s = compressBound(Size);
-	void *pCompData = mem_alloc(s, 1); // temporary buffer that we use during compression
+	pInfo->m_UncompressedSize = Size;
+	pInfo->m_CompressedSize = 0;
+	pInfo->m_pUncompressedData = 0;
+	pInfo->m_pCompressedData = 0;
+	pInfo->m_Compressed = false;
 
-	int Result = compress((Bytef*)pCompData, &s, (Bytef*)pData, Size); // ignore_convention
-	if(Result != Z_OK)
+	if(m_NumThreads)
 	{
-		dbg_msg("datafile", "compression error %d", Result);
-		dbg_assert(0, "zlib error");
+		// the caller may free its data right away
+		pInfo->m_pUncompressedData = mem_alloc(max(Size, 1), 1);
+		mem_copy(pInfo->m_pUncompressedData, pData, Size);
+	}
+	else
+	{
+		CompressData(pInfo, pData);
+		pInfo->m_Compressed = true;
 	}
 
-	pInfo->m_UncompressedSize = Size;
-	pInfo->m_CompressedSize = (int)s;
-	pInfo->m_pCompressedData = mem_alloc(pInfo->m_CompressedSize, 1);
-	mem_copy(pInfo->m_pCompressedData, pCompData, pInfo->m_CompressedSize);
-	mem_free(pCompData);
-
+	lock_wait(m_Lock);
 	m_NumDatas++;
+	lock_unlock(m_Lock);
 	return m_NumDatas-1;
 }
 
@@ -555,6 +1031,12 @@ int CDataFileWriter::Finish()
 	if(DEBUG)
 		dbg_msg("datafile", "writing");
 
+	// wait for the rest of the data
+	WriteCompressedDatas(m_NumDatas);
+	StopThreads();
+	io_close(m_DataFile);
+	m_DataFile = 0;
+
 	// calculate sizes
 	for(int i = 0; i < m_NumItems; i++)
 	{
@@ -700,23 +1182,49 @@ int CDataFileWriter::Finish()
 		}
 	}
 
-	// write data
-	for(int i = 0; i < m_NumDatas; i++)
+	// write data, it is in the data file already
+	IOHANDLE DataFile = m_pStorage->OpenFile(m_aDataFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if(DataFile)
 	{
-		if(DEBUG)
-			dbg_msg("datafile", "writing data id=%d size=%d", i, m_pDatas[i].m_CompressedSize);
-		io_write(m_File, m_pDatas[i].m_pCompressedData, m_pDatas[i].m_CompressedSize);
+		char aBuffer[64*1024];
+		while(1)
+		{
+			unsigned Bytes = io_read(DataFile, aBuffer, sizeof(aBuffer));
+			if(Bytes <= 0)
+				break;
+			io_write(m_File, aBuffer, Bytes);
+		}
+		io_close(DataFile);
 	}
+	m_pStorage->RemoveFile(m_aDataFilename, IStorage::TYPE_SAVE);
 
 	// free data
 	for(int i = 0; i < m_NumItems; i++)
 		mem_free(m_pItems[i].m_pData);
-	for(int i = 0; i < m_NumDatas; ++i)
-		mem_free(m_pDatas[i].m_pCompressedData);
 
+	bool Complete = io_tell(m_File) == FileSize;
 	io_close(m_File);
 	m_File = 0;
 
+	// replace the old file only with a complete one
+	if(!Complete)
+	{
+		dbg_msg("datafile", "failed to write '%s'", m_aFilename);
+		m_pStorage->RemoveFile(m_aTempFilename, IStorage::TYPE_SAVE);
+		return 1;
+	}
+	if(!m_pStorage->RenameFile(m_aTempFilename, m_aFilename, IStorage::TYPE_SAVE))
+	{
+		// renaming doesn't replace files everywhere
+		m_pStorage->RemoveFile(m_aFilename, IStorage::TYPE_SAVE);
+		if(!m_pStorage->RenameFile(m_aTempFilename, m_aFilename, IStorage::TYPE_SAVE))
+		{
+			dbg_msg("datafile", "failed to replace '%s'", m_aFilename);
+			m_pStorage->RemoveFile(m_aTempFilename, IStorage::TYPE_SAVE);
+			return 1;
+		}
+	}
+
 	if(DEBUG)
 		dbg_msg("datafile", "done");
 	return 0;
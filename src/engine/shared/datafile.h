@@ -3,11 +3,16 @@
 #ifndef ENGINE_SHARED_DATAFILE_H
 #define ENGINE_SHARED_DATAFILE_H
 
+#include <base/system.h>
+
 // raw datafile access
 class CDataFileReader
 {
 	struct CDatafile *m_pDataFile;
 	void *GetDataImpl(int Index, int Swap);
+	const char *GetMappedData(int Index);
+	bool IsMappedData(int Index) const;
+	static void PrefetchThread(void *pUser);
 public:
 	CDataFileReader() : m_pDataFile(0) {}
 	~CDataFileReader() { Close(); }
@@ -22,7 +27,10 @@ public:
 	void *GetData(int Index);
 	void *GetDataSwapped(int Index); // makes sure that the data is 32bit LE ints when saved
 	int GetDataSize(int Index);
+	int GetUncompressedDataSize(int Index);
 	void UnloadData(int Index);
+	// decompresses the given data (the first Num when pIndices is 0) on several threads up front
+	void PrefetchData(const int *pIndices, int Num);
 	void *GetItem(int Index, int *pType, int *pID);
 	int GetItemSize(int Index);
 	void GetType(int Type, int *pStart, int *pNum);
@@ -41,7 +49,9 @@ class CDataFileWriter
 	{
 		int m_UncompressedSize;
 		int m_CompressedSize;
-		void *m_pCompressedData;
+		void *m_pUncompressedData; // until a worker has compressed it
+		void *m_pCompressedData; // until it is written to the data file
+		bool m_Compressed;
 	};
 
 	struct CItemInfo
@@ -66,9 +76,19 @@ class CDataFileWriter
 		MAX_ITEM_TYPES=0xffff,
 		MAX_ITEMS=1024,
 		MAX_DATAS=1024,
+		MAX_COMPRESS_THREADS=4,
+		MAX_PENDING_DATAS=16, // added but not yet written datas, AddData waits beyond this
+		MAX_PATH_LENGTH=512,
 	};
 
+	class IStorage *m_pStorage;
+	char m_aFilename[MAX_PATH_LENGTH];
+	char m_aTempFilename[MAX_PATH_LENGTH];
+	char m_aDataFilename[MAX_PATH_LENGTH];
+
+	// the file is written to a temp file that replaces the wanted one at the end
 	IOHANDLE m_File;
+	IOHANDLE m_DataFile; // compressed datas in order, copied behind the items at the end
 	int m_NumItems;
 	int m_NumDatas;
 	int m_NumItemTypes;
@@ -76,10 +96,27 @@ class CDataFileWriter
 	CItemInfo *m_pItems;
 	CDataInfo *m_pDatas;
 
+	// the datas are compressed by the workers in the order they are added,
+	// they poll under the lock as semaphores are not available everywhere
+	LOCK m_Lock;
+	void *m_apThreads[MAX_COMPRESS_THREADS];
+	int m_NumThreads;
+	int m_NextCompress;
+	int m_NumWrittenDatas;
+	bool m_StopThreads;
+
+	static void CompressData(CDataInfo *pInfo, const void *pData);
+	static void CompressThread(void *pUser);
+	bool CompressNext();
+	void WriteCompressedDatas(int Num);
+	void StopThreads();
+
 public:
 	CDataFileWriter();
 	~CDataFileWriter();
-	bool Open(class IStorage *pStorage, const char *Filename);
+	// MaxThreads compression workers, -1 picks them by the processors,
+	// off by default until datafile_bench shows a win on more than one core
+	bool Open(class IStorage *pStorage, const char *Filename, int MaxThreads = 0);
 	int AddData(int Size, void *pData);
 	int AddDataSwapped(int Size, void *pData);
 	int AddItem(int Type, int ID, int Size, void *pData);
@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 
 #include <engine/console.h>
 #include <engine/storage.h>
@@ -10,6 +11,7 @@
 #include "demo.h"
 #include "memheap.h"
 #include "network.h"
+#include "packer.h"
 #include "snapshot.h"
 
 static const unsigned char gs_aHeaderMarker[7] = {'T', 'W', 'D', 'E', 'M', 'O', 0};
@@ -17,6 +19,8 @@ static const unsigned char gs_ActVersion = 4;
 static const unsigned char gs_OldVersion = 3;
 static const int gs_LengthOffset = 152;
 static const int gs_NumMarkersOffset = 176;
+static const unsigned char gs_aIndexMarker[4] = {'I', 'N', 'D', 'X'};
+static const int gs_IndexMsgID = 0x3ff; // unknown to the game, sent as a system message
 
 
 CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta)
@@ -24,19 +28,27 @@ CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta)
 	m_File = 0;
 	m_LastTickMarker = -1;
 	m_pSnapshotDelta = pSnapshotDelta;
+	m_pQueue = 0;
+	m_pWriterThread = 0;
+	m_pLastSnapshotData = 0;
+	m_pCompressBuffer = 0;
+	m_pWriteBuffer = 0;
+	m_QueuePeak = 0;
+	m_NumDropped = 0;
+	m_pReplay = 0;
+	m_ReplayLock = 0;
+	m_pSaveThread = 0;
+	m_pIndex = 0;
 }
 
-// Record
-int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetVersion, const char *pMap, unsigned Crc, const char *pType)
+CDemoRecorder::~CDemoRecorder()
 {
-	CDemoHeader Header;
-	CTimelineMarkers TimelineMarkers;
-	if(m_File)
-		return -1;
-
-	m_pConsole = pConsole;
+	Stop();
+	WaitForReplaySave();
+}
 
-	// open mapfile
+static IOHANDLE OpenDemoMapFile(class IStorage *pStorage, const char *pMap, unsigned Crc)
+{
 	char aMapFilename[128];
 	// try the normal maps folder
 	str_format(aMapFilename, sizeof(aMapFilename), "maps/%s.map", pMap);
@@ -55,27 +67,15 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 		if(pStorage->FindFile(aMapFilename, "maps", IStorage::TYPE_ALL, aBuf, sizeof(aBuf)))
 			MapFile = pStorage->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
 	}
-	if(!MapFile)
-	{
-		char aBuf[256];
-		str_format(aBuf, sizeof(aBuf), "Unable to open mapfile '%s'", pMap);
-		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
-		return -1;
-	}
-
-	IOHANDLE DemoFile = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
-	if(!DemoFile)
-	{
-		io_close(MapFile);
-		MapFile = 0;
-		char aBuf[256];
-		str_format(aBuf, sizeof(aBuf), "Unable to open '%s' for recording", pFilename);
-		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
-		return -1;
-	}
+	return MapFile;
+}
 
-	// write header
+static void WriteDemoHeader(IOHANDLE DemoFile, IOHANDLE MapFile, const char *pNetVersion, const char *pMap, unsigned Crc, const char *pType, int Length)
+{
+	CDemoHeader Header;
+	CTimelineMarkers TimelineMarkers;
 	mem_zero(&Header, sizeof(Header));
+	mem_zero(&TimelineMarkers, sizeof(TimelineMarkers));
 	mem_copy(Header.m_aMarker, gs_aHeaderMarker, sizeof(Header.m_aMarker));
 	Header.m_Version = gs_ActVersion;
 	str_copy(Header.m_aNetversion, pNetVersion, sizeof(Header.m_aNetversion));
@@ -90,35 +90,109 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	Header.m_aMapCrc[2] = (Crc>>8)&0xff;
 	Header.m_aMapCrc[3] = (Crc)&0xff;
 	str_copy(Header.m_aType, pType, sizeof(Header.m_aType));
-	// Header.m_Length - add this on stop
+	Header.m_aLength[0] = (Length>>24)&0xff;
+	Header.m_aLength[1] = (Length>>16)&0xff;
+	Header.m_aLength[2] = (Length>>8)&0xff;
+	Header.m_aLength[3] = (Length)&0xff;
 	str_timestamp(Header.m_aTimestamp, sizeof(Header.m_aTimestamp));
 	io_write(DemoFile, &Header, sizeof(Header));
 	io_write(DemoFile, &TimelineMarkers, sizeof(TimelineMarkers)); // fill this on stop
+}
 
-	// write map data
-	while(1)
+// Record
+int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetVersion, const char *pMap, unsigned Crc, const char *pType)
+{
+	if(IsRecording())
+		return -1;
+
+	m_pConsole = pConsole;
+
+	// open mapfile
+	IOHANDLE MapFile = OpenDemoMapFile(pStorage, pMap, Crc);
+	if(!MapFile)
 	{
-		unsigned char aChunk[1024*64];
-		int Bytes = io_read(MapFile, &aChunk, sizeof(aChunk));
-		if(Bytes <= 0)
-			break;
-		io_write(DemoFile, &aChunk, Bytes);
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "Unable to open mapfile '%s'", pMap);
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
+		return -1;
 	}
-	io_close(MapFile);
 
-	m_LastKeyFrame = -1;
-	m_LastTickMarker = -1;
-	m_FirstTick = -1;
-	m_NumTimelineMarkers = 0;
+	IOHANDLE DemoFile = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!DemoFile)
+	{
+		io_close(MapFile);
+		MapFile = 0;
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "Unable to open '%s' for recording", pFilename);
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
+		return -1;
+	}
+
+	// write header, the length is added on stop
+	WriteDemoHeader(DemoFile, MapFile, pNetVersion, pMap, Crc, pType, 0);
+
+	// the writer thread copies the map data before the first chunk
+	m_MapFile = MapFile;
+	m_File = DemoFile;
+	StartWriter(QUEUE_SIZE);
 
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "Recording to '%s'", pFilename);
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
-	m_File = DemoFile;
 
 	return 0;
 }
 
+int CDemoRecorder::StartReplay(class IConsole *pConsole, int Seconds)
+{
+	if(IsRecording())
+		return -1;
+
+	m_pConsole = pConsole;
+	m_pReplay = (unsigned char *)mem_alloc(REPLAY_SIZE, 1);
+	m_ReplayLock = lock_create();
+	m_ReplayTicks = Seconds*SERVER_TICK_SPEED;
+	m_ReplayStart = 0;
+	m_ReplayEnd = 0;
+	m_FirstReplaySegment = 0;
+	m_NumReplaySegments = 0;
+	m_ReplayBroken = true;
+
+	m_MapFile = 0;
+	StartWriter(REPLAY_QUEUE_SIZE);
+	return 0;
+}
+
+void CDemoRecorder::StartWriter(unsigned QueueSize)
+{
+	m_LastTickMarker = -1;
+	m_FirstTick = -1;
+	m_NumTimelineMarkers = 0;
+
+	m_pQueue = (unsigned char *)mem_alloc(QueueSize, sizeof(CQueuedChunk));
+	m_QueueSize = QueueSize;
+	m_QueueWrite = 0;
+	m_QueueRead = 0;
+	m_ForceKeyFrame = false;
+	m_QueuePeak = 0;
+	m_NumDropped = 0;
+
+	m_WriterLastTickMarker = -1;
+	m_LastKeyFrame = -1;
+	m_pLastSnapshotData = (unsigned char *)mem_alloc(CSnapshot::MAX_SIZE, 1);
+	m_pCompressBuffer = (unsigned char *)mem_alloc(COMPRESS_BUFFER_SIZE*2, 1);
+	m_pWriteBuffer = m_pReplay ? 0 : (unsigned char *)mem_alloc(WRITE_BUFFER_SIZE, 1); // a replay stays in memory
+	m_WriteBufferSize = 0;
+	m_WriteFailed = false;
+	m_FilePos = sizeof(CDemoHeader)+sizeof(CTimelineMarkers);
+	m_pIndex = 0;
+	m_IndexSize = 0;
+	m_NumIndex = 0;
+	m_IndexPos = -1;
+	m_Stopping = false;
+	m_pWriterThread = thread_init(WriterThread, this);
+}
+
 /*
 	Tickmarker
 		7	= Always set
@@ -147,9 +221,181 @@ enum
 	CHUNKFLAG_BIGSIZE = 0x10
 };
 
+void CDemoRecorder::Queue(int Type, int Tick, const void *pData, int Size)
+{
+	if(!IsRecording())
+		return;
+
+	// the chunk has to be contiguous, the rest of the queue is skipped if it doesn't fit there
+	int Needed = sizeof(CQueuedChunk) + ((Size+sizeof(CQueuedChunk)-1)/sizeof(CQueuedChunk))*sizeof(CQueuedChunk);
+	unsigned Write = m_QueueWrite;
+	unsigned Read = m_QueueRead;
+	unsigned Pos = Write&(m_QueueSize-1);
+	unsigned Padding = m_QueueSize-Pos < (unsigned)Needed ? m_QueueSize-Pos : 0;
+	if(m_QueueSize-(Write-Read) < Padding+Needed)
+	{
+		// the writer can't keep up, the delta chain breaks here
+		m_NumDropped++;
+		if(Type != QUEUED_MESSAGE)
+			m_ForceKeyFrame = true;
+		return;
+	}
+
+	if(Padding)
+	{
+		CQueuedChunk *pPadding = (CQueuedChunk *)(m_pQueue+Pos);
+		pPadding->m_Type = QUEUED_PADDING;
+		pPadding->m_Size = Padding-sizeof(CQueuedChunk);
+		Pos = 0;
+	}
+
+	CQueuedChunk *pChunk = (CQueuedChunk *)(m_pQueue+Pos);
+	if(Type == QUEUED_SNAPSHOT && m_ForceKeyFrame)
+		Type = QUEUED_KEYFRAME;
+	pChunk->m_Type = Type;
+	pChunk->m_Tick = Tick;
+	pChunk->m_Size = Size;
+	mem_copy(pChunk+1, pData, Size);
+	if(Type != QUEUED_MESSAGE)
+		m_ForceKeyFrame = false;
+
+	// publish the chunk after its data
+	sync_barrier();
+	m_QueueWrite = Write+Padding+Needed;
+	m_QueuePeak = max(m_QueuePeak, (int)(m_QueueWrite-Read));
+}
+
+void CDemoRecorder::WriterThread(void *pUser)
+{
+	CDemoRecorder *pSelf = (CDemoRecorder *)pUser;
+
+	// write map data
+	while(pSelf->m_MapFile)
+	{
+		int Bytes = io_read(pSelf->m_MapFile, pSelf->m_pCompressBuffer, COMPRESS_BUFFER_SIZE);
+		if(Bytes <= 0)
+		{
+			io_close(pSelf->m_MapFile);
+			pSelf->m_MapFile = 0;
+			break;
+		}
+		pSelf->WriteFile(pSelf->m_pCompressBuffer, Bytes);
+	}
+
+	while(1)
+	{
+		// the stop flag is read before the queue, so the chunks queued before it are seen
+		unsigned Read = pSelf->m_QueueRead;
+		bool Stopping = pSelf->m_Stopping;
+		sync_barrier();
+		if(Read == pSelf->m_QueueWrite)
+		{
+			// everything queued before the stop has been written
+			if(Stopping)
+				break;
+			thread_sleep(5);
+			continue;
+		}
+		sync_barrier();
+
+		const CQueuedChunk *pChunk = (const CQueuedChunk *)(pSelf->m_pQueue+(Read&(pSelf->m_QueueSize-1)));
+		if(pChunk->m_Type != QUEUED_PADDING)
+		{
+			// the replay is saved from the main thread, it only sees whole chunks
+			if(pSelf->m_pReplay)
+				lock_wait(pSelf->m_ReplayLock);
+			pSelf->WriteQueuedChunk(pChunk, (const unsigned char *)(pChunk+1));
+			if(pSelf->m_pReplay)
+				lock_unlock(pSelf->m_ReplayLock);
+		}
+		int Size = sizeof(CQueuedChunk) + ((pChunk->m_Size+sizeof(CQueuedChunk)-1)/sizeof(CQueuedChunk))*sizeof(CQueuedChunk);
+
+		// hand the space back after the chunk has been read
+		sync_barrier();
+		pSelf->m_QueueRead = Read+Size;
+	}
+
+	if(pSelf->m_File)
+		pSelf->WriteIndex();
+	pSelf->FlushFile();
+}
+
+void CDemoRecorder::WriteQueuedChunk(const CQueuedChunk *pChunk, const unsigned char *pData)
+{
+	if(pChunk->m_Type == QUEUED_MESSAGE)
+	{
+		Write(CHUNKTYPE_MESSAGE, pData, pChunk->m_Size);
+		return;
+	}
+
+	int Tick = pChunk->m_Tick;
+	if(pChunk->m_Type == QUEUED_KEYFRAME || m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*5)
+	{
+		if(m_pReplay)
+			BeginReplaySegment(Tick);
+		else
+			AddIndexEntry(Tick);
+
+		// write full tickmarker
+		WriteTickMarker(Tick, 1);
+
+		// write snapshot
+		Write(CHUNKTYPE_SNAPSHOT, pData, pChunk->m_Size);
+
+		m_LastKeyFrame = Tick;
+		mem_copy(m_pLastSnapshotData, pData, pChunk->m_Size);
+	}
+	else
+	{
+		// create delta, prepend tick
+		char aDeltaData[CSnapshot::MAX_SIZE+sizeof(int)];
+		int DeltaSize;
+
+		// write tickmarker
+		WriteTickMarker(Tick, 0);
+
+		DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot*)m_pLastSnapshotData, (CSnapshot*)pData, &aDeltaData);
+		if(DeltaSize)
+		{
+			// record delta
+			Write(CHUNKTYPE_DELTA, aDeltaData, DeltaSize);
+			mem_copy(m_pLastSnapshotData, pData, pChunk->m_Size);
+		}
+	}
+}
+
+void CDemoRecorder::WriteFile(const void *pData, int Size)
+{
+	if(m_pReplay)
+	{
+		WriteReplay(pData, Size);
+		return;
+	}
+
+	m_FilePos += Size;
+	const unsigned char *pSrc = (const unsigned char *)pData;
+	while(Size)
+	{
+		if(m_WriteBufferSize == WRITE_BUFFER_SIZE)
+			FlushFile();
+		int Chunk = min(Size, WRITE_BUFFER_SIZE-m_WriteBufferSize);
+		mem_copy(m_pWriteBuffer+m_WriteBufferSize, pSrc, Chunk);
+		m_WriteBufferSize += Chunk;
+		pSrc += Chunk;
+		Size -= Chunk;
+	}
+}
+
+void CDemoRecorder::FlushFile()
+{
+	if(m_File && m_WriteBufferSize && io_write(m_File, m_pWriteBuffer, m_WriteBufferSize) != (unsigned)m_WriteBufferSize)
+		m_WriteFailed = true;
+	m_WriteBufferSize = 0;
+}
+
 void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
 {
-	if(m_LastTickMarker == -1 || Tick-m_LastTickMarker > 63 || Keyframe)
+	if(m_WriterLastTickMarker == -1 || Tick-m_WriterLastTickMarker > 63 || Keyframe)
 	{
 		unsigned char aChunk[5];
 		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER;
@@ -161,43 +407,38 @@ void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
 		if(Keyframe)
 			aChunk[0] |= CHUNKTICKFLAG_KEYFRAME;
 
-		io_write(m_File, aChunk, sizeof(aChunk));
+		WriteFile(aChunk, sizeof(aChunk));
 	}
 	else
 	{
 		unsigned char aChunk[1];
-		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | (Tick-m_LastTickMarker);
-		io_write(m_File, aChunk, sizeof(aChunk));
+		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | (Tick-m_WriterLastTickMarker);
+		WriteFile(aChunk, sizeof(aChunk));
 	}
 
-	m_LastTickMarker = Tick;
-	if(m_FirstTick < 0)
-		m_FirstTick = Tick;
+	m_WriterLastTickMarker = Tick;
 }
 
 void CDemoRecorder::Write(int Type, const void *pData, int Size)
 {
-	char aBuffer[64*1024];
-	char aBuffer2[64*1024];
+	unsigned char *pBuffer = m_pCompressBuffer;
+	unsigned char *pBuffer2 = m_pCompressBuffer+COMPRESS_BUFFER_SIZE;
 	unsigned char aChunk[3];
 
-	if(!m_File)
-		return;
-
 	/* pad the data with 0 so we get an alignment of 4,
 	else the compression won't work and miss some bytes */
-	mem_copy(aBuffer2, pData, Size);
+	mem_copy(pBuffer2, pData, Size);
 	while(Size&3)
-		aBuffer2[Size++] = 0;
-	Size = CVariableInt::Compress(aBuffer2, Size, aBuffer); // buffer2 -> buffer
-	Size = CNetBase::Compress(aBuffer, Size, aBuffer2, sizeof(aBuffer2)); // buffer -> buffer2
+		pBuffer2[Size++] = 0;
+	Size = CVariableInt::Compress(pBuffer2, Size, pBuffer); // buffer2 -> buffer
+	Size = CNetBase::Compress(pBuffer, Size, pBuffer2, COMPRESS_BUFFER_SIZE); // buffer -> buffer2
 
 
 	aChunk[0] = ((Type&0x3)<<5);
 	if(Size < 30)
 	{
 		aChunk[0] |= Size;
-		io_write(m_File, aChunk, 1);
+		WriteFile(aChunk, 1);
 	}
 	else
 	{
@@ -205,62 +446,80 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 		{
 			aChunk[0] |= 30;
 			aChunk[1] = Size&0xff;
-			io_write(m_File, aChunk, 2);
+			WriteFile(aChunk, 2);
 		}
 		else
 		{
 			aChunk[0] |= 31;
 			aChunk[1] = Size&0xff;
 			aChunk[2] = Size>>8;
-			io_write(m_File, aChunk, 3);
+			WriteFile(aChunk, 3);
 		}
 	}
 
-	io_write(m_File, aBuffer2, Size);
+	WriteFile(pBuffer2, Size);
 }
 
 void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 {
-	if(m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*5)
-	{
-		// write full tickmarker
-		WriteTickMarker(Tick, 1);
-
-		// write snapshot
-		Write(CHUNKTYPE_SNAPSHOT, pData, Size);
+	Queue(QUEUED_SNAPSHOT, Tick, pData, Size);
 
-		m_LastKeyFrame = Tick;
-		mem_copy(m_aLastSnapshotData, pData, Size);
-	}
-	else
-	{
-		// create delta, prepend tick
-		char aDeltaData[CSnapshot::MAX_SIZE+sizeof(int)];
-		int DeltaSize;
+	// every snapshot gets a tickmarker in the file
+	m_LastTickMarker = Tick;
+	if(m_FirstTick < 0)
+		m_FirstTick = Tick;
+}
 
-		// write tickmarker
-		WriteTickMarker(Tick, 0);
+void CDemoRecorder::RecordMessage(const void *pData, int Size)
+{
+	Queue(QUEUED_MESSAGE, 0, pData, Size);
+}
 
-		DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)pData, &aDeltaData);
-		if(DeltaSize)
-		{
-			// record delta
-			Write(CHUNKTYPE_DELTA, aDeltaData, DeltaSize);
-			mem_copy(m_aLastSnapshotData, pData, Size);
-		}
-	}
+void CDemoRecorder::TakeQueueStats(int *pQueued, int *pPeak, int *pDropped)
+{
+	*pQueued = IsRecording() ? (int)(m_QueueWrite-m_QueueRead) : 0;
+	*pPeak = m_QueuePeak;
+	*pDropped = m_NumDropped;
+	m_QueuePeak = *pQueued;
+	m_NumDropped = 0;
 }
 
-void CDemoRecorder::RecordMessage(const void *pData, int Size)
+void CDemoRecorder::StopWriter()
 {
-	Write(CHUNKTYPE_MESSAGE, pData, Size);
+	// let the writer finish everything queued so far
+	sync_barrier();
+	m_Stopping = true;
+	thread_wait(m_pWriterThread);
+	m_pWriterThread = 0;
+
+	mem_free(m_pQueue);
+	m_pQueue = 0;
+	mem_free(m_pLastSnapshotData);
+	m_pLastSnapshotData = 0;
+	mem_free(m_pCompressBuffer);
+	m_pCompressBuffer = 0;
+	mem_free(m_pWriteBuffer);
+	m_pWriteBuffer = 0;
+	mem_free(m_pIndex);
+	m_pIndex = 0;
 }
 
 int CDemoRecorder::Stop()
 {
-	if(!m_File)
+	if(!IsRecording())
 		return -1;
 
+	StopWriter();
+
+	if(m_pReplay)
+	{
+		lock_destroy(m_ReplayLock);
+		m_ReplayLock = 0;
+		mem_free(m_pReplay);
+		m_pReplay = 0;
+		return 0;
+	}
+
 	// add the demo length to the header
 	io_seek(m_File, gs_LengthOffset, IOSEEK_START);
 	int DemoLength = Length();
@@ -290,8 +549,23 @@ int CDemoRecorder::Stop()
 		io_write(m_File, aMarker, sizeof(aMarker));
 	}
 
+	// point the last two marker slots to the index, players only read the used ones
+	if(m_IndexPos >= 0 && m_NumTimelineMarkers <= MAX_TIMELINE_MARKERS-2)
+	{
+		io_seek(m_File, gs_NumMarkersOffset+4+(MAX_TIMELINE_MARKERS-2)*4, IOSEEK_START);
+		io_write(m_File, gs_aIndexMarker, sizeof(gs_aIndexMarker));
+		char aPos[4];
+		aPos[0] = (m_IndexPos>>24)&0xff;
+		aPos[1] = (m_IndexPos>>16)&0xff;
+		aPos[2] = (m_IndexPos>>8)&0xff;
+		aPos[3] = (m_IndexPos)&0xff;
+		io_write(m_File, aPos, sizeof(aPos));
+	}
+
 	io_close(m_File);
 	m_File = 0;
+	if(m_WriteFailed)
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", "Writing the demo failed, it is incomplete");
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", "Stopped recording");
 
 	return 0;
@@ -315,6 +589,199 @@ void CDemoRecorder::AddDemoMarker()
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", "Added timeline marker");
 }
 
+void CDemoRecorder::AddIndexEntry(int Tick)
+{
+	if(m_NumIndex == m_IndexSize)
+	{
+		m_IndexSize = m_IndexSize ? m_IndexSize*2 : 256;
+		CIndexEntry *pIndex = (CIndexEntry *)mem_alloc(m_IndexSize*sizeof(CIndexEntry), 1);
+		if(m_pIndex)
+			mem_copy(pIndex, m_pIndex, m_NumIndex*sizeof(CIndexEntry));
+		mem_free(m_pIndex);
+		m_pIndex = pIndex;
+	}
+	m_pIndex[m_NumIndex].m_Tick = Tick;
+	m_pIndex[m_NumIndex].m_Filepos = m_FilePos;
+	m_NumIndex++;
+}
+
+void CDemoRecorder::WriteIndex()
+{
+	if(!m_NumIndex || m_WriteFailed)
+		return;
+
+	// very long demos keep every nth keyframe, seeking decodes more deltas there
+	int Step = (m_NumIndex+MAX_INDEX_ENTRIES-1)/MAX_INDEX_ENTRIES;
+	int Num = (m_NumIndex+Step-1)/Step;
+
+	// packed like a message: id, number of keyframes, last tick, then the deltas of tick and position
+	unsigned char *pData = (unsigned char *)mem_alloc(4*5+Num*2*5, 1);
+	unsigned char *pEnd = pData;
+	pEnd = CVariableInt::Pack(pEnd, (gs_IndexMsgID<<1)|1);
+	pEnd = CVariableInt::Pack(pEnd, Num);
+	pEnd = CVariableInt::Pack(pEnd, m_WriterLastTickMarker);
+	int LastTick = 0, LastPos = 0;
+	for(int i = 0; i < m_NumIndex; i += Step)
+	{
+		pEnd = CVariableInt::Pack(pEnd, m_pIndex[i].m_Tick-LastTick);
+		pEnd = CVariableInt::Pack(pEnd, m_pIndex[i].m_Filepos-LastPos);
+		LastTick = m_pIndex[i].m_Tick;
+		LastPos = m_pIndex[i].m_Filepos;
+	}
+
+	m_IndexPos = m_FilePos;
+	Write(CHUNKTYPE_MESSAGE, pData, (int)(pEnd-pData));
+	mem_free(pData);
+}
+
+void CDemoRecorder::BeginReplaySegment(int Tick)
+{
+	if(m_NumReplaySegments == MAX_REPLAY_SEGMENTS)
+		DropReplaySegment();
+
+	CReplaySegment *pSegment = &m_aReplaySegments[(m_FirstReplaySegment+m_NumReplaySegments)%MAX_REPLAY_SEGMENTS];
+	pSegment->m_Start = m_ReplayEnd;
+	pSegment->m_Tick = Tick;
+	if(!m_NumReplaySegments)
+		m_ReplayStart = m_ReplayEnd;
+	m_NumReplaySegments++;
+	m_ReplayBroken = false;
+
+	// the oldest segment is only needed while the next one doesn't cover the replay length
+	while(m_NumReplaySegments > 1 && m_aReplaySegments[(m_FirstReplaySegment+1)%MAX_REPLAY_SEGMENTS].m_Tick <= Tick-m_ReplayTicks)
+		DropReplaySegment();
+}
+
+void CDemoRecorder::DropReplaySegment()
+{
+	m_FirstReplaySegment = (m_FirstReplaySegment+1)%MAX_REPLAY_SEGMENTS;
+	m_NumReplaySegments--;
+	m_ReplayStart = m_NumReplaySegments ? m_aReplaySegments[m_FirstReplaySegment].m_Start : m_ReplayEnd;
+}
+
+void CDemoRecorder::WriteReplay(const void *pData, int Size)
+{
+	if(m_ReplayBroken)
+		return;
+
+	// make room at the front, but never drop the segment that is written
+	while(m_ReplayEnd+Size-m_ReplayStart > REPLAY_SIZE && m_NumReplaySegments > 1)
+		DropReplaySegment();
+	if(m_ReplayEnd+Size-m_ReplayStart > REPLAY_SIZE)
+	{
+		// a single segment doesn't fit, start over at the next keyframe
+		m_NumReplaySegments = 0;
+		m_ReplayStart = m_ReplayEnd;
+		m_ReplayBroken = true;
+		m_LastKeyFrame = -1;
+		return;
+	}
+
+	const unsigned char *pSrc = (const unsigned char *)pData;
+	while(Size)
+	{
+		unsigned Pos = m_ReplayEnd&(REPLAY_SIZE-1);
+		int Chunk = min(Size, (int)(REPLAY_SIZE-Pos));
+		mem_copy(m_pReplay+Pos, pSrc, Chunk);
+		m_ReplayEnd += Chunk;
+		pSrc += Chunk;
+		Size -= Chunk;
+	}
+}
+
+struct CReplaySaveJob
+{
+	IOHANDLE m_MapFile;
+	IOHANDLE m_File;
+	unsigned char *m_pData;
+	int m_Size;
+};
+
+void CDemoRecorder::ReplaySaveThread(void *pUser)
+{
+	CReplaySaveJob *pJob = (CReplaySaveJob *)pUser;
+
+	unsigned char *pBuffer = (unsigned char *)mem_alloc(COMPRESS_BUFFER_SIZE, 1);
+	while(1)
+	{
+		int Bytes = io_read(pJob->m_MapFile, pBuffer, COMPRESS_BUFFER_SIZE);
+		if(Bytes <= 0)
+			break;
+		io_write(pJob->m_File, pBuffer, Bytes);
+	}
+	mem_free(pBuffer);
+
+	if(io_write(pJob->m_File, pJob->m_pData, pJob->m_Size) != (unsigned)pJob->m_Size)
+		dbg_msg("demo_recorder", "writing the replay failed, it is incomplete");
+
+	io_close(pJob->m_MapFile);
+	io_close(pJob->m_File);
+	mem_free(pJob->m_pData);
+	delete pJob;
+}
+
+int CDemoRecorder::SaveReplay(class IStorage *pStorage, const char *pFilename, const char *pNetVersion, const char *pMap, unsigned Crc, const char *pType)
+{
+	if(!m_pReplay)
+		return -1;
+
+	// copy the segments out, the writer goes on meanwhile
+	lock_wait(m_ReplayLock);
+	int Size = m_ReplayEnd-m_ReplayStart;
+	int FirstTick = m_NumReplaySegments ? m_aReplaySegments[m_FirstReplaySegment].m_Tick : 0;
+	int LastTick = m_WriterLastTickMarker;
+	unsigned char *pData = 0;
+	if(m_NumReplaySegments)
+	{
+		pData = (unsigned char *)mem_alloc(Size, 1);
+		unsigned Pos = m_ReplayStart&(REPLAY_SIZE-1);
+		int First = min(Size, (int)(REPLAY_SIZE-Pos));
+		mem_copy(pData, m_pReplay+Pos, First);
+		mem_copy(pData+First, m_pReplay, Size-First);
+	}
+	lock_unlock(m_ReplayLock);
+
+	if(!pData)
+	{
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", "Nothing to save in the replay yet");
+		return -1;
+	}
+
+	IOHANDLE MapFile = OpenDemoMapFile(pStorage, pMap, Crc);
+	IOHANDLE DemoFile = MapFile ? pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE) : 0;
+	if(!DemoFile)
+	{
+		if(MapFile)
+			io_close(MapFile);
+		mem_free(pData);
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "Unable to save the replay to '%s'", pFilename);
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
+		return -1;
+	}
+
+	WriteDemoHeader(DemoFile, MapFile, pNetVersion, pMap, Crc, pType, (LastTick-FirstTick)/SERVER_TICK_SPEED);
+
+	CReplaySaveJob *pJob = new CReplaySaveJob;
+	pJob->m_MapFile = MapFile;
+	pJob->m_File = DemoFile;
+	pJob->m_pData = pData;
+	pJob->m_Size = Size;
+	WaitForReplaySave();
+	m_pSaveThread = thread_init(ReplaySaveThread, pJob);
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "Saving the last %d seconds to '%s'", (LastTick-FirstTick)/SERVER_TICK_SPEED, pFilename);
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
+	return 0;
+}
+
+void CDemoRecorder::WaitForReplaySave()
+{
+	if(m_pSaveThread)
+		thread_wait(m_pSaveThread);
+	m_pSaveThread = 0;
+}
 
 
 CDemoPlayer::CDemoPlayer(class CSnapshotDelta *pSnapshotDelta)
@@ -324,6 +791,7 @@ CDemoPlayer::CDemoPlayer(class CSnapshotDelta *pSnapshotDelta)
 
 	m_pSnapshotDelta = pSnapshotDelta;
 	m_LastSnapshotDataSize = -1;
+	m_SeekTick = -1;
 }
 
 void CDemoPlayer::SetListner(IListner *pListner)
@@ -387,6 +855,88 @@ int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
 	return 0;
 }
 
+int CDemoPlayer::ReadChunkData(int Size, char *pData, const char **ppError)
+{
+	static char aCompresseddata[CSnapshot::MAX_SIZE];
+	static char aDecompressed[CSnapshot::MAX_SIZE];
+
+	if(io_read(m_File, aCompresseddata, Size) != (unsigned)Size)
+	{
+		*ppError = "error reading chunk";
+		return -1;
+	}
+
+	int DataSize = CNetBase::Decompress(aCompresseddata, Size, aDecompressed, sizeof(aDecompressed));
+	if(DataSize < 0)
+	{
+		*ppError = "error during network decompression";
+		return -1;
+	}
+
+	DataSize = CVariableInt::Decompress(aDecompressed, DataSize, pData);
+	if(DataSize < 0)
+	{
+		*ppError = "error during intpack decompression";
+		return -1;
+	}
+	return DataSize;
+}
+
+static bool IsIndexMessage(const void *pData, int Size)
+{
+	CUnpacker Unpacker;
+	Unpacker.Reset(pData, Size);
+	return Unpacker.GetInt() == ((gs_IndexMsgID<<1)|1) && !Unpacker.Error();
+}
+
+bool CDemoPlayer::ReadIndex(long IndexPos)
+{
+	static char aData[CSnapshot::MAX_SIZE];
+	long StartPos = io_tell(m_File);
+	int ChunkType, ChunkSize, ChunkTick = 0;
+	const char *pError;
+	int DataSize = -1;
+
+	io_seek(m_File, IndexPos, IOSEEK_START);
+	if(!ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick) && ChunkType == CHUNKTYPE_MESSAGE && ChunkSize)
+		DataSize = ReadChunkData(ChunkSize, aData, &pError);
+	io_seek(m_File, StartPos, IOSEEK_START);
+	if(DataSize < 0 || !IsIndexMessage(aData, DataSize))
+		return false;
+
+	CUnpacker Unpacker;
+	Unpacker.Reset(aData, DataSize);
+	Unpacker.GetInt();
+	int Num = Unpacker.GetInt();
+	int LastTick = Unpacker.GetInt();
+	if(Unpacker.Error() || Num <= 0 || Num > DataSize/2)
+		return false;
+
+	CKeyFrame *pKeyFrames = (CKeyFrame*)mem_alloc(Num*sizeof(CKeyFrame), 1);
+	int Tick = 0;
+	long Pos = 0;
+	bool Valid = true;
+	for(int i = 0; i < Num && Valid; i++)
+	{
+		Tick += Unpacker.GetInt();
+		Pos += Unpacker.GetInt();
+		pKeyFrames[i].m_Tick = Tick;
+		pKeyFrames[i].m_Filepos = Pos;
+		Valid = !Unpacker.Error() && Pos >= StartPos && Pos < IndexPos && Tick <= LastTick && (!i || Tick > pKeyFrames[i-1].m_Tick);
+	}
+	if(!Valid)
+	{
+		mem_free(pKeyFrames);
+		return false;
+	}
+
+	m_pKeyFrames = pKeyFrames;
+	m_Info.m_SeekablePoints = Num;
+	m_Info.m_Info.m_FirstTick = pKeyFrames[0].m_Tick;
+	m_Info.m_Info.m_LastTick = LastTick;
+	return true;
+}
+
 void CDemoPlayer::ScanFile()
 {
 	long StartPos;
@@ -445,10 +995,14 @@ void CDemoPlayer::ScanFile()
 	io_seek(m_File, StartPos, IOSEEK_START);
 }
 
+void CDemoPlayer::OnSnapshot(void *pData, int Size)
+{
+	if(m_pListner && m_Info.m_Info.m_CurrentTick >= m_SeekTick)
+		m_pListner->OnDemoPlayerSnapshot(pData, Size);
+}
+
 void CDemoPlayer::DoTick()
 {
-	static char aCompresseddata[CSnapshot::MAX_SIZE];
-	static char aDecompressed[CSnapshot::MAX_SIZE];
 	static char aData[CSnapshot::MAX_SIZE];
 	int ChunkType, ChunkTick, ChunkSize;
 	int DataSize = 0;
@@ -478,28 +1032,12 @@ void CDemoPlayer::DoTick()
 		// read the chunk
 		if(ChunkSize)
 		{
-			if(io_read(m_File, aCompresseddata, ChunkSize) != (unsigned)ChunkSize)
-			{
-				// stop on error or eof
-				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "error reading chunk");
-				Stop();
-				break;
-			}
-
-			DataSize = CNetBase::Decompress(aCompresseddata, ChunkSize, aDecompressed, sizeof(aDecompressed));
+			const char *pError;
+			DataSize = ReadChunkData(ChunkSize, aData, &pError);
 			if(DataSize < 0)
 			{
 				// stop on error or eof
-				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "error during network decompression");
-				Stop();
-				break;
-			}
-
-			DataSize = CVariableInt::Decompress(aDecompressed, DataSize, aData);
-
-			if(DataSize < 0)
-			{
-				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "error during intpack decompression");
+				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", pError);
 				Stop();
 				break;
 			}
@@ -516,8 +1054,7 @@ void CDemoPlayer::DoTick()
 
 			if(DataSize >= 0)
 			{
-				if(m_pListner)
-					m_pListner->OnDemoPlayerSnapshot(aNewsnap, DataSize);
+				OnSnapshot(aNewsnap, DataSize);
 
 				m_LastSnapshotDataSize = DataSize;
 				mem_copy(m_aLastSnapshotData, aNewsnap, DataSize);
@@ -536,16 +1073,15 @@ void CDemoPlayer::DoTick()
 
 			m_LastSnapshotDataSize = DataSize;
 			mem_copy(m_aLastSnapshotData, aData, DataSize);
-			if(m_pListner)
-				m_pListner->OnDemoPlayerSnapshot(aData, DataSize);
+			OnSnapshot(aData, DataSize);
 		}
 		else
 		{
 			// if there were no snapshots in this tick, replay the last one
-			if(!GotSnapshot && m_pListner && m_LastSnapshotDataSize != -1)
+			if(!GotSnapshot && m_LastSnapshotDataSize != -1)
 			{
 				GotSnapshot = 1;
-				m_pListner->OnDemoPlayerSnapshot(m_aLastSnapshotData, m_LastSnapshotDataSize);
+				OnSnapshot(m_aLastSnapshotData, m_LastSnapshotDataSize);
 			}
 
 			// check the remaining types
@@ -556,7 +1092,7 @@ void CDemoPlayer::DoTick()
 			}
 			else if(ChunkType == CHUNKTYPE_MESSAGE)
 			{
-				if(m_pListner)
+				if(m_pListner && !IsIndexMessage(aData, DataSize))
 					m_pListner->OnDemoPlayerMessage(aData, DataSize);
 			}
 		}
@@ -680,8 +1216,13 @@ int CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole, const
 		}
 	}
 
-	// scan the file for interessting points
-	ScanFile();
+	// use the keyframe index if there is one, else scan the file for interessting points
+	const char *pIndexMarker = m_Info.m_TimelineMarkers.m_aTimelineMarkers[MAX_TIMELINE_MARKERS-2];
+	const char *pIndexPos = m_Info.m_TimelineMarkers.m_aTimelineMarkers[MAX_TIMELINE_MARKERS-1];
+	long IndexPos = ((pIndexPos[0]<<24)&0xFF000000) | ((pIndexPos[1]<<16)&0xFF0000) | ((pIndexPos[2]<<8)&0xFF00) | (pIndexPos[3]&0xFF);
+	if(m_Info.m_Header.m_Version <= gs_OldVersion || m_Info.m_Info.m_NumTimelineMarkers > MAX_TIMELINE_MARKERS-2 ||
+		mem_comp(pIndexMarker, gs_aIndexMarker, sizeof(gs_aIndexMarker)) != 0 || !ReadIndex(IndexPos))
+		ScanFile();
 
 	// ready for playback
 	return 0;
@@ -717,18 +1258,20 @@ int CDemoPlayer::SetPos(float Percent)
 	// -5 because we have to have a current tick and previous tick when we do the playback
 	WantedTick = m_Info.m_Info.m_FirstTick + (int)((m_Info.m_Info.m_LastTick-m_Info.m_Info.m_FirstTick)*Percent) - 5;
 
-	Keyframe = (int)(m_Info.m_SeekablePoints*Percent);
-
-	if(Keyframe < 0 || Keyframe >= m_Info.m_SeekablePoints)
+	if(Percent < 0.0f || Percent > 1.0f || !m_Info.m_SeekablePoints)
 		return -1;
 
-	// get correct key frame
-	if(m_pKeyFrames[Keyframe].m_Tick < WantedTick)
-		while(Keyframe < m_Info.m_SeekablePoints-1 && m_pKeyFrames[Keyframe].m_Tick < WantedTick)
-			Keyframe++;
-
-	while(Keyframe && m_pKeyFrames[Keyframe].m_Tick > WantedTick)
-		Keyframe--;
+	// get the last key frame before the tick
+	int Low = 0, High = m_Info.m_SeekablePoints-1;
+	while(Low < High)
+	{
+		int Mid = (Low+High+1)/2;
+		if(m_pKeyFrames[Mid].m_Tick > WantedTick)
+			High = Mid-1;
+		else
+			Low = Mid;
+	}
+	Keyframe = Low;
 
 	// seek to the correct keyframe
 	io_seek(m_File, m_pKeyFrames[Keyframe].m_Filepos, IOSEEK_START);
@@ -738,9 +1281,11 @@ int CDemoPlayer::SetPos(float Percent)
 	m_Info.m_Info.m_CurrentTick = -1;
 	m_Info.m_PreviousTick = -1;
 
-	// playback everything until we hit our tick
-	while(m_Info.m_PreviousTick < WantedTick)
+	// playback everything until we hit our tick, only the last snapshots are passed on
+	m_SeekTick = WantedTick;
+	while(m_Info.m_PreviousTick < WantedTick && IsPlaying())
 		DoTick();
+	m_SeekTick = -1;
 
 	Play();
 
@@ -8,22 +8,129 @@
 
 #include "snapshot.h"
 
+/*
+	Recording only copies the raw snapshots and messages into a bounded
+	queue. A writer thread takes them out in order and does the deltas,
+	the compression and the file writes. If the queue is full the chunk
+	is dropped and the next snapshot becomes a keyframe.
+
+	Started as an instant replay the writer keeps the encoded chunks in a
+	ring in memory instead. The ring is made of segments that start at a
+	keyframe, whole segments are dropped from the front once they are
+	older than the replay length or the ring is full. SaveReplay() writes
+	the segments in the ring to a demo file on another thread.
+
+	A recorded file ends with an index of the keyframe positions. It is a
+	system message to older players, which they skip, and two spare
+	timeline marker slots in the header point to it.
+*/
 class CDemoRecorder : public IDemoRecorder
 {
+	enum
+	{
+		QUEUE_SIZE=4*1024*1024,
+		WRITE_BUFFER_SIZE=256*1024,
+		COMPRESS_BUFFER_SIZE=64*1024,
+		REPLAY_QUEUE_SIZE=1024*1024,
+		REPLAY_SIZE=2*1024*1024,
+		MAX_REPLAY_SEGMENTS=128,
+		MAX_INDEX_ENTRIES=2048,
+
+		QUEUED_PADDING=0,
+		QUEUED_SNAPSHOT,
+		QUEUED_KEYFRAME, // a snapshot that has to be written in full
+		QUEUED_MESSAGE,
+	};
+
+	// followed by the data, every queued chunk takes a multiple of its size
+	struct CQueuedChunk
+	{
+		int m_Type;
+		int m_Tick;
+		int m_Size;
+		int m_Reserved;
+	};
+
 	class IConsole *m_pConsole;
 	IOHANDLE m_File;
 	int m_LastTickMarker;
-	int m_LastKeyFrame;
 	int m_FirstTick;
-	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
 	class CSnapshotDelta *m_pSnapshotDelta;
 	int m_NumTimelineMarkers;
 	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
 
+	// queue, written by the recording thread and read by the writer thread
+	unsigned char *m_pQueue;
+	unsigned m_QueueSize;
+	volatile unsigned m_QueueWrite;
+	volatile unsigned m_QueueRead;
+	bool m_ForceKeyFrame;
+	int m_QueuePeak;
+	int m_NumDropped;
+
+	// writer thread
+	void *m_pWriterThread;
+	volatile bool m_Stopping;
+	IOHANDLE m_MapFile;
+	int m_WriterLastTickMarker;
+	int m_LastKeyFrame;
+	unsigned char *m_pLastSnapshotData;
+	unsigned char *m_pCompressBuffer;
+	unsigned char *m_pWriteBuffer;
+	int m_WriteBufferSize;
+	bool m_WriteFailed;
+	int m_FilePos;
+
+	// keyframe positions for the index
+	struct CIndexEntry
+	{
+		int m_Tick;
+		int m_Filepos;
+	};
+
+	CIndexEntry *m_pIndex;
+	int m_IndexSize;
+	int m_NumIndex;
+	int m_IndexPos;
+
+	// instant replay, the offsets count all bytes ever written to the ring
+	struct CReplaySegment
+	{
+		unsigned m_Start;
+		int m_Tick;
+	};
+
+	unsigned char *m_pReplay;
+	LOCK m_ReplayLock;
+	int m_ReplayTicks;
+	unsigned m_ReplayStart;
+	unsigned m_ReplayEnd;
+	CReplaySegment m_aReplaySegments[MAX_REPLAY_SEGMENTS];
+	int m_FirstReplaySegment;
+	int m_NumReplaySegments;
+	bool m_ReplayBroken; // the current segment didn't fit, wait for the next keyframe
+	void *m_pSaveThread; // the last SaveReplay(), joined before the next one and on destruction
+
+	void StartWriter(unsigned QueueSize);
+	void StopWriter();
+	void BeginReplaySegment(int Tick);
+	void DropReplaySegment();
+	void WriteReplay(const void *pData, int Size);
+	static void ReplaySaveThread(void *pUser);
+	void AddIndexEntry(int Tick);
+	void WriteIndex();
+
+	void Queue(int Type, int Tick, const void *pData, int Size);
+	static void WriterThread(void *pUser);
+	void WriteQueuedChunk(const CQueuedChunk *pChunk, const unsigned char *pData);
+	void WriteFile(const void *pData, int Size);
+	void FlushFile();
+
 	void WriteTickMarker(int Tick, int Keyframe);
 	void Write(int Type, const void *pData, int Size);
 public:
 	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta);
+	~CDemoRecorder();
 
 	int Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetversion, const char *pMap, unsigned MapCrc, const char *pType);
 	int Stop();
@@ -32,9 +139,18 @@ public:
 	void RecordSnapshot(int Tick, const void *pData, int Size);
 	void RecordMessage(const void *pData, int Size);
 
-	bool IsRecording() const { return m_File != 0; }
+	// keep the last seconds of the recording in memory instead of a file
+	int StartReplay(class IConsole *pConsole, int Seconds);
+	int SaveReplay(class IStorage *pStorage, const char *pFilename, const char *pNetversion, const char *pMap, unsigned MapCrc, const char *pType);
+	void WaitForReplaySave();
+
+	bool IsRecording() const { return m_File != 0 || m_pReplay != 0; }
+	bool IsReplay() const { return m_pReplay != 0; }
 
 	int Length() const { return (m_LastTickMarker - m_FirstTick)/SERVER_TICK_SPEED; }
+
+	// bytes waiting for the writer now and at most, and chunks dropped since the last call
+	void TakeQueueStats(int *pQueued, int *pPeak, int *pDropped);
 };
 
 class CDemoPlayer : public IDemoPlayer
@@ -93,10 +209,14 @@ private:
 	int m_DemoType;
 	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
 	int m_LastSnapshotDataSize;
+	int m_SeekTick; // snapshots before it are decoded but not passed on
 	class CSnapshotDelta *m_pSnapshotDelta;
 
 	int ReadChunkHeader(int *pType, int *pSize, int *pTick);
+	int ReadChunkData(int Size, char *pData, const char **ppError);
 	void DoTick();
+	void OnSnapshot(void *pData, int Size);
+	bool ReadIndex(long IndexPos);
 	void ScanFile();
 	int NextFrame();
 
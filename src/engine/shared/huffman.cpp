@@ -1,6 +1,10 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <string.h>
+
+#include <base/math.h>
 #include <base/system.h>
+
 #include "huffman.h"
 
 struct CHuffmanConstructNode
@@ -94,108 +98,187 @@ void CHuffman::ConstructTree(const unsigned *pFrequencies)
 	Setbits_r(m_pStartNode, 0, 0);
 }
 
-void CHuffman::Init(const unsigned *pFrequencies)
+// the codecs read and write whole little endian words where there is room for them
+static inline unsigned long long LoadWord(const unsigned char *pSrc)
 {
-	int i;
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+	unsigned long long Word;
+	memcpy(&Word, pSrc, sizeof(Word));
+	return Word;
+#else
+	unsigned long long Word = 0;
+	for(int i = 0; i < 8; i++)
+		Word |= (unsigned long long)pSrc[i] << (i*8);
+	return Word;
+#endif
+}
 
+static inline void StoreWord(unsigned char *pDst, unsigned long long Word)
+{
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+	memcpy(pDst, &Word, sizeof(Word));
+#else
+	for(int i = 0; i < 8; i++)
+		pDst[i] = (unsigned char)(Word >> (i*8));
+#endif
+}
+
+void CHuffman::Init(const unsigned *pFrequencies)
+{
 	// make sure to cleanout every thing
 	mem_zero(this, sizeof(*this));
 
 	// construct the tree
 	ConstructTree(pFrequencies);
 
-	// build decode LUT
-	for(i = 0; i < HUFFMAN_LUTSIZE; i++)
+	m_MaxBits = 0;
+	for(int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
+		m_MaxBits = max(m_MaxBits, m_aNodes[i].m_NumBits);
+
+	// build decode LUT, every entry resolves as many whole codes as fit into its bits
+	for(int i = 0; i < HUFFMAN_LUTSIZE; i++)
 	{
-		unsigned Bits = i;
-		int k;
-		CNode *pNode = m_pStartNode;
-		for(k = 0; k < HUFFMAN_LUTBITS; k++)
+		CLutEntry *pEntry = &m_aDecodeLut[i];
+		pEntry->m_NumSymbols = 0;
+		pEntry->m_NumBits = 0;
+		pEntry->m_Node = HUFFMAN_NO_NODE;
+
+		while(pEntry->m_NumSymbols < HUFFMAN_LUTSYMBOLS)
 		{
-			pNode = &m_aNodes[pNode->m_aLeafs[Bits&1]];
-			Bits >>= 1;
+			unsigned Bits = i >> pEntry->m_NumBits;
+			int k = pEntry->m_NumBits;
+			CNode *pNode = m_pStartNode;
+			for(; k < HUFFMAN_LUTBITS && !pNode->m_NumBits; k++)
+			{
+				pNode = &m_aNodes[pNode->m_aLeafs[Bits&1]];
+				Bits >>= 1;
+			}
 
-			if(!pNode)
+			if(!pNode->m_NumBits)
+			{
+				// the code is longer than the lut, only the first one gets walked on from there
+				if(pEntry->m_NumSymbols == 0)
+				{
+					pEntry->m_NumBits = HUFFMAN_LUTBITS;
+					pEntry->m_Node = pNode - m_aNodes;
+				}
 				break;
+			}
 
-			if(pNode->m_NumBits)
+			pEntry->m_NumBits = k;
+			if(pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL])
 			{
-				m_apDecodeLut[i] = pNode;
+				pEntry->m_Node = HUFFMAN_EOF_SYMBOL;
 				break;
 			}
+			pEntry->m_aSymbols[pEntry->m_NumSymbols++] = pNode->m_Symbol;
 		}
-
-		if(k == HUFFMAN_LUTBITS)
-			m_apDecodeLut[i] = pNode;
 	}
-
 }
 
 //***************************************************************
-int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+void CHuffman::CEncoder::Init(const CHuffman *pHuffman, void *pOutput, int OutputSize)
 {
-	// this macro loads a symbol for a byte into bits and bitcount
-#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
-	Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
-	Bitcount += m_aNodes[Sym].m_NumBits;
-
-	// this macro writes the symbol stored in bits and bitcount to the dst pointer
-#define HUFFMAN_MACRO_WRITE() \
-	while(Bitcount >= 8) \
-	{ \
-		*pDst++ = (unsigned char)(Bits&0xff); \
-		if(pDst == pDstEnd) \
-			return -1; \
-		Bits >>= 8; \
-		Bitcount -= 8; \
+	m_pHuffman = pHuffman;
+	m_pDstStart = (unsigned char *)pOutput;
+	m_pDst = m_pDstStart;
+	m_pDstEnd = m_pDstStart + OutputSize;
+	m_Bits = 0;
+	m_Bitcount = 0;
+	m_Error = OutputSize <= 0;
+}
+
+void CHuffman::CEncoder::Flush()
+{
+	while(m_Bitcount >= 8)
+	{
+		*m_pDst++ = (unsigned char)(m_Bits&0xff);
+		m_Bits >>= 8;
+		m_Bitcount -= 8;
+		// the last byte is reserved for Finish()
+		if(m_pDst == m_pDstEnd)
+		{
+			m_Error = true;
+			return;
+		}
 	}
+}
 
-	// setup buffer pointers
+void CHuffman::CEncoder::Write(const void *pInput, int InputSize)
+{
+	if(m_Error)
+		return;
+
+	const CNode *pNodes = m_pHuffman->m_aNodes;
 	const unsigned char *pSrc = (const unsigned char *)pInput;
 	const unsigned char *pSrcEnd = pSrc + InputSize;
-	unsigned char *pDst = (unsigned char *)pOutput;
-	unsigned char *pDstEnd = pDst + OutputSize;
+	unsigned char *pDst = m_pDst;
+	unsigned long long Bits = m_Bits;
+	unsigned Bitcount = m_Bitcount;
 
-	// symbol variables
-	unsigned Bits = 0;
-	unsigned Bitcount = 0;
-
-	// make sure that we have data that we want to compress
-	if(InputSize)
+	// load two symbols and store a whole word while it fits, at most 7 bits stay behind
+	if(m_pHuffman->m_MaxBits*2+7 <= 64)
 	{
-		// {A} load the first symbol
-		int Symbol = *pSrc++;
-
-		while(pSrc != pSrcEnd)
+		while(pSrcEnd - pSrc >= 2 && m_pDstEnd - pDst >= 8)
 		{
-			// {B} load the symbol
-			HUFFMAN_MACRO_LOADSYMBOL(Symbol)
-
-			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
-			Symbol = *pSrc++;
-
-			// {B} write the symbol loaded at
-			HUFFMAN_MACRO_WRITE()
+			const CNode *pFirst = &pNodes[pSrc[0]];
+			const CNode *pSecond = &pNodes[pSrc[1]];
+			pSrc += 2;
+
+			Bits |= (unsigned long long)pFirst->m_Bits << Bitcount;
+			Bitcount += pFirst->m_NumBits;
+			Bits |= (unsigned long long)pSecond->m_Bits << Bitcount;
+			Bitcount += pSecond->m_NumBits;
+
+			StoreWord(pDst, Bits);
+			pDst += Bitcount>>3;
+			Bits >>= Bitcount&~7;
+			Bitcount &= 7;
 		}
+	}
 
-		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
-		HUFFMAN_MACRO_LOADSYMBOL(Symbol)
-		HUFFMAN_MACRO_WRITE()
+	m_pDst = pDst;
+	m_Bits = Bits;
+	m_Bitcount = Bitcount;
+
+	// byte by byte near the end of the output
+	while(pSrc != pSrcEnd)
+	{
+		const CNode *pNode = &pNodes[*pSrc++];
+		m_Bits |= (unsigned long long)pNode->m_Bits << m_Bitcount;
+		m_Bitcount += pNode->m_NumBits;
+		Flush();
+		if(m_Error)
+			return;
 	}
+}
 
-	// write EOF symbol
-	HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL)
-	HUFFMAN_MACRO_WRITE()
+int CHuffman::CEncoder::Finish()
+{
+	if(!m_Error)
+	{
+		// write EOF symbol
+		const CNode *pEof = &m_pHuffman->m_aNodes[HUFFMAN_EOF_SYMBOL];
+		m_Bits |= (unsigned long long)pEof->m_Bits << m_Bitcount;
+		m_Bitcount += pEof->m_NumBits;
+		Flush();
+	}
+	if(m_Error)
+		return -1;
 
 	// write out the last bits
-	*pDst++ = Bits;
+	*m_pDst++ = (unsigned char)m_Bits;
 
 	// return the size of the output
-	return (int)(pDst - (const unsigned char *)pOutput);
+	return (int)(m_pDst - m_pDstStart);
+}
 
-	// remove macros
-#undef HUFFMAN_MACRO_LOADSYMBOL
-#undef HUFFMAN_MACRO_WRITE
+int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+{
+	CEncoder Encoder;
+	Encoder.Init(this, pOutput, OutputSize);
+	Encoder.Write(pInput, InputSize);
+	return Encoder.Finish();
 }
 
 //***************************************************************
@@ -203,51 +286,43 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 {
 	// setup buffer pointers
 	unsigned char *pDst = (unsigned char *)pOutput;
-	unsigned char *pSrc = (unsigned char *)pInput;
+	const unsigned char *pSrc = (const unsigned char *)pInput;
 	unsigned char *pDstEnd = pDst + OutputSize;
-	unsigned char *pSrcEnd = pSrc + InputSize;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
 
-	unsigned Bits = 0;
-	unsigned Bitcount = 0;
+	// bits past the end of the input read as zeros, so the count can go negative
+	unsigned long long Bits = 0;
+	int Bitcount = 0;
 
 	CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
-	CNode *pNode = 0;
 
 	while(1)
 	{
-		// {A} try to load a node now, this will reduce dependency at location {D}
-		pNode = 0;
-		if(Bitcount >= HUFFMAN_LUTBITS)
-			pNode = m_apDecodeLut[Bits&HUFFMAN_LUTMASK];
-
-		// {B} fill with new bits
-		while(Bitcount < 24 && pSrc != pSrcEnd)
+		// {A} fill with new bits, a whole word at once if the input is long enough
+		if(pSrcEnd - pSrc >= 8)
 		{
-			Bits |= (*pSrc++) << Bitcount;
-			Bitcount += 8;
-		}
-
-		// {C} load symbol now if we didn't that earlier at location {A}
-		if(!pNode)
-			pNode = m_apDecodeLut[Bits&HUFFMAN_LUTMASK];
-
-		if(!pNode)
-			return -1;
-
-		// {D} check if we hit a symbol already
-		if(pNode->m_NumBits)
-		{
-			// remove the bits for that symbol
-			Bits >>= pNode->m_NumBits;
-			Bitcount -= pNode->m_NumBits;
+			Bits |= LoadWord(pSrc) << Bitcount;
+			pSrc += (63-Bitcount)>>3;
+			Bitcount |= 56;
 		}
 		else
 		{
-			// remove the bits that the lut checked up for us
-			Bits >>= HUFFMAN_LUTBITS;
-			Bitcount -= HUFFMAN_LUTBITS;
+			while(Bitcount <= 56 && pSrc != pSrcEnd)
+			{
+				Bits |= (unsigned long long)(*pSrc++) << Bitcount;
+				Bitcount += 8;
+			}
+		}
 
+		// {B} resolve the symbols the lut has for the next bits
+		const CLutEntry *pEntry = &m_aDecodeLut[Bits&HUFFMAN_LUTMASK];
+		Bits >>= pEntry->m_NumBits;
+		Bitcount -= pEntry->m_NumBits;
+
+		if(pEntry->m_Node != HUFFMAN_NO_NODE && pEntry->m_Node != HUFFMAN_EOF_SYMBOL)
+		{
 			// walk the tree bit by bit
+			CNode *pNode = &m_aNodes[pEntry->m_Node];
 			while(1)
 			{
 				// traverse tree
@@ -265,16 +340,30 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 				if(Bitcount == 0)
 					return -1;
 			}
+
+			// check for eof
+			if(pNode == pEof)
+				break;
+
+			// output character
+			if(pDst == pDstEnd)
+				return -1;
+			*pDst++ = pNode->m_Symbol;
+			continue;
 		}
 
+		// {C} output the characters, all slots at once if there is room
+		if(pDstEnd - pDst >= HUFFMAN_LUTSYMBOLS)
+			memcpy(pDst, pEntry->m_aSymbols, HUFFMAN_LUTSYMBOLS);
+		else if(pDstEnd - pDst >= pEntry->m_NumSymbols)
+			memcpy(pDst, pEntry->m_aSymbols, pEntry->m_NumSymbols);
+		else
+			return -1;
+		pDst += pEntry->m_NumSymbols;
+
 		// check for eof
-		if(pNode == pEof)
+		if(pEntry->m_Node == HUFFMAN_EOF_SYMBOL)
 			break;
-
-		// output character
-		if(pDst == pDstEnd)
-			return -1;
-		*pDst++ = pNode->m_Symbol;
 	}
 
 	// return the size of the decompressed buffer
@@ -16,7 +16,11 @@ class CHuffman
 
 		HUFFMAN_LUTBITS = 10,
 		HUFFMAN_LUTSIZE = (1<<HUFFMAN_LUTBITS),
-		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE-1)
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE-1),
+
+		// symbols a single decode lookup can resolve
+		HUFFMAN_LUTSYMBOLS = 4,
+		HUFFMAN_NO_NODE = 0xffff,
 	};
 
 	struct CNode
@@ -32,14 +36,52 @@ class CHuffman
 		unsigned char m_Symbol;
 	};
 
+	// all codes starting within the next HUFFMAN_LUTBITS bits that end there as well
+	struct CLutEntry
+	{
+		unsigned char m_aSymbols[HUFFMAN_LUTSYMBOLS];
+		unsigned char m_NumSymbols;
+		unsigned char m_NumBits;
+		// HUFFMAN_EOF_SYMBOL if the eof code follows the symbols, the inner node to continue
+		// walking from if the first code is longer than the lut or HUFFMAN_NO_NODE
+		unsigned short m_Node;
+	};
+
 	CNode m_aNodes[HUFFMAN_MAX_NODES];
-	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CLutEntry m_aDecodeLut[HUFFMAN_LUTSIZE];
 	CNode *m_pStartNode;
 	int m_NumNodes;
+	unsigned m_MaxBits;
 
 	void Setbits_r(CNode *pNode, int Bits, unsigned Depth);
 	void ConstructTree(const unsigned *pFrequencies);
 
+public:
+	/*
+		Class: CEncoder
+			Compresses data that is passed in several parts into one
+			buffer, the result is the same as compressing it at once.
+	*/
+	class CEncoder
+	{
+		const CHuffman *m_pHuffman;
+		unsigned char *m_pDst;
+		unsigned char *m_pDstStart;
+		unsigned char *m_pDstEnd;
+		unsigned long long m_Bits;
+		unsigned m_Bitcount;
+		bool m_Error;
+
+		void Flush();
+
+	public:
+		void Init(const CHuffman *pHuffman, void *pOutput, int OutputSize);
+		void Write(const void *pInput, int InputSize);
+
+		// writes the eof symbol. returns the size of the compressed data, negative on failure
+		int Finish();
+	};
+
 public:
 	/*
 		Function: huffman_init
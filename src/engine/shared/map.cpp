@@ -24,6 +24,16 @@ public:
 		m_DataFile.Close();
 	}
 
+	virtual void Prefetch()
+	{
+		m_DataFile.PrefetchData(0, m_DataFile.NumData());
+	}
+
+	virtual void Prefetch(const int *pIndices, int Num)
+	{
+		m_DataFile.PrefetchData(pIndices, Num);
+	}
+
 	virtual bool Load(const char *pMapName)
 	{
 		IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
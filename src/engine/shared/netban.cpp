@@ -38,18 +38,326 @@ CNetBan::CNetHash::CNetHash(const CNetRange *pRange)
 	m_Hash &= 0xFF;
 }
 
-int CNetBan::CNetHash::MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17])
+static int AddrBits(const NETADDR *pAddr)
 {
+	return pAddr->type == NETTYPE_IPV4 ? 32 : 128;
+}
+
+static int GetBit(const unsigned char *pIp, int Index)
+{
+	return (pIp[Index>>3]>>(7-(Index&7)))&1;
+}
+
+// number of leading bits the two share, up to Max
+static int CommonBits(const unsigned char *pIp1, const unsigned char *pIp2, int Max)
+{
+	int Bits = 0;
+	while(Bits < Max && pIp1[Bits>>3] == pIp2[Bits>>3] && Bits+8 <= Max)
+		Bits += 8;
+	while(Bits < Max && GetBit(pIp1, Bits) == GetBit(pIp2, Bits))
+		Bits++;
+	return Bits;
+}
+
+CNetBan::CBanTrie::CBanTrie()
+{
+	Reset();
+}
+
+void CNetBan::CBanTrie::Reset()
+{
+	m_aNodes.clear();
+	m_aRefs.clear();
+	m_FirstFreeNode = -1;
+	m_FirstFreeRef = -1;
+	m_aRoots[0] = m_aRoots[1] = -1;
+}
+
+int CNetBan::CBanTrie::NewNode(const unsigned char *pIp, int Bits)
+{
+	int Node = m_FirstFreeNode;
+	if(Node >= 0)
+		m_FirstFreeNode = m_aNodes[Node].m_aChildren[0];
+	else
+	{
+		Node = m_aNodes.size();
+		m_aNodes.push_back(CNode());
+	}
+
+	CNode *pNode = &m_aNodes[Node];
+	mem_zero(pNode->m_aPrefix, sizeof(pNode->m_aPrefix));
+	mem_copy(pNode->m_aPrefix, pIp, Bits>>3);
+	if(Bits&7)
+		pNode->m_aPrefix[Bits>>3] = pIp[Bits>>3]&(0xff<<(8-(Bits&7)));
+	pNode->m_Bits = Bits;
+	pNode->m_aChildren[0] = pNode->m_aChildren[1] = -1;
+	pNode->m_FirstRef = -1;
+	return Node;
+}
+
+void CNetBan::CBanTrie::FreeNode(int Node)
+{
+	m_aNodes[Node].m_aChildren[0] = m_FirstFreeNode;
+	m_FirstFreeNode = Node;
+}
+
+void CNetBan::CBanTrie::Add(const NETADDR *pAddr, int Bits, CBanAddr *pAddrBan, CBanRange *pRangeBan)
+{
+	const unsigned char *pIp = pAddr->ip;
+	int Parent = pAddr->type == NETTYPE_IPV4 ? -1 : -2;
+	int Side = 0;
+	int Node;
+
+	while(1)
+	{
+		int Child = *Link(Parent, Side);
+		if(Child < 0)
+		{
+			Node = NewNode(pIp, Bits);
+			*Link(Parent, Side) = Node;
+			break;
+		}
+
+		int ChildBits = m_aNodes[Child].m_Bits;
+		int Common = CommonBits(m_aNodes[Child].m_aPrefix, pIp, min(ChildBits, Bits));
+		if(Common == ChildBits && ChildBits == Bits)
+		{
+			Node = Child;
+			break;
+		}
+		if(Common == ChildBits)
+		{
+			// the child is a prefix of ours, go down
+			Parent = Child;
+			Side = GetBit(pIp, ChildBits);
+			continue;
+		}
+
+		if(Common == Bits)
+		{
+			// ours is a prefix of the child, put it above
+			Node = NewNode(pIp, Bits);
+			m_aNodes[Node].m_aChildren[GetBit(m_aNodes[Child].m_aPrefix, Bits)] = Child;
+			*Link(Parent, Side) = Node;
+			break;
+		}
+
+		// they part ways, branch where they do
+		int Branch = NewNode(pIp, Common);
+		Node = NewNode(pIp, Bits);
+		m_aNodes[Branch].m_aChildren[GetBit(m_aNodes[Child].m_aPrefix, Common)] = Child;
+		m_aNodes[Branch].m_aChildren[GetBit(pIp, Common)] = Node;
+		*Link(Parent, Side) = Branch;
+		break;
+	}
+
+	int Ref = m_FirstFreeRef;
+	if(Ref >= 0)
+		m_FirstFreeRef = m_aRefs[Ref].m_Next;
+	else
+	{
+		Ref = m_aRefs.size();
+		m_aRefs.push_back(CRef());
+	}
+	m_aRefs[Ref].m_pAddrBan = pAddrBan;
+	m_aRefs[Ref].m_pRangeBan = pRangeBan;
+	m_aRefs[Ref].m_Next = m_aNodes[Node].m_FirstRef;
+	m_aNodes[Node].m_FirstRef = Ref;
+}
+
+void CNetBan::CBanTrie::Remove(const NETADDR *pAddr, int Bits, const void *pBan)
+{
+	const unsigned char *pIp = pAddr->ip;
+	int aParents[130];
+	int aSides[130];
+	int Depth = 0;
+	aParents[0] = pAddr->type == NETTYPE_IPV4 ? -1 : -2;
+	aSides[0] = 0;
+
+	// find the node of the prefix
+	int Node = *Link(aParents[0], aSides[0]);
+	while(Node >= 0 && m_aNodes[Node].m_Bits < Bits)
+	{
+		if(CommonBits(m_aNodes[Node].m_aPrefix, pIp, m_aNodes[Node].m_Bits) != m_aNodes[Node].m_Bits)
+			return;
+		Depth++;
+		aParents[Depth] = Node;
+		aSides[Depth] = GetBit(pIp, m_aNodes[Node].m_Bits);
+		Node = m_aNodes[Node].m_aChildren[aSides[Depth]];
+	}
+	if(Node < 0 || m_aNodes[Node].m_Bits != Bits || CommonBits(m_aNodes[Node].m_aPrefix, pIp, Bits) != Bits)
+		return;
+
+	for(int *pRef = &m_aNodes[Node].m_FirstRef; *pRef >= 0; pRef = &m_aRefs[*pRef].m_Next)
+	{
+		CRef *pEntry = &m_aRefs[*pRef];
+		if(pEntry->m_pAddrBan != pBan && pEntry->m_pRangeBan != pBan)
+			continue;
+		int Ref = *pRef;
+		*pRef = pEntry->m_Next;
+		m_aRefs[Ref].m_Next = m_FirstFreeRef;
+		m_FirstFreeRef = Ref;
+		break;
+	}
+
+	// drop nodes that neither hold a ban nor branch
+	while(Node >= 0 && m_aNodes[Node].m_FirstRef < 0)
+	{
+		CNode *pNode = &m_aNodes[Node];
+		if(pNode->m_aChildren[0] >= 0 && pNode->m_aChildren[1] >= 0)
+			break;
+		*Link(aParents[Depth], aSides[Depth]) = pNode->m_aChildren[0] >= 0 ? pNode->m_aChildren[0] : pNode->m_aChildren[1];
+		FreeNode(Node);
+		if(Depth == 0)
+			break;
+		Node = aParents[Depth--];
+	}
+}
+
+void CNetBan::CBanTrie::Add(CBanAddr *pBan)
+{
+	Add(&pBan->m_Data, AddrBits(&pBan->m_Data), pBan, 0);
+}
+
+void CNetBan::CBanTrie::Remove(CBanAddr *pBan)
+{
+	Remove(&pBan->m_Data, AddrBits(&pBan->m_Data), pBan);
+}
+
+void CNetBan::CBanTrie::Add(CBanRange *pBan)
+{
+	struct CAdd
+	{
+		CBanTrie *m_pTrie;
+		CBanRange *m_pBan;
+
+		static void Prefix(const NETADDR *pPrefix, int Bits, void *pUser)
+		{
+			CAdd *pThis = (CAdd *)pUser;
+			pThis->m_pTrie->Add(pPrefix, Bits, 0, pThis->m_pBan);
+		}
+	};
+	CAdd Data = { this, pBan };
+	SplitRange(&pBan->m_Data, CAdd::Prefix, &Data);
+}
+
+void CNetBan::CBanTrie::Remove(CBanRange *pBan)
+{
+	struct CRemove
+	{
+		CBanTrie *m_pTrie;
+		CBanRange *m_pBan;
+
+		static void Prefix(const NETADDR *pPrefix, int Bits, void *pUser)
+		{
+			CRemove *pThis = (CRemove *)pUser;
+			pThis->m_pTrie->Remove(pPrefix, Bits, pThis->m_pBan);
+		}
+	};
+	CRemove Data = { this, pBan };
+	SplitRange(&pBan->m_Data, CRemove::Prefix, &Data);
+}
+
+bool CNetBan::CBanTrie::Find(const NETADDR *pAddr, CBanAddr **ppAddrBan, CBanRange **ppRangeBan) const
+{
+	if(pAddr->type != NETTYPE_IPV4 && pAddr->type != NETTYPE_IPV6)
+		return false;
+
+	const unsigned char *pIp = pAddr->ip;
+	int Found = -1;
+	int Node = m_aRoots[pAddr->type == NETTYPE_IPV4 ? 0 : 1];
+	while(Node >= 0)
+	{
+		const CNode *pNode = &m_aNodes[Node];
+		if(CommonBits(pNode->m_aPrefix, pIp, pNode->m_Bits) != pNode->m_Bits)
+			break;
+		if(pNode->m_FirstRef >= 0)
+			Found = pNode->m_FirstRef;
+		if(pNode->m_Bits == AddrBits(pAddr))
+			break;
+		Node = pNode->m_aChildren[GetBit(pIp, pNode->m_Bits)];
+	}
+
+	if(Found < 0)
+		return false;
+	*ppAddrBan = m_aRefs[Found].m_pAddrBan;
+	*ppRangeBan = m_aRefs[Found].m_pRangeBan;
+	return true;
+}
+
+void CNetBan::CBanTrie::SplitRange(const CNetRange *pRange, void (*pfnCallback)(const NETADDR *pPrefix, int Bits, void *pUser), void *pUser)
+{
+	int Length = AddrBits(&pRange->m_LB);
+	NETADDR Cur = pRange->m_LB;
+	while(1)
+	{
+		// the biggest aligned block starting here that stays inside the range
+		int Size = 0;
+		while(Size < Length && !GetBit(Cur.ip, Length-1-Size))
+			Size++;
+		while(Size > 0)
+		{
+			NETADDR Last = Cur;
+			for(int i = Length-Size; i < Length; i++)
+				Last.ip[i>>3] |= 1<<(7-(i&7));
+			if(mem_comp(Last.ip, pRange->m_UB.ip, Length/8) <= 0)
+				break;
+			Size--;
+		}
+		pfnCallback(&Cur, Length-Size, pUser);
+
+		// step past the block, done once that overflows or leaves the range
+		int Carry = 1;
+		for(int i = Length-1-Size; i >= 0 && Carry; i--)
+		{
+			Carry = GetBit(Cur.ip, i);
+			Cur.ip[i>>3] ^= 1<<(7-(i&7));
+		}
+		if(Carry || mem_comp(Cur.ip, pRange->m_UB.ip, Length/8) > 0)
+			break;
+	}
+}
+
+unsigned CNetBan::CFloodSketch::Hash(const NETADDR *pAddr, int Row)
+{
+	// FNV-1a with a seed per row, the port is left out
+	static const unsigned s_aSeeds[NUM_ROWS] = { 2166136261u, 0x9e3779b9u, 0x85ebca6bu, 0xc2b2ae35u };
+	unsigned Hash = s_aSeeds[Row];
 	int Length = pAddr->type == NETTYPE_IPV4 ? 4 : 16;
-	aHash[0].m_Hash = 0;
-	aHash[0].m_HashIndex = 0;
-	for(int i = 1, Sum = 0; i <= Length; ++i)
+	Hash = (Hash^pAddr->type)*16777619u;
+	for(int i = 0; i < Length; i++)
+		Hash = (Hash^pAddr->ip[i])*16777619u;
+	return (Hash^(Hash>>15))%NUM_CELLS;
+}
+
+void CNetBan::CFloodSketch::Reset()
+{
+	mem_zero(m_aaCells, sizeof(m_aaCells));
+}
+
+bool CNetBan::CFloodSketch::Take(const NETADDR *pAddr, int64 Now, int Rate, int Burst)
+{
+	float Drain = Rate/(float)time_freq();
+	CCell *apCells[NUM_ROWS];
+	float aLevels[NUM_ROWS];
+	float Level = 0.0f;
+	for(int r = 0; r < NUM_ROWS; r++)
+	{
+		apCells[r] = &m_aaCells[r][Hash(pAddr, r)];
+		aLevels[r] = max(apCells[r]->m_Level-(Now-apCells[r]->m_Time)*Drain, 0.0f);
+		Level = r == 0 ? aLevels[r] : min(Level, aLevels[r]);
+	}
+
+	if(Level+1.0f > Burst)
+		return false;
+
+	// conservative update, only the cells below the new level rise
+	for(int r = 0; r < NUM_ROWS; r++)
 	{
-		Sum += pAddr->ip[i - 1];
-		aHash[i].m_Hash = Sum & 0xFF;
-		aHash[i].m_HashIndex = i % Length;
+		apCells[r]->m_Level = max(aLevels[r], Level+1.0f);
+		apCells[r]->m_Time = Now;
 	}
-	return Length;
+	return true;
 }
 
 template<class T, int HashCount>
@@ -269,6 +577,7 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 	pBan = pBanPool->Add(pData, &Info, &NetHash);
 	if(pBan)
 	{
+		m_BanTrie.Add(pBan);
 		char aBuf[128];
 		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANADD);
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
@@ -288,7 +597,7 @@ int CNetBan::Unban(T *pBanPool, const typename T::CDataType *pData)
 	{
 		char aBuf[256];
 		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANREM);
-		pBanPool->Remove(pBan);
+		RemoveBan(pBan);
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
 		return 0;
 	}
@@ -303,6 +612,8 @@ void CNetBan::Init(IConsole *pConsole, IStorage *pStorage)
 	m_pStorage = pStorage;
 	m_BanAddrPool.Reset();
 	m_BanRangePool.Reset();
+	m_BanTrie.Reset();
+	m_FloodSketch.Reset();
 
 	net_host_lookup("localhost", &m_LocalhostIPV4, NETTYPE_IPV4);
 	net_host_lookup("localhost", &m_LocalhostIPV6, NETTYPE_IPV6);
@@ -326,13 +637,13 @@ void CNetBan::Update()
 	{
 		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanAddrPool.First()->m_Data, aNetStr, sizeof(aNetStr)));
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		m_BanAddrPool.Remove(m_BanAddrPool.First());
+		RemoveBan(m_BanAddrPool.First());
 	}
 	while(m_BanRangePool.First() && m_BanRangePool.First()->m_Info.m_Expires != CBanInfo::EXPIRES_NEVER && m_BanRangePool.First()->m_Info.m_Expires < Now)
 	{
 		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanRangePool.First()->m_Data, aNetStr, sizeof(aNetStr)));
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		m_BanRangePool.Remove(m_BanRangePool.First());
+		RemoveBan(m_BanRangePool.First());
 	}
 }
 
@@ -366,7 +677,7 @@ int CNetBan::UnbanByIndex(int Index)
 	if(pBan)
 	{
 		NetToString(&pBan->m_Data, aBuf, sizeof(aBuf));
-		Result = m_BanAddrPool.Remove(pBan);
+		Result = RemoveBan(pBan);
 	}
 	else
 	{
@@ -374,7 +685,7 @@ int CNetBan::UnbanByIndex(int Index)
 		if(pBan)
 		{
 			NetToString(&pBan->m_Data, aBuf, sizeof(aBuf));
-			Result = m_BanRangePool.Remove(pBan);
+			Result = RemoveBan(pBan);
 		}
 		else
 		{
@@ -391,31 +702,23 @@ int CNetBan::UnbanByIndex(int Index)
 
 bool CNetBan::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) const
 {
-	CNetHash aHash[17];
-	int Length = CNetHash::MakeHashArray(pAddr, aHash);
-
-	// check ban adresses
-	CBanAddr *pBan = m_BanAddrPool.Find(pAddr, &aHash[Length]);
-	if(pBan)
-	{
-		MakeBanInfo(pBan, pBuf, BufferSize, MSGTYPE_PLAYER);
-		return true;
-	}
+	CBanAddr *pAddrBan;
+	CBanRange *pRangeBan;
+	if(!m_BanTrie.Find(pAddr, &pAddrBan, &pRangeBan))
+		return false;
 
-	// check ban ranges
-	for(int i = Length - 1; i >= 0; --i)
-	{
-		for(CBanRange *pBan = m_BanRangePool.First(&aHash[i]); pBan; pBan = pBan->m_pHashNext)
-		{
-			if(NetMatch(&pBan->m_Data, pAddr, i, Length))
-			{
-				MakeBanInfo(pBan, pBuf, BufferSize, MSGTYPE_PLAYER);
-				return true;
-			}
-		}
-	}
+	if(pAddrBan)
+		MakeBanInfo(pAddrBan, pBuf, BufferSize, MSGTYPE_PLAYER);
+	else
+		MakeBanInfo(pRangeBan, pBuf, BufferSize, MSGTYPE_PLAYER);
+	return true;
+}
 
-	return false;
+bool CNetBan::IsFlooding(const NETADDR *pAddr)
+{
+	if(!g_Config.m_SvConnlessRate)
+		return false;
+	return !m_FloodSketch.Take(pAddr, time_get(), g_Config.m_SvConnlessRate, max(g_Config.m_SvConnlessBurst, 1));
 }
 
 void CNetBan::ConBan(IConsole::IResult *pResult, void *pUser)
@@ -1,6 +1,8 @@
 #ifndef ENGINE_SHARED_NETBAN_H
 #define ENGINE_SHARED_NETBAN_H
 
+#include <vector>
+
 #include <base/system.h>
 
 inline int NetComp(const NETADDR *pAddr1, const NETADDR *pAddr2)
@@ -83,8 +85,6 @@ protected:
 		CNetHash() {}
 		CNetHash(const NETADDR *pAddr);
 		CNetHash(const CNetRange *pRange);
-
-		static int MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17]);
 	};
 
 	struct CBanInfo
@@ -168,6 +168,89 @@ protected:
 	typedef CBan<NETADDR> CBanAddr;
 	typedef CBan<CNetRange> CBanRange;
 
+	/*
+		Path compressed binary trie over the banned prefixes, one per
+		address family. Address bans are prefixes of the full length and
+		ranges are split into the prefixes covering them, so a lookup
+		walks at most one node per bit and finds the longest banned
+		prefix of the address.
+	*/
+	class CBanTrie
+	{
+		struct CRef
+		{
+			CBanAddr *m_pAddrBan;
+			CBanRange *m_pRangeBan;
+			int m_Next;
+		};
+
+		struct CNode
+		{
+			unsigned char m_aPrefix[16]; // bits after the prefix length are zero
+			int m_Bits;
+			int m_aChildren[2];
+			int m_FirstRef; // -1 if no ban ends here
+		};
+
+		std::vector<CNode> m_aNodes;
+		std::vector<CRef> m_aRefs;
+		int m_FirstFreeNode;
+		int m_FirstFreeRef;
+		int m_aRoots[2]; // ipv4, ipv6
+
+		int NewNode(const unsigned char *pIp, int Bits);
+		void FreeNode(int Node);
+		int *Link(int Parent, int Side) { return Parent < 0 ? &m_aRoots[-Parent-1] : &m_aNodes[Parent].m_aChildren[Side]; }
+
+		void Add(const NETADDR *pAddr, int Bits, CBanAddr *pAddrBan, CBanRange *pRangeBan);
+		void Remove(const NETADDR *pAddr, int Bits, const void *pBan);
+
+	public:
+		CBanTrie();
+		void Reset();
+
+		void Add(CBanAddr *pBan);
+		void Add(CBanRange *pBan);
+		void Remove(CBanAddr *pBan);
+		void Remove(CBanRange *pBan);
+
+		// the ban of the longest banned prefix of the address
+		bool Find(const NETADDR *pAddr, CBanAddr **ppAddrBan, CBanRange **ppRangeBan) const;
+
+		// calls the callback with every prefix of the range
+		static void SplitRange(const CNetRange *pRange, void (*pfnCallback)(const NETADDR *pPrefix, int Bits, void *pUser), void *pUser);
+	};
+
+	/*
+		Leaky buckets per source address in fixed memory. Addresses are
+		hashed into a cell per row like a count-min sketch and the fullest
+		cell after a conservative update is the level of the source, so
+		collisions can only make a source look busier than it is.
+	*/
+	class CFloodSketch
+	{
+		enum
+		{
+			NUM_ROWS=4,
+			NUM_CELLS=1024,
+		};
+
+		struct CCell
+		{
+			int64 m_Time;
+			float m_Level;
+		};
+
+		CCell m_aaCells[NUM_ROWS][NUM_CELLS];
+
+		static unsigned Hash(const NETADDR *pAddr, int Row);
+
+	public:
+		void Reset();
+		// returns false if the source went over the burst, dropped packets don't count
+		bool Take(const NETADDR *pAddr, int64 Now, int Rate, int Burst);
+	};
+
 	template<class T>
 	void MakeBanInfo(const CBan<T> *pBan, char *pBuf, unsigned BuffSize,
 		int Type) const
@@ -231,8 +314,13 @@ protected:
 	class IStorage *m_pStorage;
 	CBanAddrPool m_BanAddrPool;
 	CBanRangePool m_BanRangePool;
+	CBanTrie m_BanTrie;
+	CFloodSketch m_FloodSketch;
 	NETADDR m_LocalhostIPV4, m_LocalhostIPV6;
 
+	int RemoveBan(CBanAddr *pBan) { m_BanTrie.Remove(pBan); return m_BanAddrPool.Remove(pBan); }
+	int RemoveBan(CBanRange *pBan) { m_BanTrie.Remove(pBan); return m_BanRangePool.Remove(pBan); }
+
 public:
 	enum
 	{
@@ -265,8 +353,11 @@ public:
 	{
 		m_BanAddrPool.Reset();
 		m_BanRangePool.Reset();
+		m_BanTrie.Reset();
 	}
 	bool IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) const;
+	// connless and connect packets of an address over sv_connless_rate
+	bool IsFlooding(const NETADDR *pAddr);
 
 	static void ConBan(class IConsole::IResult *pResult, void *pUser);
 	static void ConBanRange(class IConsole::IResult *pResult, void *pUser);
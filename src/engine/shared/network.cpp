@@ -120,16 +120,26 @@ void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct
 		io_flush(ms_DataLogSent);
 	}
 
+	// compress straight from the construct. the output is limited to the uncompressed size,
+	// so data that doesn't compress is given up on early
+	int ChunkSize = pPacket->m_DataSize;
+	int TotalSize = ChunkSize;
+	if (SecurityToken != NET_SECURITY_TOKEN_UNSUPPORTED)
+		TotalSize += sizeof(SecurityToken);
+	CHuffman::CEncoder Encoder;
+	Encoder.Init(&ms_Huffman, &aBuffer[3], min(TotalSize, NET_MAX_PACKETSIZE-4));
+	Encoder.Write(pPacket->m_aChunkData, ChunkSize);
+
 	if (SecurityToken != NET_SECURITY_TOKEN_UNSUPPORTED)
 	{
 		// append security token
 		// if SecurityToken is NET_SECURITY_TOKEN_UNKNOWN we will still append it hoping to negotiate it
+		Encoder.Write(&SecurityToken, sizeof(SecurityToken));
 		mem_copy(&pPacket->m_aChunkData[pPacket->m_DataSize], &SecurityToken, sizeof(SecurityToken));
 		pPacket->m_DataSize += sizeof(SecurityToken);
 	}
 
-	// compress
-	CompressedSize = ms_Huffman.Compress(pPacket->m_aChunkData, pPacket->m_DataSize, &aBuffer[3], NET_MAX_PACKETSIZE-4);
+	CompressedSize = Encoder.Finish();
 
 	// check if the compression was enabled, successful and good enough
 	if(CompressedSize > 0 && CompressedSize < pPacket->m_DataSize)
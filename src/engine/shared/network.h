@@ -339,6 +339,9 @@ public:
 	int Recv(CNetChunk *pChunk);
 	int Send(CNetChunk *pChunk);
 	int Update();
+	// sends everything queued on the connections, returns the number of packets
+	int Flush();
+	int Flush(int ClientID);
 
 	//
 	int Drop(int ClientID, const char *pReason, bool ForceDisconnect = true);
@@ -142,6 +142,26 @@ int CNetServer::Update()
 	return 0;
 }
 
+int CNetServer::Flush()
+{
+	int NumPackets = 0;
+	for(int i = 0; i < MaxClients(); i++)
+	{
+		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
+			continue;
+		if(m_aSlots[i].m_Connection.Flush())
+			NumPackets++;
+	}
+	return NumPackets;
+}
+
+int CNetServer::Flush(int ClientID)
+{
+	if(m_aSlots[ClientID].m_Connection.State() == NET_CONNSTATE_OFFLINE)
+		return 0;
+	return m_aSlots[ClientID].m_Connection.Flush() ? 1 : 0;
+}
+
 SECURITY_TOKEN CNetServer::GetToken(const NETADDR &Addr)
 {
 	md5_state_t md5;
@@ -551,6 +571,16 @@ int CNetServer::Recv(CNetChunk *pChunk)
 		if(Bytes <= 0)
 			break;
 
+		// floods of connless packets and of control packets without a connection (connect)
+		// are dropped before anything else looks at them. connected peers keep their keepalives
+		if(NetBan())
+		{
+			int Flags = m_RecvUnpacker.m_aBuffer[0]>>4;
+			bool Connless = Flags&NET_PACKETFLAG_CONNLESS;
+			if((Connless || ((Flags&NET_PACKETFLAG_CONTROL) && GetClientSlot(Addr) == -1)) && NetBan()->IsFlooding(&Addr))
+				continue;
+		}
+
 		// check if we just should drop the packet
 		char aBuf[128];
 		if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
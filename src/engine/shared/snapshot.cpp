@@ -1,5 +1,8 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <algorithm>
+#include <utility>
+
 #include "snapshot.h"
 #include "compression.h"
 
@@ -493,6 +496,8 @@ void CSnapshotBuilder::Init()
 {
 	m_DataSize = 0;
 	m_NumItems = 0;
+	m_EssentialSize = 0;
+	m_NumEssential = 0;
 }
 
 CSnapshotItem *CSnapshotBuilder::GetItem(int Index)
@@ -511,8 +516,63 @@ int *CSnapshotBuilder::GetItemData(int Key)
 	return 0;
 }
 
+int CSnapshotBuilder::Limit(int MaxSize, int *pDroppedKeys, int MaxDropped)
+{
+	// receivers take at most MAX_ITEMS-1 items
+	if(Size() <= MaxSize && m_NumItems < MAX_ITEMS)
+		return 0;
+
+	// cheapest first, ties in the order the items were added
+	std::pair<int, int> aOrder[MAX_CANDIDATES];
+	for(int i = 0; i < m_NumItems; i++)
+		aOrder[i] = std::make_pair(m_aCosts[i], i);
+	std::sort(aOrder, aOrder+m_NumItems);
+
+	bool aKeep[MAX_CANDIDATES] = {false};
+	int Left = MaxSize-(int)sizeof(CSnapshot);
+	int NumKept = 0;
+	int NumDropped = 0;
+	for(int o = 0; o < m_NumItems; o++)
+	{
+		int i = aOrder[o].second;
+		int ItemSize = (i+1 < m_NumItems ? m_aOffsets[i+1] : m_DataSize)-m_aOffsets[i];
+		if(m_aCosts[i] == COST_ESSENTIAL || (NumKept+1 < MAX_ITEMS && (int)sizeof(int)+ItemSize <= Left))
+		{
+			aKeep[i] = true;
+			Left -= sizeof(int)+ItemSize;
+			NumKept++;
+		}
+		else
+		{
+			if(NumDropped < MaxDropped)
+				pDroppedKeys[NumDropped] = GetItem(i)->Key();
+			NumDropped++;
+		}
+	}
+
+	// close the gaps, the kept items stay in their order
+	int DataSize = 0;
+	int NumItems = 0;
+	for(int i = 0; i < m_NumItems; i++)
+	{
+		if(!aKeep[i])
+			continue;
+		int ItemSize = (i+1 < m_NumItems ? m_aOffsets[i+1] : m_DataSize)-m_aOffsets[i];
+		mem_move(&m_aData[DataSize], &m_aData[m_aOffsets[i]], ItemSize);
+		m_aOffsets[NumItems] = DataSize;
+		m_aCosts[NumItems] = m_aCosts[i];
+		DataSize += ItemSize;
+		NumItems++;
+	}
+	m_DataSize = DataSize;
+	m_NumItems = NumItems;
+	return NumDropped;
+}
+
 int CSnapshotBuilder::Finish(void *pSpnapData)
 {
+	Limit(CSnapshot::MAX_SIZE, 0, 0);
+
 	// flattern and make the snapshot
 	CSnapshot *pSnap = (CSnapshot *)pSpnapData;
 	int OffsetSize = sizeof(int)*m_NumItems;
@@ -523,22 +583,33 @@ int CSnapshotBuilder::Finish(void *pSpnapData)
 	return sizeof(CSnapshot) + OffsetSize + m_DataSize;
 }
 
-void *CSnapshotBuilder::NewItem(int Type, int ID, int Size)
+void *CSnapshotBuilder::NewItem(int Type, int ID, int Size, int Cost)
 {
-	if(m_DataSize + sizeof(CSnapshotItem) + Size >= CSnapshot::MAX_SIZE ||
-		m_NumItems+1 >= MAX_ITEMS)
-	{
-		dbg_assert(m_DataSize < CSnapshot::MAX_SIZE, "too much data");
-		dbg_assert(m_NumItems < MAX_ITEMS, "too many items");
+	int ItemSize = sizeof(CSnapshotItem) + Size;
+	if(m_DataSize + ItemSize > (int)sizeof(m_aData) || m_NumItems+1 >= MAX_CANDIDATES)
 		return 0;
+
+	// the items without a cost have to fit on their own
+	if(Cost == COST_ESSENTIAL)
+	{
+		if(sizeof(CSnapshot) + m_EssentialSize + sizeof(int) + ItemSize > CSnapshot::MAX_SIZE ||
+			m_NumEssential+1 >= MAX_ITEMS)
+		{
+			dbg_assert(m_EssentialSize < CSnapshot::MAX_SIZE, "too much data");
+			dbg_assert(m_NumEssential < MAX_ITEMS, "too many items");
+			return 0;
+		}
+		m_EssentialSize += sizeof(int) + ItemSize;
+		m_NumEssential++;
 	}
 
 	CSnapshotItem *pObj = (CSnapshotItem *)(m_aData + m_DataSize);
 
-	mem_zero(pObj, sizeof(CSnapshotItem) + Size);
+	mem_zero(pObj, ItemSize);
 	pObj->m_TypeAndID = (Type<<16)|ID;
 	m_aOffsets[m_NumItems] = m_DataSize;
-	m_DataSize += sizeof(CSnapshotItem) + Size;
+	m_aCosts[m_NumItems] = Cost;
+	m_DataSize += ItemSize;
 	m_NumItems++;
 
 	return pObj->Data();
@@ -110,26 +110,51 @@ public:
 	int Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData);
 };
 
+/*
+	Items can be added with a cost. They are candidates: if everything
+	doesn't fit into the snapshot, Limit() keeps the cheapest ones and
+	reports the others. Items without a cost are always kept.
+*/
 class CSnapshotBuilder
 {
+public:
 	enum
 	{
-		MAX_ITEMS = 1024
+		MAX_ITEMS = 1024,
+		MAX_CANDIDATES = 2048,
+
+		COST_ESSENTIAL = -0x7fffffff,
 	};
 
-	char m_aData[CSnapshot::MAX_SIZE];
+private:
+	char m_aData[CSnapshot::MAX_SIZE*2];
 	int m_DataSize;
 
-	int m_aOffsets[MAX_ITEMS];
+	int m_aOffsets[MAX_CANDIDATES];
+	int m_aCosts[MAX_CANDIDATES];
 	int m_NumItems;
 
+	// what the items without a cost take in the snapshot
+	int m_EssentialSize;
+	int m_NumEssential;
+
 public:
 	void Init();
 
-	void *NewItem(int Type, int ID, int Size);
+	void *NewItem(int Type, int ID, int Size, int Cost = COST_ESSENTIAL);
 
+	int NumItems() const { return m_NumItems; }
 	CSnapshotItem *GetItem(int Index);
 	int *GetItemData(int Key);
+	int GetItemCost(int Index) const { return m_aCosts[Index]; }
+	void SetItemCost(int Index, int Cost) { m_aCosts[Index] = Cost; }
+
+	// size of the finished snapshot
+	int Size() const { return sizeof(CSnapshot) + sizeof(int)*m_NumItems + m_DataSize; }
+
+	// drops the most expensive items until the snapshot fits, returns the number
+	// of dropped items and stores up to MaxDropped of their keys
+	int Limit(int MaxSize, int *pDroppedKeys, int MaxDropped);
 
 	int Finish(void *pSnapdata);
 };
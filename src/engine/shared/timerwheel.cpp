@@ -0,0 +1,193 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include "timerwheel.h"
+
+CTimerWheel::CTimerWheel()
+{
+	m_pTimers = 0;
+	m_NumAllocated = 0;
+	Reset(0);
+}
+
+CTimerWheel::~CTimerWheel()
+{
+	if(m_pTimers)
+		mem_free(m_pTimers);
+}
+
+void CTimerWheel::Reset(int CurrentTick)
+{
+	for(int i = 0; i < NUM_SLOTS; i++)
+	{
+		m_aSlots[i].m_First = -1;
+		m_aSlots[i].m_Last = -1;
+	}
+
+	// chain all timers into the free list
+	m_FirstFree = -1;
+	for(int i = m_NumAllocated-1; i >= 0; i--)
+	{
+		m_pTimers[i].m_Slot = -1;
+		m_pTimers[i].m_Next = m_FirstFree;
+		m_FirstFree = i;
+	}
+
+	m_NumTimers = 0;
+	m_CurrentTick = CurrentTick;
+}
+
+int CTimerWheel::Alloc()
+{
+	if(m_FirstFree == -1)
+	{
+		int NewSize = m_NumAllocated ? m_NumAllocated*2 : 64;
+		if(NewSize > INDEX_MASK+1)
+			return -1;
+
+		CTimer *pTimers = (CTimer *)mem_alloc(NewSize*sizeof(CTimer), 1);
+		if(m_pTimers)
+		{
+			mem_copy(pTimers, m_pTimers, m_NumAllocated*sizeof(CTimer));
+			mem_free(m_pTimers);
+		}
+		m_pTimers = pTimers;
+
+		for(int i = NewSize-1; i >= m_NumAllocated; i--)
+		{
+			m_pTimers[i].m_Generation = 0;
+			m_pTimers[i].m_Slot = -1;
+			m_pTimers[i].m_Next = m_FirstFree;
+			m_FirstFree = i;
+		}
+		m_NumAllocated = NewSize;
+	}
+
+	int Index = m_FirstFree;
+	m_FirstFree = m_pTimers[Index].m_Next;
+	return Index;
+}
+
+void CTimerWheel::Link(int Index)
+{
+	CTimer *pTimer = &m_pTimers[Index];
+	unsigned Delta = (unsigned)(pTimer->m_Tick - m_CurrentTick);
+	unsigned Tick = (unsigned)pTimer->m_Tick;
+
+	// the level is picked by how far away the tick is, the slot by its bits on that level
+	int Level = 0;
+	while(Level < NUM_LEVELS-1 && Delta >= (1u<<(LEVEL_BITS*(Level+1))))
+		Level++;
+	int Slot = Level*LEVEL_SIZE + ((Tick>>(LEVEL_BITS*Level))&LEVEL_MASK);
+
+	CSlot *pSlot = &m_aSlots[Slot];
+	pTimer->m_Slot = Slot;
+	pTimer->m_Prev = pSlot->m_Last;
+	pTimer->m_Next = -1;
+	if(pSlot->m_Last != -1)
+		m_pTimers[pSlot->m_Last].m_Next = Index;
+	else
+		pSlot->m_First = Index;
+	pSlot->m_Last = Index;
+}
+
+void CTimerWheel::Unlink(int Index)
+{
+	CTimer *pTimer = &m_pTimers[Index];
+	CSlot *pSlot = &m_aSlots[pTimer->m_Slot];
+
+	if(pTimer->m_Prev != -1)
+		m_pTimers[pTimer->m_Prev].m_Next = pTimer->m_Next;
+	else
+		pSlot->m_First = pTimer->m_Next;
+	if(pTimer->m_Next != -1)
+		m_pTimers[pTimer->m_Next].m_Prev = pTimer->m_Prev;
+	else
+		pSlot->m_Last = pTimer->m_Prev;
+	pTimer->m_Slot = -1;
+}
+
+void CTimerWheel::Cascade(int Level)
+{
+	// move the timers of the slot that is now in reach one level down
+	CSlot *pSlot = &m_aSlots[Level*LEVEL_SIZE + (((unsigned)m_CurrentTick>>(LEVEL_BITS*Level))&LEVEL_MASK)];
+	int Index = pSlot->m_First;
+	pSlot->m_First = -1;
+	pSlot->m_Last = -1;
+	while(Index != -1)
+	{
+		int Next = m_pTimers[Index].m_Next;
+		Link(Index);
+		Index = Next;
+	}
+}
+
+int CTimerWheel::Schedule(int Tick, FCallback pfnCallback, void *pUser, int Data)
+{
+	int Index = Alloc();
+	if(Index == -1)
+		return INVALID_TIMER;
+
+	CTimer *pTimer = &m_pTimers[Index];
+	pTimer->m_Tick = Tick > m_CurrentTick ? Tick : m_CurrentTick+1;
+	pTimer->m_pfnCallback = pfnCallback;
+	pTimer->m_pUser = pUser;
+	pTimer->m_Data = Data;
+	pTimer->m_Generation = (pTimer->m_Generation+1)&GENERATION_MASK;
+	Link(Index);
+	m_NumTimers++;
+
+	return (pTimer->m_Generation<<INDEX_BITS)|Index;
+}
+
+bool CTimerWheel::IsPending(int TimerID) const
+{
+	if(TimerID < 0 || (TimerID&INDEX_MASK) >= m_NumAllocated)
+		return false;
+	const CTimer *pTimer = &m_pTimers[TimerID&INDEX_MASK];
+	return pTimer->m_Slot != -1 && pTimer->m_Generation == (TimerID>>INDEX_BITS);
+}
+
+bool CTimerWheel::Cancel(int TimerID)
+{
+	if(!IsPending(TimerID))
+		return false;
+
+	int Index = TimerID&INDEX_MASK;
+	Unlink(Index);
+	m_pTimers[Index].m_Next = m_FirstFree;
+	m_FirstFree = Index;
+	m_NumTimers--;
+	return true;
+}
+
+void CTimerWheel::Advance(int Tick)
+{
+	while(m_CurrentTick - Tick < 0)
+	{
+		if(!m_NumTimers)
+		{
+			m_CurrentTick = Tick;
+			return;
+		}
+
+		m_CurrentTick++;
+		for(int Level = 1; Level < NUM_LEVELS && ((unsigned)m_CurrentTick&((1u<<(LEVEL_BITS*Level))-1)) == 0; Level++)
+			Cascade(Level);
+
+		// fire one by one, callbacks may schedule or cancel other timers
+		CSlot *pSlot = &m_aSlots[m_CurrentTick&LEVEL_MASK];
+		while(pSlot->m_First != -1)
+		{
+			int Index = pSlot->m_First;
+			CTimer Timer = m_pTimers[Index];
+			Unlink(Index);
+			m_pTimers[Index].m_Next = m_FirstFree;
+			m_FirstFree = Index;
+			m_NumTimers--;
+
+			Timer.m_pfnCallback(Timer.m_pUser, Timer.m_Data);
+		}
+	}
+}
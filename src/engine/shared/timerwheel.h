@@ -0,0 +1,85 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_TIMERWHEEL_H
+#define ENGINE_SHARED_TIMERWHEEL_H
+
+/*
+	Hierarchical timer wheel over game ticks. Scheduling and cancelling are
+	O(1), Advance only touches the slots of the ticks that passed (plus a
+	cascade every 256 ticks), so pending timers cost nothing per tick.
+	Timers of the same tick fire in a deterministic order, but not
+	necessarily in the order they were scheduled.
+*/
+class CTimerWheel
+{
+public:
+	typedef void (*FCallback)(void *pUser, int Data);
+
+	enum
+	{
+		INVALID_TIMER=-1,
+	};
+
+private:
+	enum
+	{
+		LEVEL_BITS=8,
+		LEVEL_SIZE=1<<LEVEL_BITS,
+		LEVEL_MASK=LEVEL_SIZE-1,
+		NUM_LEVELS=4,
+		NUM_SLOTS=LEVEL_SIZE*NUM_LEVELS,
+
+		INDEX_BITS=20,
+		INDEX_MASK=(1<<INDEX_BITS)-1,
+		GENERATION_MASK=(1<<(31-INDEX_BITS))-1,
+	};
+
+	struct CTimer
+	{
+		int m_Tick;
+		FCallback m_pfnCallback;
+		void *m_pUser;
+		int m_Data;
+		int m_Generation;
+		int m_Slot; // -1 when the timer is free
+		int m_Prev;
+		int m_Next;
+	};
+
+	struct CSlot
+	{
+		int m_First;
+		int m_Last;
+	};
+
+	CTimer *m_pTimers;
+	int m_NumAllocated;
+	int m_FirstFree;
+	int m_NumTimers;
+	int m_CurrentTick;
+	CSlot m_aSlots[NUM_SLOTS];
+
+	int Alloc();
+	void Link(int Index);
+	void Unlink(int Index);
+	void Cascade(int Level);
+
+public:
+	CTimerWheel();
+	~CTimerWheel();
+
+	void Reset(int CurrentTick);
+
+	// timers for ticks that already passed fire on the next Advance
+	int Schedule(int Tick, FCallback pfnCallback, void *pUser, int Data);
+	bool Cancel(int TimerID);
+	bool IsPending(int TimerID) const;
+
+	// fires every timer up to and including Tick
+	void Advance(int Tick);
+
+	int CurrentTick() const { return m_CurrentTick; }
+	int NumTimers() const { return m_NumTimers; }
+};
+
+#endif
@@ -398,7 +398,12 @@ int CEditorMap::Save(class IStorage *pStorage, const char *pFileName)
 	mem_free(pPoints);
 
 	// finish the data file
-	df.Finish();
+	if(df.Finish() != 0)
+	{
+		str_format(aBuf, sizeof(aBuf), "failed to write file '%s'...", pFileName);
+		m_pEditor->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "editor", aBuf);
+		return 0;
+	}
 	m_pEditor->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "editor", "saving done");
 
 	// send rcon.. if we can
@@ -427,6 +432,7 @@ int CEditorMap::Load(class IStorage *pStorage, const char *pFileName, int Storag
 	//DATAFILE *df = datafile_load(filename);
 	if(!DataFile.Open(pStorage, pFileName, StorageType))
 		return 0;
+	DataFile.PrefetchData(0, DataFile.NumData());
 
 	Clean();
 
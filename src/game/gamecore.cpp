@@ -43,6 +43,11 @@ bool CTuningParams::Get(const char *pName, float *pValue)
 	return false;
 }
 
+static inline bool OutsideBox(vec2 Pos, vec2 Min, vec2 Max)
+{
+	return Pos.x < Min.x || Pos.x > Max.x || Pos.y < Min.y || Pos.y > Max.y;
+}
+
 float HermiteBasis1(float v)
 {
 	return 2*v*v*v - 3*v*v+1;
@@ -215,12 +220,19 @@ void CCharacterCore::Tick(bool UseInput)
 		if(m_pWorld && m_pWorld->m_Tuning.m_PlayerHooking)
 		{
 			float Distance = 0.0f;
+			float Range = PhysSize+2.0f+1.0f;
+			vec2 BoxMin = vec2(min(m_HookPos.x, NewPos.x)-Range, min(m_HookPos.y, NewPos.y)-Range);
+			vec2 BoxMax = vec2(max(m_HookPos.x, NewPos.x)+Range, max(m_HookPos.y, NewPos.y)+Range);
 			for(int i = 0; i < MAX_CLIENTS; i++)
 			{
 				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
 				if(!pCharCore || pCharCore == this)
 					continue;
 
+				// players outside the box around the hook's path can't be hit
+				if(OutsideBox(pCharCore->m_Pos, BoxMin, BoxMax))
+					continue;
+
 				vec2 ClosestPoint = closest_point_on_line(m_HookPos, NewPos, pCharCore->m_Pos);
 				if(distance(pCharCore->m_Pos, ClosestPoint) < PhysSize+2.0f)
 				{
@@ -324,6 +336,14 @@ void CCharacterCore::TickDeferred()
 			if(pCharCore == this) // || !(p->flags&FLAG_ALIVE)
 				continue; // make sure that we don't nudge our self
 
+			// skip the distance math for players too far away to collide
+			float Range = PhysSize*1.25f+1.0f;
+			if(m_HookedPlayer != i && OutsideBox(pCharCore->m_Pos, m_Pos-vec2(Range, Range), m_Pos+vec2(Range, Range)))
+			{
+				m_CoreStats.m_HadCollision[i] = 0;
+				continue;
+			}
+
 			// handle player <-> player collision
 			float Distance = distance(m_Pos, pCharCore->m_Pos);
 			vec2 Dir = normalize(m_Pos - pCharCore->m_Pos);
@@ -390,19 +410,30 @@ void CCharacterCore::Move()
 
 	if(m_pWorld && m_pWorld->m_Tuning.m_PlayerCollision)
 	{
+		// only players near the path can block it, collect them once
+		float Range = 28.0f+1.0f;
+		vec2 BoxMin = vec2(min(m_Pos.x, NewPos.x)-Range, min(m_Pos.y, NewPos.y)-Range);
+		vec2 BoxMax = vec2(max(m_Pos.x, NewPos.x)+Range, max(m_Pos.y, NewPos.y)+Range);
+		CCharacterCore *apNear[MAX_CLIENTS];
+		int NumNear = 0;
+		for(int p = 0; p < MAX_CLIENTS; p++)
+		{
+			CCharacterCore *pCharCore = m_pWorld->m_apCharacters[p];
+			if(pCharCore && pCharCore != this && !OutsideBox(pCharCore->m_Pos, BoxMin, BoxMax))
+				apNear[NumNear++] = pCharCore;
+		}
+
 		// check player collision
 		float Distance = distance(m_Pos, NewPos);
-		int End = Distance+1;
+		int End = NumNear ? Distance+1 : 0;
 		vec2 LastPos = m_Pos;
 		for(int i = 0; i < End; i++)
 		{
 			float a = i/Distance;
 			vec2 Pos = mix(m_Pos, NewPos, a);
-			for(int p = 0; p < MAX_CLIENTS; p++)
+			for(int p = 0; p < NumNear; p++)
 			{
-				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[p];
-				if(!pCharCore || pCharCore == this)
-					continue;
+				CCharacterCore *pCharCore = apNear[p];
 				float D = distance(Pos, pCharCore->m_Pos);
 				if(D < 28.0f && D > 0.0f)
 				{
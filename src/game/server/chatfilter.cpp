@@ -0,0 +1,223 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <algorithm>
+#include <utility>
+
+#include <base/system.h>
+
+#include <engine/storage.h>
+#include <engine/shared/linereader.h>
+
+#include "chatfilter.h"
+
+// look-alikes of the latin letters, anything not listed here or in ascii is skipped
+static const struct
+{
+	const char *m_pFrom;
+	char m_To;
+} s_aConfusables[] = {
+	{ "ÁÀÂÃÄÅĀĂĄǍȦǠÆⱯ∀🅰ⒶⓐáàâãäåāăąǎȧǡæΑαАа", 'a' },
+	{ "ḂḄḆƁƀƂƃℬ🅱Ⓑⓑḃḅḇβвв", 'b' },
+	{ "ÇĆĈĊČƇƈȻȼℂ🅲ⒸⓒçćĉċčϲсС", 'c' },
+	{ "ĎĐḊḌḎḐḒƊƋ🅳Ⓓⓓďđḋḍḏḑḓԁ", 'd' },
+	{ "ÉÈÊËĒĔĖĘĚȨℰ🅴ⒺⓔéèêëēĕėęěȩΕεЕеЁё", 'e' },
+	{ "ƑƒḞℱ🅵Ⓕⓕḟ", 'f' },
+	{ "ĜĞĠĢƓɠℊ🅶Ⓖⓖĝğġģ", 'g' },
+	{ "ĤĦḢḤḦḨḪℋ🅷ⒽⓗĥħḣḥḧḩḫΗНһ", 'h' },
+	{ "ÍÌÎÏĨĪĬĮİǏƗℐ🅸ⒾⓘíìîïĩīĭįıǐΙιІіЇї", 'i' },
+	{ "Ĵ🅹ⒿⓙĵϳјЈ", 'j' },
+	{ "ĶƘḰḲḴ🅺ⓀⓚķƙḱḳḵΚκКк", 'k' },
+	{ "ĹĻĽĿŁ🅻Ⓛⓛĺļľŀł", 'l' },
+	{ "ḾṀṂℳ🅼ⓂⓜḿṁṃΜМм", 'm' },
+	{ "ŃŅŇƝṄṆṈṊℕ🅽ⓃⓝñńņňṅṇṉṋÑΝη", 'n' },
+	{ "ÓÒÔÕÖŌŎŐǑƠØȮȰŒ🅾ⓄⓞóòôõöōŏőǒơøȯȱœΟοОо", 'o' },
+	{ "ƤṔṖ🅿ⓅⓟṕṗΡρРр", 'p' },
+	{ "ℚ🆀Ⓠⓠԛ", 'q' },
+	{ "ŔŖŘṘṚṜṞℝ🆁Ⓡⓡŕŗřṙṛṝṟг", 'r' },
+	{ "ŚŜŞŠṠṢṤṦṨ🆂ⓈⓢśŝşšṡṣṥṧṩЅѕ", 's' },
+	{ "ŢŤṪṬṮṰ🆃ⓉⓣţťṫṭṯṱΤτТт", 't' },
+	{ "ÚÙÛÜŨŪŬŮŰŲǓƯ🆄Ⓤⓤúùûüũūŭůűųǔưυ", 'u' },
+	{ "ṼṾ🆅Ⓥⓥṽṿνѵ", 'v' },
+	{ "ẀẂẄŴ🆆Ⓦⓦẁẃẅŵѡ", 'w' },
+	{ "ẊẌ🆇ⓍⓧẋẍΧχХх", 'x' },
+	{ "ÝŶŸȲɎ🆈Ⓨⓨ¥ýÿŷȳɏΥУуҮү", 'y' },
+	{ "ŹŻŽƵẐẒẔ🆉ⓏⓩźżžƶẑẓẕΖ", 'z' },
+};
+
+static std::vector<std::pair<int, int> > s_aConfusableMap;
+
+CChatFilter::CChatFilter()
+{
+	Clear();
+}
+
+void CChatFilter::Clear()
+{
+	m_aNext.clear();
+	m_aMatch.clear();
+	m_NumWords = 0;
+	AddState();
+}
+
+int CChatFilter::Symbol(int Code)
+{
+	// fullwidth forms
+	if(Code >= 0xFF01 && Code <= 0xFF5E)
+		Code -= 0xFF01-'!';
+
+	if(Code < 128)
+	{
+		if(Code >= 'A' && Code <= 'Z')
+			return Code-'A';
+		if(Code >= 'a' && Code <= 'z')
+			return Code-'a';
+		switch(Code)
+		{
+		case '0': return 'o'-'a';
+		case '1': return 'i'-'a';
+		case '3': return 'e'-'a';
+		case '4': case '@': return 'a'-'a';
+		case '5': case '$': return 's'-'a';
+		case '7': return 't'-'a';
+		case '9': return 'g'-'a';
+		}
+		if(Code >= '0' && Code <= '9')
+			return 26+Code-'0';
+		return -1;
+	}
+
+	if(s_aConfusableMap.empty())
+	{
+		for(unsigned i = 0; i < sizeof(s_aConfusables)/sizeof(s_aConfusables[0]); i++)
+		{
+			const char *pStr = s_aConfusables[i].m_pFrom;
+			while(int c = str_utf8_decode(&pStr))
+				if(c > 0)
+					s_aConfusableMap.push_back(std::make_pair(c, s_aConfusables[i].m_To-'a'));
+		}
+		std::sort(s_aConfusableMap.begin(), s_aConfusableMap.end());
+	}
+
+	std::vector<std::pair<int, int> >::const_iterator It = std::lower_bound(s_aConfusableMap.begin(), s_aConfusableMap.end(), std::make_pair(Code, 0));
+	if(It != s_aConfusableMap.end() && It->first == Code)
+		return It->second;
+	return -1;
+}
+
+void CChatFilter::Normalize(const char *pStr, std::vector<int> *pOut)
+{
+	pOut->clear();
+	while(int Code = str_utf8_decode(&pStr))
+	{
+		int Sym = Code > 0 ? Symbol(Code) : -1;
+		if(Sym >= 0)
+			pOut->push_back(Sym);
+	}
+}
+
+int CChatFilter::AddState()
+{
+	m_aNext.resize(m_aNext.size()+NUM_SYMBOLS, -1);
+	m_aMatch.push_back(false);
+	return (int)m_aMatch.size()-1;
+}
+
+void CChatFilter::AddWord(const std::vector<int> &Word)
+{
+	int State = 0;
+	for(unsigned i = 0; i < Word.size(); i++)
+	{
+		int Next = m_aNext[State*NUM_SYMBOLS+Word[i]];
+		if(Next == -1)
+		{
+			Next = AddState();
+			m_aNext[State*NUM_SYMBOLS+Word[i]] = Next;
+		}
+		State = Next;
+	}
+	m_aMatch[State] = true;
+	m_NumWords++;
+}
+
+void CChatFilter::Build()
+{
+	// breadth first over the trie, missing transitions are taken from the
+	// failure state so matching never has to walk failure links
+	std::vector<int> aFail(m_aMatch.size(), 0);
+	std::vector<int> aQueue;
+	aQueue.reserve(m_aMatch.size());
+
+	for(int s = 0; s < NUM_SYMBOLS; s++)
+	{
+		int Next = m_aNext[s];
+		if(Next == -1)
+			m_aNext[s] = 0;
+		else
+			aQueue.push_back(Next);
+	}
+
+	for(unsigned i = 0; i < aQueue.size(); i++)
+	{
+		int State = aQueue[i];
+		if(m_aMatch[aFail[State]])
+			m_aMatch[State] = true;
+
+		for(int s = 0; s < NUM_SYMBOLS; s++)
+		{
+			int &Next = m_aNext[State*NUM_SYMBOLS+s];
+			int FailNext = m_aNext[aFail[State]*NUM_SYMBOLS+s];
+			if(Next == -1)
+				Next = FailNext;
+			else
+			{
+				aFail[Next] = FailNext;
+				aQueue.push_back(Next);
+			}
+		}
+	}
+}
+
+int CChatFilter::Load(IStorage *pStorage, const char *pFilename)
+{
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
+		return -1;
+
+	CChatFilter Filter;
+	std::vector<int> Word;
+	CLineReader LineReader;
+	LineReader.Init(File);
+	while(char *pLine = LineReader.Get())
+	{
+		if(pLine[0] == '#')
+			continue;
+		Normalize(pLine, &Word);
+		if(!Word.empty())
+			Filter.AddWord(Word);
+	}
+	io_close(File);
+
+	Filter.Build();
+	std::swap(m_aNext, Filter.m_aNext);
+	std::swap(m_aMatch, Filter.m_aMatch);
+	m_NumWords = Filter.m_NumWords;
+	return 0;
+}
+
+bool CChatFilter::Match(const char *pMessage) const
+{
+	if(!m_NumWords)
+		return false;
+
+	int State = 0;
+	while(int Code = str_utf8_decode(&pMessage))
+	{
+		int Sym = Code > 0 ? Symbol(Code) : -1;
+		if(Sym < 0)
+			continue;
+		State = m_aNext[State*NUM_SYMBOLS+Sym];
+		if(m_aMatch[State])
+			return true;
+	}
+	return false;
+}
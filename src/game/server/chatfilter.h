@@ -0,0 +1,46 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef GAME_SERVER_CHATFILTER_H
+#define GAME_SERVER_CHATFILTER_H
+
+#include <vector>
+
+/*
+	Word filter for chat. The word list is compiled into an Aho-Corasick
+	automaton with all transitions resolved, so a message is checked in a
+	single pass no matter how many words are listed. Words and messages
+	are normalized the same way: case, accents, look-alike letters and
+	leetspeak digits are folded, everything else is skipped.
+*/
+class CChatFilter
+{
+	enum
+	{
+		NUM_SYMBOLS=36, // a-z, 0-9
+	};
+
+	std::vector<int> m_aNext; // NUM_SYMBOLS transitions per state
+	std::vector<bool> m_aMatch;
+	int m_NumWords;
+
+	int AddState();
+	void AddWord(const std::vector<int> &Word);
+	void Build();
+
+	// returns the symbol of the code point or -1 if it is skipped
+	static int Symbol(int Code);
+	static void Normalize(const char *pStr, std::vector<int> *pOut);
+
+public:
+	CChatFilter();
+
+	// keeps the current words if the file can't be opened
+	int Load(class IStorage *pStorage, const char *pFilename);
+	void Clear();
+
+	bool Match(const char *pMessage) const;
+
+	int NumWords() const { return m_NumWords; }
+};
+
+#endif
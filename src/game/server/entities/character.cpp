@@ -63,6 +63,7 @@ CCharacter::CCharacter(CGameWorld *pWorld)
     m_AntiCheatChatDelay = Server()->TickSpeed() * 5;  // 5 seconds delay
     m_LastAntiCheatChatTick = 0;
     m_OwnerCID = m_pPlayer ? m_pPlayer->GetCID() : -1;
+    m_SnapSerial = -1;
 }
 
 void CCharacter::UnhookClient(int ClientID)
@@ -107,6 +108,7 @@ bool CCharacter::Spawn(CPlayer *pPlayer, vec2 Pos)
 	m_ReckoningTick = 0;
 	mem_zero(&m_SendCore, sizeof(m_SendCore));
 	mem_zero(&m_ReckoningCore, sizeof(m_ReckoningCore));
+	m_ReckoningAtRest = false;
 
 	GameServer()->m_World.InsertEntity(this);
 	m_Alive = true;
@@ -794,14 +796,19 @@ void CCharacter::Tick()
 
 void CCharacter::TickDefered()
 {
-	// advance the dummy
+	// advance the dummy. it runs alone in an empty world, so once a tick
+	// leaves it unchanged every following tick would too
+	if(!m_ReckoningAtRest)
 	{
 		CWorldCore TempWorld;
 		m_ReckoningCore.Init(&TempWorld, GameServer()->Collision());
+		CCharacterCore Before;
+		mem_copy(&Before, &m_ReckoningCore, sizeof(Before));
 		m_ReckoningCore.Tick(false);
 		m_ReckoningCore.TickDeferred();
 		m_ReckoningCore.Move();
 		m_ReckoningCore.Quantize();
+		m_ReckoningAtRest = mem_comp(&Before, &m_ReckoningCore, sizeof(Before)) == 0;
 	}
 
 	//lastsentcore
@@ -872,6 +879,7 @@ void CCharacter::TickDefered()
 			m_ReckoningTick = Server()->Tick();
 			m_SendCore = m_Core;
 			m_ReckoningCore = m_Core;
+			m_ReckoningAtRest = false;
 		}
 	}
 	
@@ -1113,6 +1121,7 @@ void CCharacter::DieSpikes(int pPlayerID, int spikes_flag) {
 
                 pKillerPlayer->m_LastKillTick = Now;
                 pKillerPlayer->m_MultiEndAnnounceTick = Now + Server()->TickSpeed() * 5; //5 second window
+                GameServer()->ScheduleMultiEnd(pPlayerID);
 
                 if(pKillerPlayer->m_MultiCount > pKillerPlayer->m_MaxMulti)
                     pKillerPlayer->m_MaxMulti = pKillerPlayer->m_MultiCount;
@@ -1452,7 +1461,13 @@ void CCharacter::Snap(int SnappingClient)
 	int ClientID = m_pPlayer->GetCID();
 	if(SnappingClient > -1 && GameServer()->m_apPlayers[SnappingClient] && !GameServer()->m_apPlayers[SnappingClient]->AddSnappingClient(m_pPlayer->GetCID(), Distance, GameServer()->m_apPlayers[SnappingClient]->m_ClientVersion, ClientID)) return;
 
-	CNetObj_Character *pCharacter = static_cast<CNetObj_Character *>(Server()->SnapNewItem(NETOBJTYPE_CHARACTER, ClientID, sizeof(CNetObj_Character)));
+	// the own character always goes in, the others by distance
+	CNetObj_Character *pCharacter;
+	if(SnappingClient == m_pPlayer->GetCID())
+		pCharacter = static_cast<CNetObj_Character *>(Server()->SnapNewItem(NETOBJTYPE_CHARACTER, ClientID, sizeof(CNetObj_Character)));
+	else
+		pCharacter = static_cast<CNetObj_Character *>(Server()->SnapNewItem(NETOBJTYPE_CHARACTER, ClientID, sizeof(CNetObj_Character),
+			GameServer()->SnapCost(SnappingClient, m_Pos, CGameContext::SNAPCOST_PLAYER)));
 	if(!pCharacter)
 		return;
     if (ClientID == -1)
@@ -1460,7 +1475,36 @@ void CCharacter::Snap(int SnappingClient)
         Unfreeze(-1);
         return;
     }
-    
+
+	if(m_SnapSerial != GameServer()->m_SnapSerial)
+		UpdateSnapItem();
+	mem_copy(pCharacter, &m_SnapCharacter, sizeof(CNetObj_Character));
+
+	int HookedID = pCharacter->m_HookedPlayer;
+	if (HookedID != -1 && SnappingClient > -1 && GameServer()->m_apPlayers[SnappingClient] && !GameServer()->m_apPlayers[SnappingClient]->IsSnappingClient(HookedID, GameServer()->m_apPlayers[SnappingClient]->m_ClientVersion, HookedID)) {
+		pCharacter->m_HookedPlayer = -1;
+	}
+	else if(IsAlive()) pCharacter->m_HookedPlayer = HookedID;
+	else pCharacter->m_HookedPlayer = -1;
+
+
+	if(m_pPlayer->GetCID() == SnappingClient || SnappingClient == -1 ||
+		(!g_Config.m_SvStrictSpectateMode && m_pPlayer->GetCID() == GameServer()->m_apPlayers[SnappingClient]->m_SpectatorID))
+	{
+		pCharacter->m_Health = 10;
+		pCharacter->m_Armor = m_Armor;
+		if(m_ActiveWeapon == WEAPON_GUN)
+            pCharacter->m_AmmoCount = -1; // hide pistol ammo
+        else if(m_aWeapons[m_ActiveWeapon].m_Ammo > 0)
+            pCharacter->m_AmmoCount = m_aWeapons[m_ActiveWeapon].m_Ammo;
+	}
+}
+
+void CCharacter::UpdateSnapItem()
+{
+	m_SnapSerial = GameServer()->m_SnapSerial;
+	CNetObj_Character *pCharacter = &m_SnapCharacter;
+
 	// write down the m_Core
 	if(!m_ReckoningTick || GameServer()->m_World.m_Paused)
 	{
@@ -1495,25 +1539,6 @@ void CCharacter::Snap(int SnappingClient)
 
 	pCharacter->m_Direction = m_Input.m_Direction;
 
-	int HookedID = pCharacter->m_HookedPlayer;
-	if (HookedID != -1 && SnappingClient > -1 && GameServer()->m_apPlayers[SnappingClient] && !GameServer()->m_apPlayers[SnappingClient]->IsSnappingClient(HookedID, GameServer()->m_apPlayers[SnappingClient]->m_ClientVersion, HookedID)) {
-		pCharacter->m_HookedPlayer = -1;
-	}
-	else if(IsAlive()) pCharacter->m_HookedPlayer = HookedID;
-	else pCharacter->m_HookedPlayer = -1;
-
-
-	if(m_pPlayer->GetCID() == SnappingClient || SnappingClient == -1 ||
-		(!g_Config.m_SvStrictSpectateMode && m_pPlayer->GetCID() == GameServer()->m_apPlayers[SnappingClient]->m_SpectatorID))
-	{
-		pCharacter->m_Health = 10;
-		pCharacter->m_Armor = m_Armor;
-		if(m_ActiveWeapon == WEAPON_GUN)
-            pCharacter->m_AmmoCount = -1; // hide pistol ammo
-        else if(m_aWeapons[m_ActiveWeapon].m_Ammo > 0)
-            pCharacter->m_AmmoCount = m_aWeapons[m_ActiveWeapon].m_Ammo;
-	}
-
 	if(pCharacter->m_Emote == EMOTE_NORMAL && (m_pPlayer->m_Emotion == EMOTE_NORMAL || m_pPlayer->m_EmotionDuration == 0))
 	{
 		if(250 - ((Server()->Tick() - m_LastAction)%(250)) < 5)
@@ -1523,7 +1548,6 @@ void CCharacter::Snap(int SnappingClient)
 	}
 
 	pCharacter->m_PlayerFlags = GetPlayer()->m_PlayerFlags;
-    //for disconnecting while frozen
 }
 
 
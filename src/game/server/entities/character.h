@@ -79,6 +79,7 @@ public:
 
 	bool IsAlive() const { return m_Alive; }
 	class CPlayer *GetPlayer() { return m_pPlayer; }
+	const CCharacterCore *Core() const { return &m_Core; }
 
 	bool IsFrozen();
 
@@ -116,6 +117,11 @@ public:
     
 private:
 	int NetworkClipped(int SnappingClient, float& Distance);
+
+	// the character item as every viewer but the owner and its spectators sees it
+	int m_SnapSerial;
+	CNetObj_Character m_SnapCharacter;
+	void UpdateSnapItem();
 	int NetworkClipped(int SnappingClient, float& Distance, vec2 CheckPos);
 
 	// player controlling this character
@@ -190,6 +196,7 @@ private:
 	int m_ReckoningTick; // tick that we are performing dead reckoning From
 	CCharacterCore m_SendCore; // core that we should send
 	CCharacterCore m_ReckoningCore; // the dead reckoning core
+	bool m_ReckoningAtRest; // the last reckoning tick left the core unchanged
 
 };
 
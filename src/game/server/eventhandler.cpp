@@ -9,6 +9,7 @@
 CEventHandler::CEventHandler()
 {
 	m_pGameServer = 0;
+	m_NextSeq = 0;
 	Clear();
 }
 
@@ -18,6 +19,11 @@ void CEventHandler::SetGameServer(CGameContext *pGameServer)
 }
 
 void *CEventHandler::Create(int Type, int Size, QuadroMask Mask)
+{
+	return Add(Type, Size, Mask, GameServer()->Server()->Tick());
+}
+
+void *CEventHandler::Add(int Type, int Size, QuadroMask Mask, int Tick)
 {
 	if(m_NumEvents == MAX_EVENTS)
 		return 0;
@@ -28,6 +34,8 @@ void *CEventHandler::Create(int Type, int Size, QuadroMask Mask)
 	m_aOffsets[m_NumEvents] = m_CurrentOffset;
 	m_aTypes[m_NumEvents] = Type;
 	m_aSizes[m_NumEvents] = Size;
+	m_aTicks[m_NumEvents] = Tick;
+	m_aSeqs[m_NumEvents] = m_NextSeq++;
 	m_aClientMasks[m_NumEvents] = Mask;
 	m_CurrentOffset += Size;
 	m_NumEvents++;
@@ -38,21 +46,66 @@ void CEventHandler::Clear()
 {
 	m_NumEvents = 0;
 	m_CurrentOffset = 0;
+	for(int i = 0; i < MAX_CLIENTS+1; i++)
+		m_aLastSnapSeq[i] = m_NextSeq-1;
 }
 
-void CEventHandler::Snap(int SnappingClient)
+void CEventHandler::Expire(int Tick)
 {
+	// events are created in tick order
+	int First = 0;
+	while(First < m_NumEvents && m_aTicks[First] < Tick)
+		First++;
+	if(First == 0)
+		return;
+
+	int Shift = First < m_NumEvents ? m_aOffsets[First] : m_CurrentOffset;
+	mem_move(m_aData, &m_aData[Shift], m_CurrentOffset-Shift);
+	for(int i = First; i < m_NumEvents; i++)
+	{
+		m_aTypes[i-First] = m_aTypes[i];
+		m_aOffsets[i-First] = m_aOffsets[i]-Shift;
+		m_aSizes[i-First] = m_aSizes[i];
+		m_aTicks[i-First] = m_aTicks[i];
+		m_aSeqs[i-First] = m_aSeqs[i];
+		m_aClientMasks[i-First] = m_aClientMasks[i];
+	}
+	m_NumEvents -= First;
+	m_CurrentOffset -= Shift;
+}
+
+int CEventHandler::Pending(int SnappingClient, int Tick, int Window, int *pIndices)
+{
+	unsigned *pLastSnapSeq = &m_aLastSnapSeq[SnappingClient+1];
+	int Num = 0;
 	for(int i = 0; i < m_NumEvents; i++)
 	{
+		// the sequence wraps around
+		if((int)(m_aSeqs[i]-*pLastSnapSeq) <= 0 || m_aTicks[i] < Tick-Window)
+			continue;
 		if(SnappingClient == -1 || CmaskIsSet(m_aClientMasks[i], SnappingClient))
+			pIndices[Num++] = i;
+	}
+	*pLastSnapSeq = m_NextSeq-1;
+	return Num;
+}
+
+void CEventHandler::Snap(int SnappingClient)
+{
+	// only what happened since the last snapshot of this client
+	int aIndices[MAX_EVENTS];
+	int Num = Pending(SnappingClient, GameServer()->Server()->Tick(), GameServer()->Server()->MaxSnapInterval(), aIndices);
+
+	for(int n = 0; n < Num; n++)
+	{
+		int i = aIndices[n];
+		CNetEvent_Common *ev = (CNetEvent_Common *)&m_aData[m_aOffsets[i]];
+		if(SnappingClient == -1 || (GameServer()->m_apPlayers[SnappingClient] && distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, vec2(ev->m_X, ev->m_Y))) < 1500.0f)
 		{
-			CNetEvent_Common *ev = (CNetEvent_Common *)&m_aData[m_aOffsets[i]];
-			if(SnappingClient == -1 || (GameServer()->m_apPlayers[SnappingClient] && distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, vec2(ev->m_X, ev->m_Y))) < 1500.0f)
-			{
-				void *d = GameServer()->Server()->SnapNewItem(m_aTypes[i], i, m_aSizes[i]);
-				if(d)
-					mem_copy(d, &m_aData[m_aOffsets[i]], m_aSizes[i]);
-			}
+			int Cost = GameServer()->SnapCost(SnappingClient, vec2(ev->m_X, ev->m_Y), CGameContext::SNAPCOST_EVENT);
+			void *d = GameServer()->Server()->SnapNewItem(m_aTypes[i], i, m_aSizes[i], Cost);
+			if(d)
+				mem_copy(d, &m_aData[m_aOffsets[i]], m_aSizes[i]);
 		}
 	}
 }
@@ -5,6 +5,8 @@
 
 #include <cstring>
 
+#include <engine/shared/protocol.h>
+
 #ifndef QUADRO_MASK
 #define QUADRO_MASK
 struct QuadroMask {
@@ -83,14 +85,18 @@ struct QuadroMask {
 };
 #endif
 //
+// events are kept until every client got a snapshot after them,
+// each client gets an event in exactly one snapshot
 class CEventHandler
 {
-	static const int MAX_EVENTS = 128;
-	static const int MAX_DATASIZE = 128*64;
+	static const int MAX_EVENTS = 512;
+	static const int MAX_DATASIZE = MAX_EVENTS*64;
 
 	int m_aTypes[MAX_EVENTS]; // TODO: remove some of these arrays
 	int m_aOffsets[MAX_EVENTS];
 	int m_aSizes[MAX_EVENTS];
+	int m_aTicks[MAX_EVENTS];
+	unsigned m_aSeqs[MAX_EVENTS];
 	QuadroMask m_aClientMasks[MAX_EVENTS];
 	char m_aData[MAX_DATASIZE];
 
@@ -98,13 +104,25 @@ class CEventHandler
 
 	int m_CurrentOffset;
 	int m_NumEvents;
+	unsigned m_NextSeq;
+
+	// events can be created after a receiver got its snapshot of the tick,
+	// so what was sent is tracked by sequence instead of by tick
+	unsigned m_aLastSnapSeq[MAX_CLIENTS+1]; // the demo is at index 0
 public:
 	CGameContext *GameServer() const { return m_pGameServer; }
 	void SetGameServer(CGameContext *pGameServer);
 
 	CEventHandler();
 	void *Create(int Type, int Size, QuadroMask Mask = QuadroMask(-1ll));
+	void *Add(int Type, int Size, QuadroMask Mask, int Tick);
 	void Clear();
+	// drops the events older than the tick
+	void Expire(int Tick);
+	// collects the events the receiver did not get yet, at most Window ticks old
+	int Pending(int SnappingClient, int Tick, int Window, int *pIndices);
+	int Type(int Index) const { return m_aTypes[Index]; }
+	const void *Data(int Index) const { return &m_aData[m_aOffsets[Index]]; }
 	void Snap(int SnappingClient);
 };
 
@@ -35,7 +35,6 @@
 #include <engine/server.h>       // for IServer, NETADDR
 #include <engine/server/server.h> // for CServer, BanAddr
 #include <engine/shared/protocol.h> // for NETADDR
-#include "slurlist.h" //for toxic player mute
 #include <climits>
 #define STORAGE_IMPLEMENTATION
 extern IStorage *CreateStorage(int Type, int NumArgs, const char **ppArguments);
@@ -46,23 +45,14 @@ static const int DUMMY_CID = CPlayer::VANILLA_CLIENT_MAX_CLIENTS; // == 16 on va
 void FormatTime(int Seconds, char* pBuf, int BufSize);
 
 
-inline const char *str_chr(const char *pStr, char c)
-{
-	while(*pStr)
-	{
-		if(*pStr == c)
-			return pStr;
-		pStr++;
-	}
-	return 0;
-}
-
 enum
 {
 	RESET,
 	NO_RESET
 };
 
+CChatFilter CGameContext::ms_ChatFilter;
+
 void CGameContext::Construct(int Resetting)
 {
 	m_Resetting = 0;
@@ -78,6 +68,9 @@ void CGameContext::Construct(int Resetting)
 	m_NumVoteOptions = 0;
 	m_LockTeams = 0;
 	m_FirstServerCommand = 0;
+	m_SnapSerial = 0;
+	m_FrozenLeavers.SetPrefix(32, m_Config->m_SvPenaltyPrefixV6);
+	m_MutedAddrs.SetPrefix(32, m_Config->m_SvPenaltyPrefixV6);
 
 	if(Resetting==NO_RESET)
 		m_pVoteOptionHeap = new CHeap();
@@ -552,8 +545,6 @@ void CGameContext::SwapTeams()
 
 void CGameContext::OnTick()
 {
-	ExpireFrozenLeavers();
-
 	CheckPureTuning();
 
 	// copy tuning
@@ -571,19 +562,12 @@ void CGameContext::OnTick()
 		{
 			pPlayer->Tick();
 			pPlayer->PostTick();
-
-			// --- MULTI KILL EXPIRY CHECK ---
-			if(pPlayer->m_MultiCount > 1 && Server()->Tick() > pPlayer->m_MultiEndAnnounceTick)
-            {
-                SendChatTarget(i, "multi ended");
-
-                pPlayer->m_MultiCount = 0;
-                pPlayer->m_LastKillTick = -1;
-                pPlayer->m_MultiEndAnnounceTick = -1;
-            }
 		}
 	}
 
+	// multi kill ends, mute and frozen leaver expiry
+	m_Timers.Advance(Server()->Tick());
+
 	// voting system
 	if(m_VoteCloseTime)
 	{
@@ -599,38 +583,46 @@ void CGameContext::OnTick()
 
 			if(m_VoteUpdate)
 			{
-				// count votes
-				char aaBuf[MAX_CLIENTS][NETADDR_MAXSTRSIZE] = {{0}};
-				for(int i = 0; i < MAX_CLIENTS; i++)
-					if(m_apPlayers[i])
-						Server()->GetClientAddr(i, aaBuf[i], NETADDR_MAXSTRSIZE);
-
-				bool aVoteChecked[MAX_CLIENTS] = {0};
+				// count votes, one per address. the first active player of an
+				// address leads its group, players after it share the earliest vote
+				NETADDR aAddrs[MAX_CLIENTS];
+				int aActVote[MAX_CLIENTS] = {0};
+				int aActVotePos[MAX_CLIENTS] = {0};
+				m_VoteGroups.Clear();
 				for(int i = 0; i < MAX_CLIENTS; i++)
 				{
-					if(!m_apPlayers[i] || m_apPlayers[i]->GetTeam() == TEAM_SPECTATORS || aVoteChecked[i])
+					if(!m_apPlayers[i])
 						continue;
 
-					int ActVote = m_apPlayers[i]->m_Vote;
-					int ActVotePos = m_apPlayers[i]->m_VotePos;
+					Server()->GetNetAddr(&aAddrs[i], i);
+					if(m_apPlayers[i]->GetTeam() != TEAM_SPECTATORS && !m_VoteGroups.Find(&aAddrs[i], 0))
+					{
+						m_VoteGroups.Set(&aAddrs[i], CNetAddrTable::NO_EXPIRE, i);
+						aActVote[i] = m_apPlayers[i]->m_Vote;
+						aActVotePos[i] = m_apPlayers[i]->m_VotePos;
+						Total++;
+					}
+				}
 
-					for(int j = i+1; j < MAX_CLIENTS; ++j)
+				for(int j = 0; j < MAX_CLIENTS; j++)
+				{
+					CNetAddrTable::CEntry *pGroup = m_apPlayers[j] ? m_VoteGroups.Find(&aAddrs[j], 0) : 0;
+					if(!pGroup || pGroup->m_Data >= j)
+						continue;
+
+					int i = pGroup->m_Data;
+					if(m_apPlayers[j]->m_Vote && (!aActVote[i] || aActVotePos[i] > m_apPlayers[j]->m_VotePos))
 					{
-						if(!m_apPlayers[j] || aVoteChecked[j] || str_comp(aaBuf[j], aaBuf[i]))
-							continue;
-
-						aVoteChecked[j] = true;
-						if(m_apPlayers[j]->m_Vote && (!ActVote || ActVotePos > m_apPlayers[j]->m_VotePos))
-						{
-							ActVote = m_apPlayers[j]->m_Vote;
-							ActVotePos = m_apPlayers[j]->m_VotePos;
-						}
+						aActVote[i] = m_apPlayers[j]->m_Vote;
+						aActVotePos[i] = m_apPlayers[j]->m_VotePos;
 					}
+				}
 
-					Total++;
-					if(ActVote > 0)
+				for(int i = 0; i < MAX_CLIENTS; i++)
+				{
+					if(aActVote[i] > 0)
 						Yes++;
-					else if(ActVote < 0)
+					else if(aActVote[i] < 0)
 						No++;
 				}
 
@@ -729,21 +721,9 @@ void CGameContext::OnClientConnected(int ClientID, int PreferedTeam)
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "frozenban", aBuf);
 
 	// Check frozen leaver block
-	if(IsFrozenLeaverBlocked(Addr))
+	int RemainingTicks = FrozenLeaverTicksLeft(Addr);
+	if(RemainingTicks > 0)
     {
-        // Calculate remaining time
-        int RemainingTicks = 0;
-        for(int i = 0; i < m_FrozenLeaverCount; ++i)
-        {
-            NETADDR BanAddr = m_aFrozenLeavers[i].m_Addr;
-            BanAddr.port = 0;
-
-            if(net_addr_comp(&BanAddr, &Addr) == 0)
-            {
-                RemainingTicks = m_aFrozenLeavers[i].m_ExpireTick - Server()->Tick();
-                break;
-            }
-        }
         int RemainingSeconds = RemainingTicks / Server()->TickSpeed();
 
         // Build and print messages
@@ -825,12 +805,9 @@ bool CGameContext::OnClientDrop(int ClientID, const char *pReason, bool Force)
 			pPlayer->m_SentRagequitMessage = true;
 
 			// Add to frozen leaver ban list
-			char aAddrStr[NETADDR_MAXSTRSIZE];
-			Server()->GetClientAddr(ClientID, aAddrStr, sizeof(aAddrStr));
 			NETADDR Addr;
-			Addr.port = 0;
-			if(net_addr_from_str(&Addr, aAddrStr) == 0)
-				AddFrozenLeaver(Addr, 30); // block for 30 seconds
+			Server()->GetNetAddr(&Addr, ClientID);
+			AddFrozenLeaver(Addr, 30); // block for 30 seconds
 		}
 
 		if(pChar)
@@ -901,20 +878,12 @@ void CGameContext::OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID)
                 pPlayer->m_ResetStrikesAfterMute = false;
             }
 
-            for(auto it = m_MutedIPs.begin(); it != m_MutedIPs.end(); )
-            {
-                if(it->second <= Server()->Tick())
-                    it = m_MutedIPs.erase(it);
-                else
-                    ++it;
-            }
-
-            char aAddrStr[NETADDR_MAXSTRSIZE];
-            Server()->GetClientAddr(ClientID, aAddrStr, sizeof(aAddrStr));
-            auto It = m_MutedIPs.find(aAddrStr);
-            if(It != m_MutedIPs.end() && It->second > Server()->Tick())
+            NETADDR Addr;
+            Server()->GetNetAddr(&Addr, ClientID);
+            CNetAddrTable::CEntry *pMute = m_MutedAddrs.Find(&Addr, Server()->Tick());
+            if(pMute)
             {
-                int Remaining = (It->second - Server()->Tick()) / Server()->TickSpeed();
+                int Remaining = (pMute->m_ExpireTick - Server()->Tick()) / Server()->TickSpeed();
                 char aBuf[128];
                 str_format(aBuf, sizeof(aBuf), "You may not chat now, you are muted for %d more second(s)", Remaining);
                 SendChatTarget(ClientID, aBuf);
@@ -997,39 +966,27 @@ void CGameContext::OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID)
             // Send chat message first
             SendChat(ClientID, Team, pMsg->m_pMessage);
 
-            /* Run filter after chat is sent
-            char aMsgClean[256];
-            str_copy(aMsgClean, pMsg->m_pMessage, sizeof(aMsgClean));
-            NormalizeChat(aMsgClean, sizeof(aMsgClean));
-
-            for(int i = 0; i < g_NumSlurs; i++)
+            // Run filter after chat is sent
+            if(ms_ChatFilter.Match(pMsg->m_pMessage))
             {
-                if(str_find(aMsgClean, g_aSlurs[i]))
+                pPlayer->m_ToxicStrikes++;
+
+                if(pPlayer->m_ToxicStrikes >= 3)
                 {
-                    pPlayer->m_ToxicStrikes++;
-
-                    if(pPlayer->m_ToxicStrikes >= 3)
-                    {
-                        char aAddrStr[NETADDR_MAXSTRSIZE];
-                        Server()->GetClientAddr(ClientID, aAddrStr, sizeof(aAddrStr));
-                        m_MutedIPs[aAddrStr] = Server()->Tick() + 10 * 60 * Server()->TickSpeed(); // 10 min
-                        pPlayer->m_MuteTick = m_MutedIPs[aAddrStr];
-                        pPlayer->m_ResetStrikesAfterMute = true;
-
-                        char aMute[128];
-                        str_format(aMute, sizeof(aMute), "'%s' has been auto-muted for 10 minutes (toxicity)", Server()->ClientName(ClientID));
-                        SendChat(-1, CHAT_ALL, aMute);
-                    }
-                    else
-                    {
-                        char aWarn[128];
-                        str_format(aWarn, sizeof(aWarn), "⚠️ %s has been flagged for toxicity", Server()->ClientName(ClientID));
-                        SendChat(-1, CHAT_ALL, aWarn);
-                    }
+                    pPlayer->m_MuteTick = MuteAddr(&Addr, 10 * 60 * Server()->TickSpeed()); // 10 min
+                    pPlayer->m_ResetStrikesAfterMute = true;
 
-                    break;
+                    char aMute[128];
+                    str_format(aMute, sizeof(aMute), "'%s' has been auto-muted for 10 minutes (toxicity)", Server()->ClientName(ClientID));
+                    SendChat(-1, CHAT_ALL, aMute);
+                }
+                else
+                {
+                    char aWarn[128];
+                    str_format(aWarn, sizeof(aWarn), "⚠️ %s has been flagged for toxicity", Server()->ClientName(ClientID));
+                    SendChat(-1, CHAT_ALL, aWarn);
                 }
-            }*/
+            }
         }
 
 		else if(MsgID == NETMSGTYPE_CL_CALLVOTE)
@@ -1454,15 +1411,11 @@ void CGameContext::OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID)
 
 sServerCommand* CGameContext::FindCommand(const char* pCmd){
 	if(!pCmd) return NULL;
-	sServerCommand* pFindCmd = m_FirstServerCommand;
-	while(pFindCmd){
-		if(str_comp_nocase_whitespace(pFindCmd->m_Cmd, pCmd) == 0) return pFindCmd;
-		pFindCmd = pFindCmd->m_NextCommand;
-	}
-	return NULL;
+	return (sServerCommand*)m_ServerCommands.Find(pCmd);
 }
 
 void CGameContext::AddServerCommandSorted(sServerCommand* pCmd){
+	m_ServerCommands.Add(pCmd->m_Cmd, pCmd);
 	if(!m_FirstServerCommand){
 		m_FirstServerCommand = pCmd;
 	} else {
@@ -2421,6 +2374,7 @@ void CGameContext::OnConsoleInit()
     Console()->Register("toggle_dyncam", "i", CFGFLAG_SERVER, CGameContext::ConToggleDyncam, this, "Enable or disable dynamic camera draw distances");
     Console()->Register("mute", "ii", CFGFLAG_SERVER, ConMute, this, "Mute a player from sending chat messages");
     Console()->Register("unmute", "i", CFGFLAG_SERVER, ConUnmute, this, "Unmute a player by ID");
+    Console()->Register("reload_chat_filter", "", CFGFLAG_SERVER, ConReloadChatFilter, this, "Reload the chat filter word list");
 
 	// Added by Pig-Eye
 	Console()->Register("gamemode", "?s", CFGFLAG_SERVER, ConChangeGamemode, this, "Change the gamemode");
@@ -2527,6 +2481,9 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 		}
 	}
 
+	if(!ms_ChatFilter.NumWords())
+		LoadChatFilter();
+
 #ifdef CONF_DEBUG
 	if(m_Config->m_DbgDummies)
 	{
@@ -2613,6 +2570,9 @@ void CGameContext::OnInit(IKernel *pKernel, IMap* pMap, CConfiguration* pConfigF
 		}
 	}
 
+	if(!ms_ChatFilter.NumWords())
+		LoadChatFilter();
+
 #ifdef CONF_DEBUG
 	if(m_Config->m_DbgDummies)
 	{
@@ -2675,12 +2635,33 @@ void CGameContext::OnSnap(int ClientID)
 		}
 	}
 }
-void CGameContext::OnPreSnap() {}
+void CGameContext::OnPreSnap()
+{
+	m_SnapSerial++;
+}
 void CGameContext::OnPostSnap()
+{
+	// clients with a lower snapshot rate still get the events of the ticks in between
+	m_Events.Expire(Server()->Tick()-Server()->MaxSnapInterval());
+}
+
+void CGameContext::OnHibernate()
 {
 	m_Events.Clear();
 }
 
+void CGameContext::OnWakeUp(int HibernatedTicks)
+{
+	m_pController->OnWakeUp(HibernatedTicks);
+}
+
+int CGameContext::SnapCost(int SnappingClient, vec2 Pos, int Penalty)
+{
+	if(SnappingClient == -1 || !m_apPlayers[SnappingClient])
+		return Penalty;
+	return round_to_int(distance(m_apPlayers[SnappingClient]->m_ViewPos, Pos))+Penalty;
+}
+
 bool CGameContext::IsClientReady(int ClientID)
 {
 	return m_apPlayers[ClientID] && m_apPlayers[ClientID]->m_IsReady ? true : false;
@@ -2691,10 +2672,51 @@ bool CGameContext::IsClientPlayer(int ClientID)
 	return m_apPlayers[ClientID] && (m_apPlayers[ClientID]->GetTeam() == TEAM_SPECTATORS ? false : true);
 }
 
+bool CGameContext::IsClientActive(int ClientID)
+{
+	return IsClientPlayer(ClientID) && m_apPlayers[ClientID]->m_LastActionTick > Server()->Tick()-Server()->TickSpeed()*10;
+}
+
 const char *CGameContext::GameType() { return m_pController && m_pController->m_pGameType ? m_pController->m_pGameType : ""; }
 const char *CGameContext::Version() { return m_Config->m_SvEmoteWheel ? GAME_VERSION_PLUS : GAME_VERSION; }
 const char *CGameContext::NetVersion() { return GAME_NETVERSION; }
 
+static unsigned HashData(unsigned Hash, const void *pData, int Size)
+{
+	// FNV-1a
+	const unsigned char *pBytes = (const unsigned char *)pData;
+	for(int i = 0; i < Size; i++)
+		Hash = (Hash ^ pBytes[i]) * 16777619u;
+	return Hash;
+}
+
+unsigned CGameContext::WorldHash()
+{
+	unsigned Hash = HashData(2166136261u, &m_World.m_Paused, sizeof(m_World.m_Paused));
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CPlayer *pPlayer = m_apPlayers[i];
+		if(!pPlayer)
+			continue;
+
+		int aPlayer[3] = { i, pPlayer->GetTeam(), pPlayer->m_Score };
+		Hash = HashData(Hash, aPlayer, sizeof(aPlayer));
+
+		CCharacter *pChr = pPlayer->GetCharacter();
+		if(!pChr)
+			continue;
+
+		// raw floats, so drift below snapshot precision shows up as well
+		const CCharacterCore *pCore = pChr->Core();
+		int aCore[4] = { pCore->m_HookState, pCore->m_HookedPlayer, pCore->m_Jumped, pChr->IsFrozen() };
+		Hash = HashData(Hash, &pCore->m_Pos, sizeof(pCore->m_Pos));
+		Hash = HashData(Hash, &pCore->m_Vel, sizeof(pCore->m_Vel));
+		Hash = HashData(Hash, &pCore->m_HookPos, sizeof(pCore->m_HookPos));
+		Hash = HashData(Hash, aCore, sizeof(aCore));
+	}
+	return Hash;
+}
+
 
 void CGameContext::SendRoundStats()
 {
@@ -3159,64 +3181,99 @@ void CGameContext::SendRandomTrivia(){
 	}
 }
 
+int CGameContext::AddMsgVariant(CMsgVariant *pVariants, int NumVariants, int Key0, int Key1, int ClientID)
+{
+	int v = 0;
+	while(v < NumVariants && (pVariants[v].m_aKey[0] != Key0 || pVariants[v].m_aKey[1] != Key1))
+		v++;
+	if(v == NumVariants)
+	{
+		pVariants[v].m_aKey[0] = Key0;
+		pVariants[v].m_aKey[1] = Key1;
+		pVariants[v].m_NumClientIDs = 0;
+		NumVariants++;
+	}
+	pVariants[v].m_aClientIDs[pVariants[v].m_NumClientIDs++] = ClientID;
+	return NumVariants;
+}
+
 int CGameContext::SendPackMsg(CNetMsg_Sv_KillMsg *pMsg, int Flags)
 {
+	CMsgVariant aVariants[MAX_CLIENTS];
+	int NumVariants = 0;
 	for (int i = 0; i < MAX_CLIENTS; ++i) {
 		CPlayer* p = m_apPlayers[i];
 		if (!p) continue;
 
 		int id = pMsg->m_Killer;
 		int id2 = pMsg->m_Victim;
-
-		int originalId = pMsg->m_Killer;
-		int originalId2 = pMsg->m_Victim;
 		if (!p->IsSnappingClient(pMsg->m_Killer, p->m_ClientVersion, id) || !p->IsSnappingClient(pMsg->m_Victim, p->m_ClientVersion, id2)) continue;
-		pMsg->m_Killer = id;
-		pMsg->m_Victim = id2;
-		Server()->SendPackMsg(pMsg, Flags, i);
-		pMsg->m_Killer = originalId;
-		pMsg->m_Victim = originalId2;
+		NumVariants = AddMsgVariant(aVariants, NumVariants, id, id2, i);
+	}
+
+	Flags = RecordBroadcast(pMsg, Flags);
+	CNetMsg_Sv_KillMsg Msg = *pMsg;
+	for (int v = 0; v < NumVariants; ++v) {
+		Msg.m_Killer = aVariants[v].m_aKey[0];
+		Msg.m_Victim = aVariants[v].m_aKey[1];
+		Server()->SendPackMsgToClients(&Msg, Flags, aVariants[v].m_aClientIDs, aVariants[v].m_NumClientIDs);
 	}
 	return 0;
 }
 
 int CGameContext::SendPackMsg(CNetMsg_Sv_Emoticon *pMsg, int Flags)
 {
+	CMsgVariant aVariants[MAX_CLIENTS];
+	int NumVariants = 0;
 	for (int i = 0; i < MAX_CLIENTS; ++i) {
 		CPlayer* p = m_apPlayers[i];
 		if (!p) continue;
 
 		int id = pMsg->m_ClientID;
-		int originalID = pMsg->m_ClientID;
 		if (!p->IsSnappingClient(pMsg->m_ClientID, p->m_ClientVersion, id)) continue;
-		pMsg->m_ClientID = id;
-		Server()->SendPackMsg(pMsg, Flags, i);
-		pMsg->m_ClientID = originalID;
+		NumVariants = AddMsgVariant(aVariants, NumVariants, id, 0, i);
+	}
+
+	Flags = RecordBroadcast(pMsg, Flags);
+	CNetMsg_Sv_Emoticon Msg = *pMsg;
+	for (int v = 0; v < NumVariants; ++v) {
+		Msg.m_ClientID = aVariants[v].m_aKey[0];
+		Server()->SendPackMsgToClients(&Msg, Flags, aVariants[v].m_aClientIDs, aVariants[v].m_NumClientIDs);
 	}
 	return 0;
 }
 
-char msgbuf[1000];
-
 int CGameContext::SendPackMsg(CNetMsg_Sv_Chat *pMsg, int Flags)
 {
+	// the second key tells if the sender is hidden from the recipient and named in the text instead
+	CMsgVariant aVariants[MAX_CLIENTS];
+	int NumVariants = 0;
 	for (int i = 0; i < MAX_CLIENTS; ++i) {
 		CPlayer* p = m_apPlayers[i];
 		if (!p) continue;
 
 		int id = pMsg->m_ClientID;
-		int originalID = pMsg->m_ClientID;
-		const char* pOriginalText = pMsg->m_pMessage;
 		if (id > -1 && id < MAX_CLIENTS && !p->IsSnappingClient(pMsg->m_ClientID, p->m_ClientVersion, id)) {
-			str_format(msgbuf, sizeof(msgbuf), "%s: %s", Server()->ClientName(pMsg->m_ClientID), pMsg->m_pMessage);
+			id = (p->m_ClientVersion == CPlayer::CLIENT_VERSION_DDNET) ? CPlayer::DDNET_CLIENT_MAX_CLIENTS - 1 : CPlayer::VANILLA_CLIENT_MAX_CLIENTS - 1;
+			NumVariants = AddMsgVariant(aVariants, NumVariants, id, 1, i);
+		}
+		else
+			NumVariants = AddMsgVariant(aVariants, NumVariants, id, 0, i);
+	}
 
-			pMsg->m_ClientID = (p->m_ClientVersion == CPlayer::CLIENT_VERSION_DDNET) ? CPlayer::DDNET_CLIENT_MAX_CLIENTS - 1 : CPlayer::VANILLA_CLIENT_MAX_CLIENTS - 1;
-			pMsg->m_pMessage = msgbuf;
+	Flags = RecordBroadcast(pMsg, Flags);
+	CNetMsg_Sv_Chat Msg = *pMsg;
+	char aBuf[1000];
+	aBuf[0] = 0;
+	for (int v = 0; v < NumVariants; ++v) {
+		Msg.m_ClientID = aVariants[v].m_aKey[0];
+		Msg.m_pMessage = pMsg->m_pMessage;
+		if (aVariants[v].m_aKey[1]) {
+			if (!aBuf[0])
+				str_format(aBuf, sizeof(aBuf), "%s: %s", Server()->ClientName(pMsg->m_ClientID), pMsg->m_pMessage);
+			Msg.m_pMessage = aBuf;
 		}
-		else pMsg->m_ClientID = id;
-		Server()->SendPackMsg(pMsg, Flags, i); 
-		pMsg->m_ClientID = originalID;
-		pMsg->m_pMessage = pOriginalText;
+		Server()->SendPackMsgToClients(&Msg, Flags, aVariants[v].m_aClientIDs, aVariants[v].m_NumClientIDs);
 	}
 	return 0;
 }
@@ -3245,17 +3302,18 @@ int CGameContext::SendPackMsg(CNetMsg_Sv_Chat *pMsg, int Flags, int ClientID)
 	if(p->m_ClientVersion == CPlayer::CLIENT_VERSION_DDNET)
 		Server()->SendPackMsg(pMsg, Flags, ClientID);
 	else {
+		char aBuf[1000];
 		int StrLen = str_length(pMsg->m_pMessage);
 
 		int StrOffset = 0;
 		while(StrLen >= (126 - MAX_NAME_LENGTH)) {
 			if(ClientNotVisible)
-				str_format(msgbuf, sizeof(msgbuf), "%s: %s", Server()->ClientName(originalID), (pMsg->m_pMessage + (intptr_t)StrOffset));
+				str_format(aBuf, sizeof(aBuf), "%s: %s", Server()->ClientName(originalID), (pOriginalText + (intptr_t)StrOffset));
 			else
-				str_format(msgbuf, sizeof(msgbuf), "%s", (pMsg->m_pMessage + (intptr_t)StrOffset));
+				str_format(aBuf, sizeof(aBuf), "%s", (pOriginalText + (intptr_t)StrOffset));
 			
-			msgbuf[126] = 0;
-			pMsg->m_pMessage = msgbuf;
+			aBuf[126] = 0;
+			pMsg->m_pMessage = aBuf;
 			Server()->SendPackMsg(pMsg, Flags, ClientID);
 
 			StrLen -= (126 - MAX_NAME_LENGTH);
@@ -3264,10 +3322,10 @@ int CGameContext::SendPackMsg(CNetMsg_Sv_Chat *pMsg, int Flags, int ClientID)
 
 		if(StrLen > 0) {
 			if(ClientNotVisible)
-				str_format(msgbuf, sizeof(msgbuf), "%s: %s", Server()->ClientName(originalID), (pMsg->m_pMessage + (intptr_t)StrOffset));
+				str_format(aBuf, sizeof(aBuf), "%s: %s", Server()->ClientName(originalID), (pOriginalText + (intptr_t)StrOffset));
 			else
-				str_format(msgbuf, sizeof(msgbuf), "%s", (pMsg->m_pMessage + (intptr_t)StrOffset));
-			pMsg->m_pMessage = msgbuf;
+				str_format(aBuf, sizeof(aBuf), "%s", (pOriginalText + (intptr_t)StrOffset));
+			pMsg->m_pMessage = aBuf;
 			Server()->SendPackMsg(pMsg, Flags, ClientID);
 		}
 	}
@@ -3316,66 +3374,84 @@ CCharacter* CGameContext::GetClosestEnemyToAim(CCharacter* pShooter, float MaxDi
 
 void CGameContext::AddFrozenLeaver(const NETADDR &Addr, int Seconds)
 {
-	ExpireFrozenLeavers();
-
-	if(m_FrozenLeaverCount >= MAX_FROZEN_LEAVERS)
-	{
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "frozenban", "Frozen leaver list full!");
-		return;
-	}
-
-	NETADDR AddrClean = Addr;
-	AddrClean.port = 0;
-
-	m_aFrozenLeavers[m_FrozenLeaverCount].m_Addr = AddrClean;
-	m_aFrozenLeavers[m_FrozenLeaverCount].m_ExpireTick = Server()->Tick() + Seconds * Server()->TickSpeed();
-	++m_FrozenLeaverCount;
+	int ExpireTick = Server()->Tick() + Seconds * Server()->TickSpeed();
+	CNetAddrTable::CEntry *pEntry = m_FrozenLeavers.Set(&Addr, ExpireTick, 0);
+	ScheduleTimer(ExpireTick, FrozenLeaverTimer, 0);
 
 	char aBuf[NETADDR_MAXSTRSIZE];
-	net_addr_str(&AddrClean, aBuf, sizeof(aBuf), true);
+	net_addr_str(&pEntry->m_Addr, aBuf, sizeof(aBuf), false);
 	char aPrint[128];
 	str_format(aPrint, sizeof(aPrint), "Added frozen leaver block for %s (%ds)", aBuf, Seconds);
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "frozenban", aPrint);
 }
 
-bool CGameContext::IsFrozenLeaverBlocked(const NETADDR &Addr)
+int CGameContext::FrozenLeaverTicksLeft(const NETADDR &Addr)
 {
-	ExpireFrozenLeavers();
+	CNetAddrTable::CEntry *pEntry = m_FrozenLeavers.Find(&Addr, Server()->Tick());
+	return pEntry ? pEntry->m_ExpireTick - Server()->Tick() : 0;
+}
+
+void CGameContext::LogExpiredFrozenLeaver(const CNetAddrTable::CEntry *pEntry, void *pUser)
+{
+	CGameContext *pSelf = (CGameContext *)pUser;
+	char aBuf[NETADDR_MAXSTRSIZE];
+	net_addr_str(&pEntry->m_Addr, aBuf, sizeof(aBuf), false);
+	char aPrint[128];
+	str_format(aPrint, sizeof(aPrint), "Expired frozen leaver block for %s", aBuf);
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "frozenban", aPrint);
+}
+
+void CGameContext::FrozenLeaverTimer(void *pUser, int Data)
+{
+	CGameContext *pSelf = (CGameContext *)pUser;
+	pSelf->m_FrozenLeavers.Expire(pSelf->Server()->Tick(), LogExpiredFrozenLeaver, pSelf);
+}
 
-	NETADDR AddrClean = Addr;
-	AddrClean.port = 0;
+void CGameContext::MultiEndTimer(void *pUser, int Data)
+{
+	CGameContext *pSelf = (CGameContext *)pUser;
+	CPlayer *pPlayer = pSelf->m_apPlayers[Data];
+	if(!pPlayer)
+		return;
 
-	for(int i = 0; i < m_FrozenLeaverCount; ++i)
+	pPlayer->m_MultiEndTimer = CTimerWheel::INVALID_TIMER;
+	if(pPlayer->m_MultiCount > 1 && pSelf->Server()->Tick() > pPlayer->m_MultiEndAnnounceTick)
 	{
-		NETADDR BanAddr = m_aFrozenLeavers[i].m_Addr;
-		BanAddr.port = 0;
+		pSelf->SendChatTarget(Data, "multi ended");
 
-		if(net_addr_comp(&BanAddr, &AddrClean) == 0)
-			return true;
+		pPlayer->m_MultiCount = 0;
+		pPlayer->m_LastKillTick = -1;
+		pPlayer->m_MultiEndAnnounceTick = -1;
 	}
-	return false;
 }
 
+void CGameContext::MutePurgeTimer(void *pUser, int Data)
+{
+	CGameContext *pSelf = (CGameContext *)pUser;
+	pSelf->m_MutedAddrs.Expire(pSelf->Server()->Tick(), 0, 0);
+}
 
-void CGameContext::ExpireFrozenLeavers()
+int CGameContext::ScheduleTimer(int Tick, CTimerWheel::FCallback pfnCallback, int Data)
 {
-	int i = 0;
-	while(i < m_FrozenLeaverCount)
-	{
-		if(m_aFrozenLeavers[i].m_ExpireTick < Server()->Tick())
-		{
-			char aBuf[NETADDR_MAXSTRSIZE];
-			net_addr_str(&m_aFrozenLeavers[i].m_Addr, aBuf, sizeof(aBuf), true);
-			char aPrint[128];
-			str_format(aPrint, sizeof(aPrint), "Expired frozen leaver block for %s", aBuf);
-			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "frozenban", aPrint);
+	// an empty wheel falls behind while no ticks run, catch up without firing anything
+	if(!m_Timers.NumTimers())
+		m_Timers.Advance(Server()->Tick());
+	return m_Timers.Schedule(Tick, pfnCallback, this, Data);
+}
 
-			m_aFrozenLeavers[i] = m_aFrozenLeavers[m_FrozenLeaverCount - 1];
-			--m_FrozenLeaverCount;
-		}
-		else
-			++i;
-	}
+void CGameContext::ScheduleMultiEnd(int ClientID)
+{
+	CPlayer *pPlayer = m_apPlayers[ClientID];
+	m_Timers.Cancel(pPlayer->m_MultiEndTimer);
+	pPlayer->m_MultiEndTimer = ScheduleTimer(pPlayer->m_MultiEndAnnounceTick+1, MultiEndTimer, ClientID);
+}
+
+int CGameContext::MuteAddr(const NETADDR *pAddr, int Ticks)
+{
+	int ExpireTick = Server()->Tick() + Ticks;
+	m_MutedAddrs.Set(pAddr, ExpireTick, 0);
+	ScheduleTimer(ExpireTick, MutePurgeTimer, 0);
+	return ExpireTick;
 }
 
 //  CUSTOM SERVER COMMANDS FOR CONSOLE AND CHAT
@@ -3427,9 +3503,9 @@ void CGameContext::ConMute(IConsole::IResult *pResult, void *pUser)
 		return;
 	}
 
-	char aAddrStr[NETADDR_MAXSTRSIZE];
-    pSelf->Server()->GetClientAddr(ClientID, aAddrStr, sizeof(aAddrStr));
-    pSelf->m_MutedIPs[aAddrStr] = pSelf->Server()->Tick() + Seconds * pSelf->Server()->TickSpeed();
+	NETADDR Addr;
+	pSelf->Server()->GetNetAddr(&Addr, ClientID);
+	pSelf->MuteAddr(&Addr, Seconds * pSelf->Server()->TickSpeed());
 
 	char aBuf[128];
 	str_format(aBuf, sizeof(aBuf), "'%s' has been muted for %d seconds.",
@@ -3445,11 +3521,10 @@ void CGameContext::ConUnmute(IConsole::IResult *pResult, void *pUserData)
     if(!pSelf->m_apPlayers[ClientID])
         return;
 
-    char aAddrStr[NETADDR_MAXSTRSIZE];
-    pSelf->Server()->GetClientAddr(ClientID, aAddrStr, sizeof(aAddrStr));
+    NETADDR Addr;
+    pSelf->Server()->GetNetAddr(&Addr, ClientID);
 
-    int Removed = pSelf->m_MutedIPs.erase(aAddrStr);
-    if(Removed)
+    if(pSelf->m_MutedAddrs.Remove(&Addr))
     {
         char aBuf[64];
         str_format(aBuf, sizeof(aBuf), "'%s' has been unmuted", pSelf->Server()->ClientName(ClientID));
@@ -3461,6 +3536,27 @@ void CGameContext::ConUnmute(IConsole::IResult *pResult, void *pUserData)
     }
 }
 
+void CGameContext::LoadChatFilter()
+{
+	char aBuf[256];
+	if(!m_Config->m_SvChatFilter[0])
+	{
+		ms_ChatFilter.Clear();
+		return;
+	}
+
+	if(ms_ChatFilter.Load(Storage(), m_Config->m_SvChatFilter) != 0)
+		str_format(aBuf, sizeof(aBuf), "failed to open '%s'", m_Config->m_SvChatFilter);
+	else
+		str_format(aBuf, sizeof(aBuf), "loaded %d words from '%s'", ms_ChatFilter.NumWords(), m_Config->m_SvChatFilter);
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "chatfilter", aBuf);
+}
+
+void CGameContext::ConReloadChatFilter(IConsole::IResult *pResult, void *pUserData)
+{
+	((CGameContext *)pUserData)->LoadChatFilter();
+}
+
 void CGameContext::ConChangeGamemode(IConsole::IResult *pResult, void *pUserData)
 {
 	CGameContext *pSelf = (CGameContext *)pUserData;
@@ -3538,88 +3634,6 @@ void CGameContext::ConMakeSay(IConsole::IResult *pResult, void *pUserData)
 
 
 // END OF CUSTOM SERVER COMMANDS
-extern "C" void NormalizeChat(char *pStr, int Size)
-{
-    char aOut[256];
-    int iWrite = 0;
-
-    // Define replacement sets
-    struct { const char *pFrom; char To; } aReplacements[] = {
-        { "AÁÀÂÃÄÅĀĂĄǍȦǠÆⱯ∀🅰Ⓐⓐ@", 'a' },
-        { "BḂḄḆƁƀƂƃℬ🅱Ⓑⓑ", 'b' },
-        { "CÇĆĈĊČƇƈȻȼℂ🅲Ⓒⓒ", 'c' },
-        { "DĎĐḊḌḎḐḒƊƋ🅳Ⓓⓓ", 'd' },
-        { "EÉÈÊËĒĔĖĘĚȨℰ🅴Ⓔⓔ3", 'e' },
-        { "FƑƒḞℱ🅵Ⓕⓕ", 'f' },
-        { "GĜĞĠĢƓɠℊ🅶Ⓖⓖ9", 'g' },
-        { "HĤĦḢḤḦḨḪℋ🅷Ⓗⓗ", 'h' },
-        { "IÍÌÎÏĨĪĬĮİǏƗℐ🅸Ⓘⓘ1", 'i' },
-        { "JĴ🅹Ⓙⓙ", 'j' },
-        { "KĶƘḰḲḴ🅺Ⓚⓚ", 'k' },
-        { "LĹĻĽĿŁ🅻Ⓛⓛ", 'l' },
-        { "MḾṀṂℳ🅼Ⓜⓜ", 'm' },
-        { "NŃŅŇƝṄṆṈṊℕ🅽Ⓝⓝ", 'n' },
-        { "OÓÒÔÕÖŌŎŐǑƠØȮȰŒ🅾Ⓞⓞ", 'o' },
-        { "PƤṔṖ🅿Ⓟⓟ", 'p' },
-        { "Qℚ🆀Ⓠⓠ", 'q' },
-        { "RŔŖŘṘṚṜṞℝ🆁Ⓡⓡ", 'r' },
-        { "SŚŜŞŠṠṢṤṦṨ🆂Ⓢⓢ5", 's' },
-        { "TŢŤṪṬṮṰ🆃Ⓣⓣ", 't' },
-        { "UÚÙÛÜŨŪŬŮŰŲǓƯ🆄Ⓤⓤ", 'u' },
-        { "VṼṾ🆅Ⓥⓥ", 'v' },
-        { "WẀẂẄŴ🆆Ⓦⓦ", 'w' },
-        { "XẊẌ🆇Ⓧⓧ", 'x' },
-        { "YÝŶŸȲɎ🆈Ⓨⓨ¥", 'y' },
-        { "ZŹŻŽƵẐẒẔ🆉Ⓩⓩ", 'z' },
-    };
-
-    // Characters to fully remove (symbols, punctuation, emoji, etc.)
-    const char *aRemove =
-        "⓪①②③④⑤⑥⑦⑧⑨"
-        "ⓐⓑⓒⓓⓔⓕⓖⓗⓘⓙⓚⓛⓜⓝⓞⓟⓠⓡⓢⓣⓤⓥⓦⓧⓨⓩ"
-        "ⒶⒷⒸⒹⒺⒻⒼⒽⒾⒿⓀⓁⓂⓃⓄⓅⓆⓇⓈⓉⓊⓋⓌⓍⓎⓏ"
-        "⌀⌁⌂⍓⍔⍕⍖⍗⍘⍙⍚⌃⌄⌅⌆⌇⌈⌉⌊⌋⌌⌍⌎⌏⌐⌑⌒⌓⌔⌕⌖⌗⌘⌙⌚⌛⌜⌝"
-        "⌞⌟⌠⌡⌢⌣⌤⌥⌦⌧⌫⌬⌭⌮⌯⌰⌱⌲⌳⌴⌵⌶⌿⍀⍁⍂⍃⍄⍅⍆⍇⍈⍉⍊⍋"
-        "⍌⍍⍎⍏⍐⍑⍒⍚﹘｝～"
-        "♔♚♕♛♗♝♘♞♙♟♖♜"
-        "☼☽☾❅❆ϟ☀☁☂☃☄☼"
-        "⋆✢✥✦✧❂❉✱✲✴✵✶✷✸❇✹✺✻✼❈✮✡"
-        "¼½¾⅓⅔⅛⅜⅝≈>≥≧≩≫≳⋝÷∕±∓≂⊟⊞⨁⨤⨦%∟∠∡⊾⟀⦌⦋⦀√∛∜"
-        "≡≢⧥⩧⅀◊⟠⨌⨏⨜⨛◜◝◞◟"
-        "↑↓→←↔▲▼►◄△⇿⇾⇽⇼⇻⇺⇹⇸⇶⇵⇳"
-        "⇲⇱⇪⇩⇨⇧⇦⇥⇤⇣⇢⇡⇠⇛⇙⇘⇗⇖⇕⇔⇓⇒⇑"
-        "⇐⇌⇋⥊⥋⇆⇅⇄↻↺↹↷↶↵↴↳↲↱↰↮↬↫"
-        "↨↧↦↥↤↛↚↙↘↗↖↕"
-        "-=_!@#$%^&*()_+[]\\;'\",./{}|:<>? ";
-
-    for(int i = 0; pStr[i] && iWrite < Size - 1; ++i)
-    {
-        unsigned char c = (unsigned char)pStr[i];
-        bool bReplaced = false;
-
-        // Try replacing from mapping table
-        for(unsigned j = 0; j < sizeof(aReplacements)/sizeof(aReplacements[0]); ++j)
-        {
-            if(str_chr(aReplacements[j].pFrom, c))
-            {
-                c = aReplacements[j].To;
-                bReplaced = true;
-                break;
-            }
-        }
-
-        // If still not replaced and needs removal, skip
-        if(!bReplaced && str_chr(aRemove, c))
-            continue;
-
-        // Normalize to lowercase
-        aOut[iWrite++] = tolower(c);
-    }
-
-    aOut[iWrite] = '\0';
-    str_copy(pStr, aOut, Size);
-}
-
 void CGameContext::SavePlayerStatsToFile(CPlayer *pPlayer)
 {
 	//dbg_msg("stats", "running function to save stats.db");
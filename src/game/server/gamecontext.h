@@ -5,13 +5,17 @@
 
 #include <engine/server.h>
 #include <engine/console.h>
+#include <engine/shared/addrtable.h>
+#include <engine/shared/cmdtable.h>
 #include <engine/shared/memheap.h>
 #include <engine/shared/protocol.h> // for NETADDR
+#include <engine/shared/timerwheel.h>
 
 #include <game/layers.h>
 #include <game/voting.h>
 
 #include "game/server/entity.h"
+#include "chatfilter.h"
 #include "eventhandler.h"
 #include "gamecontroller.h"
 #include "gameworld.h"
@@ -114,24 +118,27 @@ struct sServerCommand{
 	
 	sServerCommand(const char* pCmd, const char* pDesc, const char* pArgFormat, ServerCommandExecuteFunc pFunc) : m_Cmd(pCmd), m_Desc(pDesc), m_ArgFormat(pArgFormat), m_NextCommand(0), m_Func(pFunc) {}
 	
+	enum { MAX_ARGS = 64 };
+
 	void ExecuteCommand(class CGameContext* pContext, int pClientID, const char* pArgs){	
-		const char* m_Args[128/2];
-		int m_ArgCount = 0;
+		const char* aArgs[MAX_ARGS];
+		int ArgCount = 0;
 		
+		// the arguments point into the line, the last one keeps the rest of it
 		const char* c = pArgs;
 		const char* s = pArgs;
-		while(c && *c){
+		while(c && *c && ArgCount < MAX_ARGS - 1){
 			if(is_whitespace(*c)){
-				m_Args[m_ArgCount++] = s;
+				aArgs[ArgCount++] = s;
 				s = c + 1;
 			}
 			++c;
 		}
 		if (s) {
-			m_Args[m_ArgCount++] = s;
+			aArgs[ArgCount++] = s;
 		}
 		
-		m_Func(pContext, pClientID, m_Args, m_ArgCount);
+		m_Func(pContext, pClientID, aArgs, ArgCount);
 	}
 };
 
@@ -200,21 +207,19 @@ class CGameContext : public IGameServer
 	void AddServerCommandSorted(sServerCommand* pCmd);
 
 	void AddFrozenLeaver(const NETADDR &Addr, int Seconds);
-	bool IsFrozenLeaverBlocked(const NETADDR &Addr);
-	void ExpireFrozenLeavers();
+	int FrozenLeaverTicksLeft(const NETADDR &Addr);
+
+	static void LogExpiredFrozenLeaver(const CNetAddrTable::CEntry *pEntry, void *pUser);
+
+	static void FrozenLeaverTimer(void *pUser, int Data);
+	static void MultiEndTimer(void *pUser, int Data);
+	static void MutePurgeTimer(void *pUser, int Data);
     
 public:
-    enum { MAX_FROZEN_LEAVERS = 16 };
-    struct CFrozenLeaver
-    {
-        NETADDR m_Addr;
-        int m_ExpireTick;
-    };
-
-    CFrozenLeaver m_aFrozenLeavers[MAX_FROZEN_LEAVERS];
-    int m_FrozenLeaverCount;
+    CNetAddrTable m_FrozenLeavers;
 
 	sServerCommand* m_FirstServerCommand;
+	CCommandTable m_ServerCommands;
 	void AddServerCommand(const char* pCmd, const char* pDesc, const char* pArgFormat, ServerCommandExecuteFunc pFunc);
 	void ExecuteServerCommand(int pClientID, const char* pLine);
 	
@@ -235,14 +240,34 @@ public:
 	void Clear();
 
 	CEventHandler m_Events;
+	// bumped before every snapshot round, entities rebuild their shared snap items once per round
+	int m_SnapSerial;
 	CPlayer *m_apPlayers[MAX_CLIENTS];
 
 	IGameController *m_pController;
 	CGameWorld m_World;
 
+	// expirations of players, mutes and frozen leavers, advanced once per tick
+	CTimerWheel m_Timers;
+	int ScheduleTimer(int Tick, CTimerWheel::FCallback pfnCallback, int Data);
+	void ScheduleMultiEnd(int ClientID);
+	int MuteAddr(const NETADDR *pAddr, int Ticks);
+
 	// helper functions
 	class CCharacter *GetPlayerChar(int ClientID);
 
+	// cost of a snap item against the snapshot budget of a client: the distance
+	// to its view plus a penalty for what matters less than the players
+	enum
+	{
+		SNAPCOST_PLAYER=0,
+		SNAPCOST_PROJECTILE=200,
+		SNAPCOST_EVENT=300,
+		SNAPCOST_PICKUP=400,
+		SNAPCOST_DECORATION=1000,
+	};
+	int SnapCost(int SnappingClient, vec2 Pos, int Penalty);
+
 	int m_LockTeams;
 
 	// voting
@@ -274,7 +299,7 @@ public:
 	// Constants regarding player blocking
 	float m_BlockSecondsIncrease = 0.05;
 	float m_BlockSecondsMax = 2.0;
-	int m_BlockMessageDelay = 3 * Server()->TickSpeed();
+	int m_BlockMessageDelay = 3 * SERVER_TICK_SPEED;
 
 	// helper functions
 	void MakeLaserTextPoints(vec2 pPos, int pOwner, int pPoints);
@@ -332,6 +357,9 @@ public:
 	virtual void OnSnap(int ClientID);
 	virtual void OnPostSnap();
 
+	virtual void OnHibernate();
+	virtual void OnWakeUp(int HibernatedTicks);
+
 	virtual void OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID);
 
 	virtual void OnClientConnected(int ClientID, int PreferedTeam = -2);
@@ -342,10 +370,12 @@ public:
 
 	virtual bool IsClientReady(int ClientID);
 	virtual bool IsClientPlayer(int ClientID);
+	virtual bool IsClientActive(int ClientID);
 
 	virtual const char *GameType();
 	virtual const char *Version();
 	virtual const char *NetVersion();
+	virtual unsigned WorldHash();
 
 	void SendRoundStats();
 	void SendRandomTrivia();
@@ -353,12 +383,31 @@ public:
 	template<class T>
 	int SendPackMsg(T *pMsg, int Flags)
 	{
+		int aClientIDs[MAX_CLIENTS];
+		int NumClientIDs = 0;
 		for (int i = 0; i < MAX_CLIENTS; ++i) {
-			CPlayer* p = m_apPlayers[i];
-			if (!p) continue;
-			Server()->SendPackMsg(pMsg, Flags, i);
+			if (m_apPlayers[i])
+				aClientIDs[NumClientIDs++] = i;
 		}
-		return 0;
+		return Server()->SendPackMsgToClients(pMsg, Flags, aClientIDs, NumClientIDs);
+	}
+
+	// recipients that see a broadcast the same way share one packed copy of it
+	struct CMsgVariant
+	{
+		int m_aKey[2];
+		int m_aClientIDs[MAX_CLIENTS];
+		int m_NumClientIDs;
+	};
+	static int AddMsgVariant(CMsgVariant *pVariants, int NumVariants, int Key0, int Key1, int ClientID);
+
+	// the demo gets a single copy of a broadcast, with the ids as they are in this game
+	template<class T>
+	int RecordBroadcast(T *pMsg, int Flags)
+	{
+		if(!(Flags&MSGFLAG_NORECORD) && Server()->DemoRecorder_IsRecording())
+			Server()->SendPackMsg(pMsg, Flags|MSGFLAG_NOSEND, -1);
+		return Flags|MSGFLAG_NORECORD;
 	}
 
 	int SendPackMsg(CNetMsg_Sv_KillMsg *pMsg, int Flags);
@@ -370,7 +419,12 @@ public:
 	int SendPackMsg(CNetMsg_Sv_Chat *pMsg, int Flags, int ClientID);
     
     bool m_DyncamEnabled = true;
-    std::map<std::string, int64_t> m_MutedIPs;
+    CNetAddrTable m_MutedAddrs;
+    CNetAddrTable m_VoteGroups;
+
+    // toxicity word list, shared by all games
+    static CChatFilter ms_ChatFilter;
+    void LoadChatFilter();
     
     void SavePlayerStatsToFile(class CPlayer *pPlayer);
     void LoadPlayerStatsFromFile(class CPlayer *pPlayer);
@@ -388,6 +442,7 @@ public:
     static void CmdUseless(CGameContext* pContext, int pClientID, const char** pArgs, int ArgNum);
     static void ConMute(IConsole::IResult *pResult, void *pUser);
     static void ConUnmute(IConsole::IResult *pResult, void *pUser);
+    static void ConReloadChatFilter(IConsole::IResult *pResult, void *pUserData);
     static void CmdPause(CGameContext* pContext, int pClientID, const char** pArgs, int ArgNum);
     static void CmdStatsAll(CGameContext* pContext, int pClientID, const char** pArgs, int ArgNum);
     static void CmdFewSteals(CGameContext* pContext, int pClientID, const char** pArgs, int ArgNum);
@@ -429,5 +484,4 @@ inline QuadroMask CmaskAll() { return QuadroMask(-1); }
 inline QuadroMask CmaskOne(int ClientID) { return QuadroMask(1ll<<(ClientID%(sizeof(long long)*8)), (ClientID/(sizeof(long long)*8))); }
 inline QuadroMask CmaskAllExceptOne(int ClientID) { return CmaskOne(ClientID)^0xffffffffffffffffll; }
 inline bool CmaskIsSet(QuadroMask Mask, int ClientID) { return (Mask&CmaskOne(ClientID)) != 0; }
-extern "C" void NormalizeChat(char *pStr, int Size);
 #endif
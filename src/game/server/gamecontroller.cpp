@@ -12,6 +12,7 @@
 #include <time.h>
 
 IGameController::IGameController(class CGameContext *pGameServer) : 
+	m_SpawnEval(&pGameServer->m_World, pGameServer->Collision()),
 	m_Config(g_Config)
 {
 	m_CustomConfig = false;
@@ -33,13 +34,11 @@ IGameController::IGameController(class CGameContext *pGameServer) :
 
 	m_UnbalancedTick = -1;
 	m_ForceBalanced = false;
-
-	m_aNumSpawnPoints[0] = 0;
-	m_aNumSpawnPoints[1] = 0;
-	m_aNumSpawnPoints[2] = 0;
+	m_SnapSerial = -1;
 }
 
 IGameController::IGameController(class CGameContext *pGameServer, CConfiguration& pConfig) :
+	m_SpawnEval(&pGameServer->m_World, pGameServer->Collision()),
 	m_Config(pConfig)
 {
 	m_CustomConfig = true;
@@ -62,67 +61,28 @@ IGameController::IGameController(class CGameContext *pGameServer, CConfiguration
 
 	m_UnbalancedTick = -1;
 	m_ForceBalanced = false;
-
-	m_aNumSpawnPoints[0] = 0;
-	m_aNumSpawnPoints[1] = 0;
-	m_aNumSpawnPoints[2] = 0;
+	m_SnapSerial = -1;
 }
 
 IGameController::~IGameController()
 {
 }
 
-float IGameController::EvaluateSpawnPos(CSpawnEval *pEval, vec2 Pos)
-{
-	// for random respawns, dont compare them
-	// against distances from other characters
-	if (m_Config.m_SvRandomRespawn)
-	{
-		return (float)rand();
-	}
-
-	float Score = 0.0f;
-	CCharacter *pC = static_cast<CCharacter *>(GameServer()->m_World.FindFirst(CGameWorld::ENTTYPE_CHARACTER));
-	for(; pC; pC = (CCharacter *)pC->TypeNext())
-	{
-		// team mates are not as dangerous as enemies
-		float Scoremod = 1.0f;
-		if(pEval->m_FriendlyTeam != -1 && pC->GetPlayer()->GetTeam() == pEval->m_FriendlyTeam)
-			Scoremod = 0.5f;
-
-		float d = distance(Pos, pC->m_Pos);
-		Score += Scoremod * (d == 0 ? 1000000000.0f : 1.0f/d);
-	}
-
-	return Score;
-}
-
 void IGameController::EvaluateSpawnType(CSpawnEval *pEval, int Type)
 {
-	// get spawn point
-	for(int i = 0; i < m_aNumSpawnPoints[Type]; i++)
+	// the field is up to date, pick the least dangerous free spawn point
+	for(int i = 0; i < m_SpawnEval.NumPoints(Type); i++)
 	{
-		// check if the position is occupado
-		CCharacter *aEnts[MAX_CLIENTS];
-		int Num = GameServer()->m_World.FindEntities(m_aaSpawnPoints[Type][i], 64, (CEntity**)aEnts, MAX_CLIENTS, CGameWorld::ENTTYPE_CHARACTER);
-		vec2 Positions[5] = { vec2(0.0f, 0.0f), vec2(-32.0f, 0.0f), vec2(0.0f, -32.0f), vec2(32.0f, 0.0f), vec2(0.0f, 32.0f) };	// start, left, up, right, down
-		int Result = -1;
-		for(int Index = 0; Index < 5 && Result == -1; ++Index)
-		{
-			Result = Index;
-			for(int c = 0; c < Num; ++c)
-				if(GameServer()->Collision()->CheckPoint(m_aaSpawnPoints[Type][i]+Positions[Index]) ||
-					distance(aEnts[c]->m_Pos, m_aaSpawnPoints[Type][i]+Positions[Index]) <= aEnts[c]->m_ProximityRadius)
-				{
-					Result = -1;
-					break;
-				}
-		}
-		if(Result == -1)
+		vec2 P;
+		float S;
+		if(!m_SpawnEval.GetPoint(Type, i, pEval->m_FriendlyTeam, &P, &S))
 			continue;	// try next spawn point
 
-		vec2 P = m_aaSpawnPoints[Type][i]+Positions[Result];
-		float S = EvaluateSpawnPos(pEval, P);
+		// for random respawns, dont compare them
+		// against distances from other characters
+		if(m_Config.m_SvRandomRespawn)
+			S = (float)rand();
+
 		if(!pEval->m_Got || pEval->m_Score > S)
 		{
 			pEval->m_Got = true;
@@ -140,6 +100,8 @@ bool IGameController::CanSpawn(int Team, vec2 *pOutPos)
 	if(Team == TEAM_SPECTATORS)
 		return false;
 
+	m_SpawnEval.Update();
+
 	if(IsTeamplay())
 	{
 		Eval.m_FriendlyTeam = Team;
@@ -171,11 +133,11 @@ bool IGameController::OnEntity(int Index, vec2 Pos)
 	int SubType = 0;
 
 	if(Index == ENTITY_SPAWN)
-		m_aaSpawnPoints[0][m_aNumSpawnPoints[0]++] = Pos;
+		m_SpawnEval.AddPoint(0, Pos);
 	else if(Index == ENTITY_SPAWN_RED)
-		m_aaSpawnPoints[1][m_aNumSpawnPoints[1]++] = Pos;
+		m_SpawnEval.AddPoint(1, Pos);
 	else if(Index == ENTITY_SPAWN_BLUE)
-		m_aaSpawnPoints[2][m_aNumSpawnPoints[2]++] = Pos;
+		m_SpawnEval.AddPoint(2, Pos);
 	else if(Index == ENTITY_ARMOR_1)
 		Type = POWERUP_ARMOR;
 	else if(Index == ENTITY_HEALTH_1)
@@ -230,6 +192,7 @@ void IGameController::EndRound()
             pPlayer->m_MultiCount = 0;
             pPlayer->m_LastKillTick = -1;
             pPlayer->m_MultiEndAnnounceTick = -1;
+            GameServer()->m_Timers.Cancel(pPlayer->m_MultiEndTimer);
             pPlayer->ResetRoundStats();
         }
     }
@@ -508,6 +471,33 @@ bool IGameController::CanBeMovedOnBalance(int ClientID)
 	return true;
 }
 
+void IGameController::ReportSpawnStats()
+{
+	// spawn evaluation is reported as its own phase
+	if(!m_Config.m_Debug || Server()->Tick()%(Server()->TickSpeed()*10) != 0)
+		return;
+
+	int NumQueries, NumUpdates;
+	int64 UpdateTime;
+	m_SpawnEval.TakeStats(&NumQueries, &NumUpdates, &UpdateTime);
+	if(!NumQueries)
+		return;
+
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "%d spawn queries, %d field updates, %.3fms", NumQueries, NumUpdates, UpdateTime*1000.0/time_freq());
+	GameServer()->Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "spawn", aBuf);
+}
+
+void IGameController::OnWakeUp(int HibernatedTicks)
+{
+	// the warmup only counts down in ticks, it stood still anyway
+	m_RoundStartTick += HibernatedTicks;
+	if(m_GameOverTick != -1)
+		m_GameOverTick += HibernatedTicks;
+	if(m_UnbalancedTick != -1)
+		m_UnbalancedTick += HibernatedTicks;
+}
+
 void IGameController::Tick()
 {
 	// do warmup
@@ -539,6 +529,8 @@ void IGameController::Tick()
 	if(GameServer()->m_World.m_Paused)
 		++m_RoundStartTick;
 
+	ReportSpawnStats();
+
 	// do team-balancing
 	if(IsTeamplay() && m_UnbalancedTick != -1 && Server()->Tick() > m_UnbalancedTick+m_Config.m_SvTeambalanceTime*Server()->TickSpeed()*60)
 	{
@@ -657,6 +649,13 @@ void IGameController::Snap(int SnappingClient)
 	if(!pGameInfoObj)
 		return;
 
+	if(m_SnapSerial == GameServer()->m_SnapSerial)
+	{
+		mem_copy(pGameInfoObj, &m_SnapGameInfo, sizeof(CNetObj_GameInfo));
+		return;
+	}
+	m_SnapSerial = GameServer()->m_SnapSerial;
+
 	pGameInfoObj->m_GameFlags = m_GameFlags;
 	pGameInfoObj->m_GameStateFlags = 0;
 	if(m_GameOverTick != -1)
@@ -673,6 +672,7 @@ void IGameController::Snap(int SnappingClient)
 
 	pGameInfoObj->m_RoundNum = (str_length(m_Config.m_SvMaprotation) && m_Config.m_SvRoundsPerMap) ? m_Config.m_SvRoundsPerMap : 0;
 	pGameInfoObj->m_RoundCurrent = m_RoundCount+1;
+	mem_copy(&m_SnapGameInfo, pGameInfoObj, sizeof(CNetObj_GameInfo));
 }
 
 int IGameController::GetAutoTeam(int NotThisID)
@@ -5,6 +5,9 @@
 
 #include <base/vmath.h>
 #include <engine/shared/config.h>
+#include <game/generated/protocol.h>
+
+#include "spawneval.h"
 
 /*
 	Class: Game Controller
@@ -14,8 +17,7 @@
 class IGameController
 {
 protected:
-	vec2 m_aaSpawnPoints[3][64];
-	int m_aNumSpawnPoints[3];
+	CSpawnEvaluator m_SpawnEval;
 	
 	CConfiguration& m_Config;
 
@@ -43,9 +45,9 @@ protected:
 		float m_Score;
 	};
 
-	float EvaluateSpawnPos(CSpawnEval *pEval, vec2 Pos);
 	void EvaluateSpawnType(CSpawnEval *pEval, int Type);
 	bool EvaluateSpawn(class CPlayer *pP, vec2 *pPos);
+	void ReportSpawnStats();
 
 	void CycleMap();
 	void ResetGame();
@@ -65,6 +67,10 @@ protected:
 
 	int m_GameFlags;
 	int m_UnbalancedTick;
+
+	// game info is the same for every viewer, built once per snapshot round
+	int m_SnapSerial;
+	CNetObj_GameInfo m_SnapGameInfo;
 	bool m_ForceBalanced;
 
 public:
@@ -98,6 +104,8 @@ public:
 	virtual bool CanBeMovedOnBalance(int ClientID);
 
 	virtual void Tick();
+	// continues the round timers after the game hibernated
+	virtual void OnWakeUp(int HibernatedTicks);
 
 	virtual void Snap(int SnappingClient);
 
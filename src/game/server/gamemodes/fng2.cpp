@@ -64,6 +64,8 @@ void CGameControllerFNG2::Tick()
 		if(GameServer()->m_World.m_Paused) ++m_RoundStartTick;
 	}
 
+	ReportSpawnStats();
+
 	// do team-balancing
 	if(IsTeamplay() && m_UnbalancedTick != -1 && Server()->Tick() > m_UnbalancedTick+m_Config.m_SvTeambalanceTime*Server()->TickSpeed()*60 && !m_Config.m_SvTournamentMode)
 	{
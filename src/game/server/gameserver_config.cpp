@@ -202,13 +202,11 @@ int CGameServerConfig::ParseArgs(CResult *pResult)
 
 CConfigCommand *CGameServerConfig::FindCommand(const char *pName, int FlagMask)
 {
-	for(CConfigCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	int Index = -1;
+	while(CConfigCommand *pCommand = (CConfigCommand *)m_CommandTable.Find(pName, &Index))
 	{
-		if(pCommand->m_Flags & FlagMask)
-		{
-			if(str_comp_nocase(pCommand->m_pName, pName) == 0)
-				return pCommand;
-		}
+		if(pCommand->m_Flags & FlagMask && str_comp_nocase(pCommand->m_pName, pName) == 0)
+			return pCommand;
 	}
 
 	return 0x0;
@@ -405,6 +403,7 @@ void CGameServerConfig::AddCommandSorted(CConfigCommand *pCommand)
 			}
 		}
 	}
+	m_CommandTable.Add(pCommand->m_pName, pCommand);
 }
 
 void CGameServerConfig::Register(const char *pName, int Flags, IConsole::FCommandCallback pfnFunc, void *pUser)
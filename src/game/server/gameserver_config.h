@@ -2,6 +2,7 @@
 #define GAMESERVER_CONFIG
 
 #include <engine/console.h>
+#include <engine/shared/cmdtable.h>
 #include <engine/shared/config.h>
 
 class CGameServerConfig
@@ -11,6 +12,7 @@ class CGameServerConfig
 	CConfiguration m_Config;
 	
 	class CConfigCommand *m_pFirstCommand;
+	CCommandTable m_CommandTable;
 
 	class IStorage *m_pStorage;
 	
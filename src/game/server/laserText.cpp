@@ -489,8 +489,10 @@ void CLaserText::Snap(int SnappingClient)
 	if(NetworkClipped(SnappingClient))
 		return;
 	
+	// score popups are the first thing to go when a snapshot gets too big
+	int Cost = GameServer()->SnapCost(SnappingClient, m_Pos, CGameContext::SNAPCOST_DECORATION);
 	for(int i = 0; i < m_CharNum; ++i){
-		CNetObj_Laser *pObj = static_cast<CNetObj_Laser *>(Server()->SnapNewItem(NETOBJTYPE_LASER, m_Chars[i]->getID(), sizeof(CNetObj_Laser)));
+		CNetObj_Laser *pObj = static_cast<CNetObj_Laser *>(Server()->SnapNewItem(NETOBJTYPE_LASER, m_Chars[i]->getID(), sizeof(CNetObj_Laser), Cost));
 		if(!pObj)
 			return;
 
@@ -17,6 +17,7 @@ CPlayer::CPlayer(CGameContext *pGameServer, int ClientID, int Team)
 	m_pCharacter = 0;
 	m_ClientID = ClientID;
 	m_Team = GameServer()->m_pController->ClampTeam(Team);
+	Server()->ExpireServerInfo();
 	m_SpectatorID = SPEC_FREEVIEW;
 	m_LastActionTick = Server()->Tick();
 	m_TeamChangeTick = Server()->Tick();
@@ -38,6 +39,8 @@ CPlayer::CPlayer(CGameContext *pGameServer, int ClientID, int Team)
 	vec2 m_LastViewPos;
     vec2 m_ViewVel;
 
+	m_SnapSerial = -1;
+
 	memset(m_SnappingClients, -1, sizeof(m_SnappingClients));
 	m_SnappingClients[0].id = ClientID;
 	m_SnappingClients[0].distance = 0;
@@ -60,8 +63,10 @@ CPlayer::CPlayer(CGameContext *pGameServer, int ClientID, int Team)
 
 CPlayer::~CPlayer()
 {
+	GameServer()->m_Timers.Cancel(m_MultiEndTimer);
 	delete m_pCharacter;
 	m_pCharacter = 0;
+	Server()->ExpireServerInfo();
 }
 
 void CPlayer::Tick()
@@ -202,27 +207,15 @@ void CPlayer::Snap(int SnappingClient)
 	int ClientID = m_ClientID;
 	if (SnappingClient > -1 && GameServer()->m_apPlayers[SnappingClient] && !GameServer()->m_apPlayers[SnappingClient]->IsSnappingClient(GetCID(), GameServer()->m_apPlayers[SnappingClient]->m_ClientVersion, ClientID)) return;
 
+	if(m_SnapSerial != GameServer()->m_SnapSerial)
+		UpdateSnapItems();
+
 	CNetObj_ClientInfo *pClientInfo = static_cast<CNetObj_ClientInfo *>(Server()->SnapNewItem(NETOBJTYPE_CLIENTINFO, ClientID, sizeof(CNetObj_ClientInfo)));
 	if(!pClientInfo)
 		return;
 
-	StrToInts(&pClientInfo->m_Name0, 4, Server()->ClientName(m_ClientID));
-	StrToInts(&pClientInfo->m_Clan0, 3, Server()->ClientClan(m_ClientID));
-	pClientInfo->m_Country = Server()->ClientCountry(m_ClientID);
-	if(GameServer()->m_pController->UseFakeTeams() && m_pCharacter && m_pCharacter->IsFrozen()){
-		StrToInts(&pClientInfo->m_Skin0, 6, "pinky");
-		pClientInfo->m_UseCustomColor = m_TeeInfos.m_UseCustomColor;
-		pClientInfo->m_ColorBody = 0;
-		pClientInfo->m_ColorFeet = m_TeeInfos.m_ColorFeet;
-	} 
-	else 
-	{
-		StrToInts(&pClientInfo->m_Skin0, 6, m_TeeInfos.m_SkinName);
-		pClientInfo->m_UseCustomColor = m_TeeInfos.m_UseCustomColor;
-		pClientInfo->m_ColorBody = m_TeeInfos.m_ColorBody;
-		pClientInfo->m_ColorFeet = m_TeeInfos.m_ColorFeet;
-	}
-	
+	mem_copy(pClientInfo, &m_SnapClientInfo, sizeof(CNetObj_ClientInfo));
+
 	CNetObj_PlayerInfo *pPlayerInfo = static_cast<CNetObj_PlayerInfo *>(Server()->SnapNewItem(NETOBJTYPE_PLAYERINFO, ClientID, sizeof(CNetObj_PlayerInfo)));
 	if(!pPlayerInfo)
 		return;
@@ -230,8 +223,8 @@ void CPlayer::Snap(int SnappingClient)
 	pPlayerInfo->m_Latency = SnappingClient == -1 ? m_Latency.m_Min : GameServer()->m_apPlayers[SnappingClient]->m_aActLatency[m_ClientID];
 	pPlayerInfo->m_Local = 0;
 	pPlayerInfo->m_ClientID = ClientID;
-	pPlayerInfo->m_Score = m_Score + ((GameServer()->m_pController->UseFakeTeams() && !GameServer()->m_pController->IsGameOver()) ? (GetTeam() * 10000) : 0);
-	pPlayerInfo->m_Team = (!GameServer()->m_pController->UseFakeTeams() || m_Team == TEAM_SPECTATORS) ? m_Team : 0;
+	pPlayerInfo->m_Score = m_SnapScore;
+	pPlayerInfo->m_Team = m_SnapTeam;
 
 	if(m_ClientID == SnappingClient)
 		pPlayerInfo->m_Local = 1;
@@ -250,6 +243,32 @@ void CPlayer::Snap(int SnappingClient)
 	}
 }
 
+void CPlayer::UpdateSnapItems()
+{
+	m_SnapSerial = GameServer()->m_SnapSerial;
+
+	CNetObj_ClientInfo *pClientInfo = &m_SnapClientInfo;
+	StrToInts(&pClientInfo->m_Name0, 4, Server()->ClientName(m_ClientID));
+	StrToInts(&pClientInfo->m_Clan0, 3, Server()->ClientClan(m_ClientID));
+	pClientInfo->m_Country = Server()->ClientCountry(m_ClientID);
+	if(GameServer()->m_pController->UseFakeTeams() && m_pCharacter && m_pCharacter->IsFrozen()){
+		StrToInts(&pClientInfo->m_Skin0, 6, "pinky");
+		pClientInfo->m_UseCustomColor = m_TeeInfos.m_UseCustomColor;
+		pClientInfo->m_ColorBody = 0;
+		pClientInfo->m_ColorFeet = m_TeeInfos.m_ColorFeet;
+	} 
+	else 
+	{
+		StrToInts(&pClientInfo->m_Skin0, 6, m_TeeInfos.m_SkinName);
+		pClientInfo->m_UseCustomColor = m_TeeInfos.m_UseCustomColor;
+		pClientInfo->m_ColorBody = m_TeeInfos.m_ColorBody;
+		pClientInfo->m_ColorFeet = m_TeeInfos.m_ColorFeet;
+	}
+
+	m_SnapScore = m_Score + ((GameServer()->m_pController->UseFakeTeams() && !GameServer()->m_pController->IsGameOver()) ? (GetTeam() * 10000) : 0);
+	m_SnapTeam = (!GameServer()->m_pController->UseFakeTeams() || m_Team == TEAM_SPECTATORS) ? m_Team : 0;
+}
+
 void CPlayer::OnDisconnect(const char *pReason)
 {
     GameServer()->SavePlayerStatsToFile(this);
@@ -387,6 +406,7 @@ void CPlayer::SetTeam(int Team, bool DoChatMsg)
 	m_Team = Team;
 	m_LastActionTick = Server()->Tick();
 	m_SpectatorID = SPEC_FREEVIEW;
+	Server()->ExpireServerInfo();
 	// we got to wait 0.5 secs before respawning
 	m_RespawnTick = Server()->Tick()+Server()->TickSpeed()/2;
 	str_format(aBuf, sizeof(aBuf), "team_join player='%d:%s' m_Team=%d", m_ClientID, Server()->ClientName(m_ClientID), m_Team);
@@ -415,6 +435,7 @@ void CPlayer::SetTeamSilent(int Team)
 	m_Team = Team;
 	m_LastActionTick = Server()->Tick();
 	m_SpectatorID = SPEC_FREEVIEW;
+	Server()->ExpireServerInfo();
 
 	GameServer()->m_pController->OnPlayerInfoChange(GameServer()->m_apPlayers[m_ClientID]);
 
@@ -195,6 +195,7 @@ public:
     int m_LastKillTick = -1;   // tick when last kill occurred
     int m_MaxMulti = 0;        // highest multi during round
     int m_MultiEndAnnounceTick = -1; // future tick to announce "multi ended"
+    int m_MultiEndTimer = CTimerWheel::INVALID_TIMER;
     int m_CurrentSpree = 0;
     int m_MaxSpree = 0;
     int m_Steals = 0;
@@ -249,6 +250,13 @@ private:
 	CGameContext *GameServer() const { return m_pGameServer; }
 	IServer *Server() const;
 
+	// the parts of the snap items that are the same for every viewer
+	int m_SnapSerial;
+	CNetObj_ClientInfo m_SnapClientInfo;
+	int m_SnapScore;
+	int m_SnapTeam;
+	void UpdateSnapItems();
+
 	//
 	bool m_Spawning;
 	int m_ClientID;
@@ -1,7 +0,0 @@
-#pragma once
-
-static const char* g_aSlurs[] = {
-    "example"
-};
-
-static constexpr int g_NumSlurs = sizeof(g_aSlurs) / sizeof(g_aSlurs[0]);
\ No newline at end of file
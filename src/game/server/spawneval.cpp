@@ -0,0 +1,209 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <game/collision.h>
+
+#include "entities/character.h"
+#include "gameworld.h"
+#include "player.h"
+#include "spawneval.h"
+
+// start, left, up, right, down
+static const vec2 s_aProbes[CSpawnEvaluator::NUM_PROBES] = { vec2(0.0f, 0.0f), vec2(-32.0f, 0.0f), vec2(0.0f, -32.0f), vec2(32.0f, 0.0f), vec2(0.0f, 32.0f) };
+
+// characters closer than this (plus their radius) can block the probes of a spawn point
+static const float s_NearRadius = 64.0f;
+
+CSpawnEvaluator::CSpawnEvaluator(CGameWorld *pWorld, CCollision *pCollision)
+{
+	m_pWorld = pWorld;
+	m_pCollision = pCollision;
+	for(int i = 0; i < NUM_TYPES; i++)
+		m_aNumPoints[i] = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		m_aChars[i].m_pChr = 0;
+		m_aChars[i].m_Team = TEAM_SPECTATORS;
+	}
+	m_NumOrder = 0;
+	m_Valid = false;
+
+	m_NumQueries = 0;
+	m_NumUpdates = 0;
+	m_UpdateTime = 0;
+}
+
+void CSpawnEvaluator::AddPoint(int Type, vec2 Pos)
+{
+	if(m_aNumPoints[Type] >= MAX_POINTS)
+		return;
+
+	CPoint *pPoint = &m_aaPoints[Type][m_aNumPoints[Type]++];
+	pPoint->m_Pos = Pos;
+	pPoint->m_SolidProbes = 0;
+	pPoint->m_Probe = -1;
+	for(int c = 0; c < MAX_CLIENTS; c++)
+		pPoint->m_aNear[c] = false;
+	for(int i = 0; i < NUM_PROBES; i++)
+		if(m_pCollision->CheckPoint(Pos+s_aProbes[i]))
+			pPoint->m_SolidProbes |= 1<<i;
+	m_Valid = false;
+}
+
+int CSpawnEvaluator::FindProbe(const CPoint *pPoint) const
+{
+	// without characters close by the spawn point itself is taken, even inside walls
+	bool Near = false;
+	for(int c = 0; c < MAX_CLIENTS; c++)
+		Near |= pPoint->m_aNear[c];
+	if(!Near)
+		return 0;
+
+	for(int i = 0; i < NUM_PROBES; i++)
+	{
+		if(pPoint->m_SolidProbes&(1<<i))
+			continue;
+
+		vec2 Pos = pPoint->m_Pos+s_aProbes[i];
+		bool Free = true;
+		for(int c = 0; c < MAX_CLIENTS && Free; c++)
+			if(pPoint->m_aNear[c] && distance(m_aChars[c].m_Pos, Pos) <= m_aChars[c].m_Radius)
+				Free = false;
+		if(Free)
+			return i;
+	}
+	return -1;
+}
+
+void CSpawnEvaluator::UpdatePoint(CPoint *pPoint, const bool *pDirty)
+{
+	bool Reprobe = !m_Valid;
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		if(!pDirty[c])
+			continue;
+		const CChar *pChar = &m_aChars[c];
+		bool Near = pChar->m_pChr && distance(pChar->m_Pos, pPoint->m_Pos) < s_NearRadius+pChar->m_Radius;
+		if(Near || pPoint->m_aNear[c])
+			Reprobe = true;
+		pPoint->m_aNear[c] = Near;
+	}
+
+	bool AllDirty = !m_Valid;
+	if(Reprobe)
+	{
+		int Probe = FindProbe(pPoint);
+		if(Probe != pPoint->m_Probe)
+			AllDirty = true;
+		pPoint->m_Probe = Probe;
+	}
+	if(pPoint->m_Probe == -1)
+		return;
+
+	vec2 Pos = pPoint->m_Pos+s_aProbes[pPoint->m_Probe];
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		if(!m_aChars[c].m_pChr || !(AllDirty || pDirty[c]))
+			continue;
+		float d = distance(Pos, m_aChars[c].m_Pos);
+		pPoint->m_aDanger[c] = d == 0 ? 1000000000.0f : 1.0f/d;
+	}
+
+	// team mates are not as dangerous as enemies
+	for(int t = 0; t < 3; t++)
+	{
+		float Score = 0.0f;
+		for(int i = 0; i < m_NumOrder; i++)
+		{
+			int c = m_aOrder[i];
+			float Scoremod = t > 0 && m_aChars[c].m_Team == t-1 ? 0.5f : 1.0f;
+			Score += Scoremod * pPoint->m_aDanger[c];
+		}
+		pPoint->m_aScore[t] = Score;
+	}
+}
+
+void CSpawnEvaluator::Update()
+{
+	m_NumQueries++;
+
+	bool aSeen[MAX_CLIENTS] = {false};
+	bool aDirty[MAX_CLIENTS] = {false};
+	bool Changed = !m_Valid;
+	int NumOrder = 0;
+
+	for(CCharacter *pChr = (CCharacter *)m_pWorld->FindFirst(CGameWorld::ENTTYPE_CHARACTER); pChr; pChr = (CCharacter *)pChr->TypeNext())
+	{
+		int ClientID = pChr->GetPlayer()->GetCID();
+		CChar *pChar = &m_aChars[ClientID];
+		aSeen[ClientID] = true;
+		if(!m_Valid || pChar->m_pChr != pChr || pChar->m_Pos.x != pChr->m_Pos.x || pChar->m_Pos.y != pChr->m_Pos.y)
+		{
+			pChar->m_pChr = pChr;
+			pChar->m_Pos = pChr->m_Pos;
+			pChar->m_Radius = pChr->m_ProximityRadius;
+			aDirty[ClientID] = true;
+			Changed = true;
+		}
+
+		int Team = pChr->GetPlayer()->GetTeam();
+		if(pChar->m_Team != Team || NumOrder >= m_NumOrder || m_aOrder[NumOrder] != ClientID)
+			Changed = true;
+		pChar->m_Team = Team;
+		m_aOrder[NumOrder++] = ClientID;
+	}
+
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		if(m_aChars[c].m_pChr && !aSeen[c])
+		{
+			m_aChars[c].m_pChr = 0;
+			aDirty[c] = true;
+			Changed = true;
+		}
+	}
+
+	if(!m_Valid)
+	{
+		for(int c = 0; c < MAX_CLIENTS; c++)
+			aDirty[c] = true;
+	}
+
+	if(NumOrder != m_NumOrder)
+		Changed = true;
+	m_NumOrder = NumOrder;
+	if(!Changed)
+		return;
+
+	int64 StartTime = time_get();
+	for(int t = 0; t < NUM_TYPES; t++)
+		for(int i = 0; i < m_aNumPoints[t]; i++)
+			UpdatePoint(&m_aaPoints[t][i], aDirty);
+	m_Valid = true;
+
+	m_NumUpdates++;
+	m_UpdateTime += time_get()-StartTime;
+}
+
+bool CSpawnEvaluator::GetPoint(int Type, int Index, int FriendlyTeam, vec2 *pPos, float *pScore) const
+{
+	const CPoint *pPoint = &m_aaPoints[Type][Index];
+	if(pPoint->m_Probe == -1)
+		return false;
+
+	*pPos = pPoint->m_Pos+s_aProbes[pPoint->m_Probe];
+	*pScore = pPoint->m_aScore[clamp(FriendlyTeam, -1, 1)+1];
+	return true;
+}
+
+void CSpawnEvaluator::TakeStats(int *pNumQueries, int *pNumUpdates, int64 *pUpdateTime)
+{
+	*pNumQueries = m_NumQueries;
+	*pNumUpdates = m_NumUpdates;
+	*pUpdateTime = m_UpdateTime;
+	m_NumQueries = 0;
+	m_NumUpdates = 0;
+	m_UpdateTime = 0;
+}
@@ -0,0 +1,78 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef GAME_SERVER_SPAWNEVAL_H
+#define GAME_SERVER_SPAWNEVAL_H
+
+#include <base/vmath.h>
+#include <engine/shared/protocol.h>
+
+/*
+	Danger field over the spawn points of a map. Every spawn point keeps
+	its first free probe position and the danger each character adds
+	there. Update() only recomputes what the characters that moved,
+	spawned or left since the last call touched, so all respawns of a
+	tick share one evaluation. Scores are summed in world order, the same
+	way a fresh evaluation would do it.
+*/
+class CSpawnEvaluator
+{
+public:
+	enum
+	{
+		NUM_TYPES=3,
+		MAX_POINTS=64,
+		NUM_PROBES=5,
+	};
+
+private:
+	struct CChar
+	{
+		const class CCharacter *m_pChr; // 0 if the client has no character
+		vec2 m_Pos;
+		float m_Radius;
+		int m_Team;
+	};
+
+	struct CPoint
+	{
+		vec2 m_Pos;
+		int m_SolidProbes; // one bit per probe
+		int m_Probe; // first free probe, -1 if every probe is taken
+		bool m_aNear[MAX_CLIENTS];
+		float m_aDanger[MAX_CLIENTS];
+		float m_aScore[3]; // indexed by friendly team+1
+	};
+
+	class CGameWorld *m_pWorld;
+	class CCollision *m_pCollision;
+
+	CPoint m_aaPoints[NUM_TYPES][MAX_POINTS];
+	int m_aNumPoints[NUM_TYPES];
+
+	CChar m_aChars[MAX_CLIENTS];
+	int m_aOrder[MAX_CLIENTS];
+	int m_NumOrder;
+	bool m_Valid;
+
+	int m_NumQueries;
+	int m_NumUpdates;
+	int64 m_UpdateTime;
+
+	int FindProbe(const CPoint *pPoint) const;
+	void UpdatePoint(CPoint *pPoint, const bool *pDirty);
+
+public:
+	CSpawnEvaluator(class CGameWorld *pWorld, class CCollision *pCollision);
+
+	void AddPoint(int Type, vec2 Pos);
+	void Update();
+
+	int NumPoints(int Type) const { return m_aNumPoints[Type]; }
+	// returns false if every probe around the point is taken
+	bool GetPoint(int Type, int Index, int FriendlyTeam, vec2 *pPos, float *pScore) const;
+
+	// returns the queries and updates since the last call and the time spent updating
+	void TakeStats(int *pNumQueries, int *pNumUpdates, int64 *pUpdateTime);
+};
+
+#endif
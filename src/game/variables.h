@@ -87,6 +87,8 @@ MACRO_CONFIG_INT(SvVoteSpectateRejoindelay, sv_vote_spectate_rejoindelay, 3, 0,
 MACRO_CONFIG_INT(SvVoteKick, sv_vote_kick, 1, 0, 1, CFGFLAG_SERVER, "Allow voting to kick players")
 MACRO_CONFIG_INT(SvVoteKickMin, sv_vote_kick_min, 0, 0, MAX_CLIENTS, CFGFLAG_SERVER, "Minimum number of players required to start a kick vote")
 MACRO_CONFIG_INT(SvVoteKickBantime, sv_vote_kick_bantime, 5, 0, 1440, CFGFLAG_SERVER, "The time to ban a player if kicked by vote. 0 makes it just use kick")
+MACRO_CONFIG_INT(SvPenaltyPrefixV6, sv_penalty_prefix_v6, 128, 16, 128, CFGFLAG_SERVER, "Mutes and frozen leaver blocks cover all IPv6 addresses sharing this many leading bits (applies on reload)")
+MACRO_CONFIG_STR(SvChatFilter, sv_chat_filter, 128, "", CFGFLAG_SERVER, "File with one word per line, chat messages containing one count as a toxicity strike")
 
 #include "variables_special.h"
 
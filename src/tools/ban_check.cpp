@@ -0,0 +1,174 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/shared/config.h>
+#include <engine/shared/netban.h>
+
+// bans and unbans random addresses and ranges and checks that the trie
+// finds the same bans as the hash lookup it replaced and a plain scan
+
+static unsigned s_Random = 1;
+
+static unsigned Random()
+{
+	s_Random ^= s_Random<<13;
+	s_Random ^= s_Random>>17;
+	s_Random ^= s_Random<<5;
+	return s_Random;
+}
+
+class CBanCheck : public CNetBan
+{
+	// the lookup before the trie
+	static int MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17])
+	{
+		int Length = pAddr->type == NETTYPE_IPV4 ? 4 : 16;
+		aHash[0].m_Hash = 0;
+		aHash[0].m_HashIndex = 0;
+		for(int i = 1, Sum = 0; i <= Length; ++i)
+		{
+			Sum += pAddr->ip[i - 1];
+			aHash[i].m_Hash = Sum & 0xFF;
+			aHash[i].m_HashIndex = i % Length;
+		}
+		return Length;
+	}
+
+public:
+	bool IsBannedByHash(const NETADDR *pAddr) const
+	{
+		CNetHash aHash[17];
+		int Length = MakeHashArray(pAddr, aHash);
+
+		if(m_BanAddrPool.Find(pAddr, &aHash[Length]))
+			return true;
+
+		for(int i = Length - 1; i >= 0; --i)
+			for(CBanRange *pBan = m_BanRangePool.First(&aHash[i]); pBan; pBan = pBan->m_pHashNext)
+				if(NetMatch(&pBan->m_Data, pAddr, i, Length))
+					return true;
+		return false;
+	}
+
+	bool IsBannedByScan(const NETADDR *pAddr) const
+	{
+		for(CBanAddr *pBan = m_BanAddrPool.First(); pBan; pBan = pBan->m_pNext)
+			if(NetMatch(&pBan->m_Data, pAddr))
+				return true;
+		for(CBanRange *pBan = m_BanRangePool.First(); pBan; pBan = pBan->m_pNext)
+			if(NetMatch(&pBan->m_Data, pAddr))
+				return true;
+		return false;
+	}
+
+	// the ban the trie reports has to cover the address
+	bool TrieBanCovers(const NETADDR *pAddr) const
+	{
+		CBanAddr *pAddrBan;
+		CBanRange *pRangeBan;
+		if(!m_BanTrie.Find(pAddr, &pAddrBan, &pRangeBan))
+			return true;
+		return pAddrBan ? NetMatch(&pAddrBan->m_Data, pAddr) : NetMatch(&pRangeBan->m_Data, pAddr);
+	}
+
+	int NumBans() const { return m_BanAddrPool.Num()+m_BanRangePool.Num(); }
+};
+
+// addresses from a few small blocks so that bans overlap a lot
+static void RandomAddr(NETADDR *pAddr, int Type)
+{
+	mem_zero(pAddr, sizeof(*pAddr));
+	pAddr->type = Type;
+	int Length = Type == NETTYPE_IPV4 ? 4 : 16;
+	pAddr->ip[0] = Type == NETTYPE_IPV4 ? 10 : 0x20;
+	for(int i = 1; i < Length; i++)
+		pAddr->ip[i] = i < Length-2 ? Random()%3 : Random()%256;
+}
+
+static void RandomRange(CNetRange *pRange, int Type)
+{
+	do
+	{
+		RandomAddr(&pRange->m_LB, Type);
+		pRange->m_UB = pRange->m_LB;
+		// mostly narrow, sometimes sharing only a few leading bytes
+		int Length = Type == NETTYPE_IPV4 ? 4 : 16;
+		int Shared = Random()%8 ? Length-1-Random()%2 : 1+Random()%(Length-1);
+		for(int i = Shared; i < Length; i++)
+			pRange->m_UB.ip[i] = i < Length-2 ? Random()%3 : Random()%256;
+		if(NetComp(&pRange->m_UB, &pRange->m_LB) < 0)
+		{
+			NETADDR Temp = pRange->m_LB;
+			pRange->m_LB = pRange->m_UB;
+			pRange->m_UB = Temp;
+		}
+	}
+	while(!pRange->IsValid());
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	static CBanCheck s_Bans;
+	s_Bans.Init(pConsole, 0);
+
+	int Rounds = argc > 1 ? str_toint(argv[1]) : 200; // ignore_convention
+	int Failed = 0;
+	int NumChecks = 0, NumBanned = 0;
+	for(int r = 0; r < Rounds; r++)
+	{
+		int Type = r%2 ? NETTYPE_IPV6 : NETTYPE_IPV4;
+
+		// change the ban list a bit
+		for(int i = 0; i < 20; i++)
+		{
+			NETADDR Addr;
+			CNetRange Range;
+			switch(Random()%4)
+			{
+			case 0: RandomAddr(&Addr, Type); s_Bans.BanAddr(&Addr, 0, "check"); break;
+			case 1: RandomRange(&Range, Type); s_Bans.BanRange(&Range, 0, "check"); break;
+			case 2: RandomAddr(&Addr, Type); s_Bans.UnbanByAddr(&Addr); break;
+			case 3:
+				if(s_Bans.NumBans())
+					s_Bans.UnbanByIndex(Random()%s_Bans.NumBans());
+				break;
+			}
+		}
+		if(Random()%50 == 0)
+			while(s_Bans.NumBans())
+				s_Bans.UnbanByIndex(0);
+
+		for(int i = 0; i < 500; i++)
+		{
+			NETADDR Addr;
+			RandomAddr(&Addr, Random()%8 ? Type : NETTYPE_IPV4+NETTYPE_IPV6-Type);
+			char aBuf[256];
+			bool Trie = s_Bans.IsBanned(&Addr, aBuf, sizeof(aBuf));
+			bool Hash = s_Bans.IsBannedByHash(&Addr);
+			bool Scan = s_Bans.IsBannedByScan(&Addr);
+			NumChecks++;
+			NumBanned += Trie;
+			if(Trie != Hash || Trie != Scan || !s_Bans.TrieBanCovers(&Addr))
+			{
+				char aAddr[NETADDR_MAXSTRSIZE];
+				net_addr_str(&Addr, aAddr, sizeof(aAddr), false);
+				if(Failed < 20)
+					dbg_msg("ban_check", "mismatch for %s: trie=%d hash=%d scan=%d", aAddr, Trie, Hash, Scan);
+				Failed++;
+			}
+		}
+	}
+
+	delete pConsole;
+	if(Failed)
+	{
+		dbg_msg("ban_check", "%d of %d lookups differ", Failed, NumChecks);
+		return 1;
+	}
+	dbg_msg("ban_check", "%d lookups, %d banned, all matched", NumChecks, NumBanned);
+	return 0;
+}
@@ -0,0 +1,260 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/shared/compression.h>
+#include <engine/shared/network.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/snapshot.h>
+
+// times CVariableInt::Compress and Decompress on snapshot deltas against
+// packing them one int at a time, and checks that the bytes and ints match.
+// the deltas are taken from dbg_lognetwork dumps of the server
+
+enum
+{
+	MAX_DELTAS=1<<16,
+	MAX_DATA=64<<20,
+};
+
+static int *s_pInts; // all deltas after each other
+static int s_aDeltaStart[MAX_DELTAS+1];
+static int s_NumDeltas = 0;
+static int s_NumInts = 0;
+static unsigned s_Random = 1;
+
+static unsigned Random()
+{
+	s_Random ^= s_Random<<13;
+	s_Random ^= s_Random>>17;
+	s_Random ^= s_Random<<5;
+	return s_Random;
+}
+
+static void AddDelta(const int *pInts, int Num)
+{
+	if(s_NumDeltas == MAX_DELTAS || s_NumInts+Num > MAX_DATA/(int)sizeof(int))
+		return;
+	mem_copy(&s_pInts[s_NumInts], pInts, Num*sizeof(int));
+	s_aDeltaStart[s_NumDeltas++] = s_NumInts;
+	s_NumInts += Num;
+	s_aDeltaStart[s_NumDeltas] = s_NumInts;
+}
+
+// the compressed delta of a whole snapshot, its parts are sent in order
+static unsigned char s_aSnapData[CSnapshot::MAX_SIZE];
+static int s_SnapSize = 0;
+static int s_SnapNextPart = 0;
+
+static void AddSnapPart(int Part, int NumParts, const unsigned char *pData, int Size)
+{
+	if(Part != s_SnapNextPart || Size < 0 || s_SnapSize+Size > (int)sizeof(s_aSnapData))
+	{
+		s_SnapSize = 0;
+		s_SnapNextPart = 0;
+		if(Part != 0)
+			return;
+	}
+	mem_copy(&s_aSnapData[s_SnapSize], pData, Size);
+	s_SnapSize += Size;
+	s_SnapNextPart++;
+	if(s_SnapNextPart < NumParts)
+		return;
+
+	static int s_aInts[CSnapshot::MAX_SIZE];
+	const unsigned char *pSrc = s_aSnapData;
+	const unsigned char *pEnd = s_aSnapData+s_SnapSize;
+	int Num = 0;
+	while(pSrc < pEnd && Num < CSnapshot::MAX_SIZE)
+		pSrc = CVariableInt::Unpack(pSrc, &s_aInts[Num++]);
+	if(pSrc == pEnd)
+		AddDelta(s_aInts, Num);
+	s_SnapSize = 0;
+	s_SnapNextPart = 0;
+}
+
+// the snapshot messages of the chunks of one packet
+static void AddPacket(unsigned char *pData, int Size)
+{
+	unsigned char *pEnd = pData+Size;
+	while(pEnd-pData >= 2)
+	{
+		CNetChunkHeader Header;
+		unsigned char *pChunk = Header.Unpack(pData);
+		if(Header.m_Size <= 0 || Header.m_Size > pEnd-pChunk)
+			return;
+		pData = pChunk+Header.m_Size;
+
+		CUnpacker Unpacker;
+		Unpacker.Reset(pChunk, Header.m_Size);
+		int Msg = Unpacker.GetInt();
+		if(!(Msg&1))
+			continue;
+		Msg >>= 1;
+		if(Msg != NETMSG_SNAP && Msg != NETMSG_SNAPSINGLE)
+			continue;
+
+		Unpacker.GetInt(); // tick
+		Unpacker.GetInt(); // delta tick
+		int NumParts = 1, Part = 0;
+		if(Msg == NETMSG_SNAP)
+		{
+			NumParts = Unpacker.GetInt();
+			Part = Unpacker.GetInt();
+		}
+		Unpacker.GetInt(); // crc
+		int PartSize = Unpacker.GetInt();
+		const unsigned char *pPart = (const unsigned char *)Unpacker.GetRaw(PartSize);
+		if(!Unpacker.Error() && NumParts > 0 && Part < NumParts)
+			AddSnapPart(Part, NumParts, pPart, PartSize);
+	}
+}
+
+// records of a dbg_lognetwork dump, type 1 is the chunk data before compression
+static bool ReadDump(const char *pFilename)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		dbg_msg("compression_bench", "failed to open '%s'", pFilename);
+		return false;
+	}
+
+	int Type, Size;
+	unsigned char aData[NET_MAX_PACKETSIZE];
+	while(io_read(File, &Type, sizeof(Type)) == sizeof(Type) && io_read(File, &Size, sizeof(Size)) == sizeof(Size))
+	{
+		if(Size < 0 || Size > (int)sizeof(aData) || io_read(File, aData, Size) != (unsigned)Size)
+			break;
+		if(Type == 1)
+			AddPacket(aData, Size);
+	}
+	io_close(File);
+	return true;
+}
+
+// without a dump: mostly small ints with some large ones in between
+static void AddRandomDeltas(int Num)
+{
+	static int s_aInts[2048];
+	for(int d = 0; d < Num; d++)
+	{
+		int Size = 1+Random()%2048;
+		for(int i = 0; i < Size; i++)
+			s_aInts[i] = Random()%5 ? (int)(Random()%128)-64 : (int)Random()>>(Random()%31);
+		AddDelta(s_aInts, Size);
+	}
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	s_pInts = (int *)mem_alloc(MAX_DATA, 1);
+	unsigned char *pPacked = (unsigned char *)mem_alloc(MAX_DATA/4*5, 1);
+	unsigned char *pReference = (unsigned char *)mem_alloc(MAX_DATA/4*5, 1);
+	int *pUnpacked = (int *)mem_alloc(MAX_DATA, 1);
+
+	int Rounds = argc > 1 ? max(str_toint(argv[1]), 1) : 20; // ignore_convention
+	for(int i = 2; i < argc; i++) // ignore_convention
+		if(!ReadDump(argv[i])) // ignore_convention
+			return -1;
+	if(!s_NumDeltas)
+	{
+		dbg_msg("compression_bench", "no dump given, using random deltas");
+		AddRandomDeltas(4096);
+	}
+
+	int Small = 0;
+	for(int i = 0; i < s_NumInts; i++)
+		if(s_pInts[i] >= -64 && s_pInts[i] < 64)
+			Small++;
+	dbg_msg("compression_bench", "deltas=%d ints=%d single byte=%.1f%% rounds=%d", s_NumDeltas, s_NumInts, Small*100.0/max(s_NumInts, 1), Rounds);
+
+	// check against packing one int at a time
+	int Result = 0;
+	long PackedSize = 0;
+	int aOffsets[MAX_DELTAS+1];
+	for(int d = 0; d < s_NumDeltas; d++)
+	{
+		const int *pInts = &s_pInts[s_aDeltaStart[d]];
+		int Num = s_aDeltaStart[d+1]-s_aDeltaStart[d];
+
+		unsigned char *pRef = pReference+PackedSize;
+		unsigned char *pRefEnd = pRef;
+		for(int i = 0; i < Num; i++)
+			pRefEnd = CVariableInt::Pack(pRefEnd, pInts[i]);
+
+		long Size = CVariableInt::Compress(pInts, Num*sizeof(int), pPacked+PackedSize);
+		if(Size != pRefEnd-pRef || mem_comp(pPacked+PackedSize, pRef, Size) != 0)
+		{
+			dbg_msg("compression_bench", "delta %d packs to different bytes", d);
+			Result = 1;
+		}
+
+		long IntSize = CVariableInt::Decompress(pRef, pRefEnd-pRef, pUnpacked);
+		if(IntSize != Num*(long)sizeof(int) || mem_comp(pUnpacked, pInts, IntSize) != 0)
+		{
+			dbg_msg("compression_bench", "delta %d unpacks to different ints", d);
+			Result = 1;
+		}
+
+		aOffsets[d] = PackedSize;
+		PackedSize += pRefEnd-pRef;
+	}
+	aOffsets[s_NumDeltas] = PackedSize;
+
+	// time both ways on the same deltas
+	int64 aTime[4] = {0};
+	for(int r = 0; r < Rounds; r++)
+	{
+		int64 Start = time_get();
+		for(int d = 0; d < s_NumDeltas; d++)
+		{
+			const int *pInts = &s_pInts[s_aDeltaStart[d]];
+			const int *pEnd = &s_pInts[s_aDeltaStart[d+1]];
+			unsigned char *pDst = pReference+aOffsets[d];
+			while(pInts < pEnd)
+				pDst = CVariableInt::Pack(pDst, *pInts++);
+		}
+		aTime[0] += time_get()-Start;
+
+		Start = time_get();
+		for(int d = 0; d < s_NumDeltas; d++)
+			CVariableInt::Compress(&s_pInts[s_aDeltaStart[d]], (s_aDeltaStart[d+1]-s_aDeltaStart[d])*sizeof(int), pPacked+aOffsets[d]);
+		aTime[1] += time_get()-Start;
+
+		Start = time_get();
+		for(int d = 0; d < s_NumDeltas; d++)
+		{
+			const unsigned char *pSrc = pReference+aOffsets[d];
+			const unsigned char *pEnd = pReference+aOffsets[d+1];
+			int *pDst = &pUnpacked[s_aDeltaStart[d]];
+			while(pSrc < pEnd)
+				pSrc = CVariableInt::Unpack(pSrc, pDst++);
+		}
+		aTime[2] += time_get()-Start;
+
+		Start = time_get();
+		for(int d = 0; d < s_NumDeltas; d++)
+			CVariableInt::Decompress(pPacked+aOffsets[d], aOffsets[d+1]-aOffsets[d], &pUnpacked[s_aDeltaStart[d]]);
+		aTime[3] += time_get()-Start;
+	}
+
+	double Bytes = (double)s_NumInts*sizeof(int)*Rounds;
+	for(int i = 0; i < 4; i++)
+		aTime[i] = max(aTime[i], (int64)1);
+	dbg_msg("compression_bench", "compress: per int %.1f MB/s, bulk %.1f MB/s, %.2fx",
+		Bytes/1e6/((double)aTime[0]/time_freq()), Bytes/1e6/((double)aTime[1]/time_freq()), (double)aTime[0]/aTime[1]);
+	dbg_msg("compression_bench", "decompress: per int %.1f MB/s, bulk %.1f MB/s, %.2fx",
+		Bytes/1e6/((double)aTime[2]/time_freq()), Bytes/1e6/((double)aTime[3]/time_freq()), (double)aTime[2]/aTime[3]);
+
+	if(Result)
+		dbg_msg("compression_bench", "the bulk paths differ from packing one int at a time");
+	mem_free(s_pInts);
+	mem_free(pPacked);
+	mem_free(pReference);
+	mem_free(pUnpacked);
+	return Result;
+}
@@ -0,0 +1,109 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/storage.h>
+#include <engine/shared/datafile.h>
+
+// rewrites a map with different numbers of compression workers,
+// checks that they all give the same file and times them
+
+static const char *s_pOutput = "datafile_bench.map";
+
+static bool Rewrite(IStorage *pStorage, CDataFileReader *pReader, int MaxThreads)
+{
+	CDataFileWriter Writer;
+	if(!Writer.Open(pStorage, s_pOutput, MaxThreads))
+		return false;
+
+	for(int i = 0; i < pReader->NumData(); i++)
+		Writer.AddData(pReader->GetUncompressedDataSize(i), pReader->GetData(i));
+	for(int i = 0; i < pReader->NumItems(); i++)
+	{
+		int Type, ID;
+		void *pItem = pReader->GetItem(i, &Type, &ID);
+		if(Type >= 0xFFFF) // the writer can't add extended item types
+			continue;
+		Writer.AddItem(Type, ID, pReader->GetItemSize(i), pItem);
+	}
+	return Writer.Finish() == 0;
+}
+
+static bool ReadOutput(IStorage *pStorage, unsigned char **ppData, unsigned *pSize)
+{
+	IOHANDLE File = pStorage->OpenFile(s_pOutput, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if(!File)
+		return false;
+	*pSize = io_length(File);
+	*ppData = (unsigned char *)mem_alloc(max(*pSize, 1u), 1);
+	io_read(File, *ppData, *pSize);
+	io_close(File);
+	return true;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+	if(!pStorage)
+		return -1;
+
+	const char *pMap = argc > 1 ? argv[1] : "maps/fng.map"; // ignore_convention
+	int Rounds = argc > 2 ? max(str_toint(argv[2]), 1) : 20; // ignore_convention
+
+	CDataFileReader Reader;
+	if(!Reader.Open(pStorage, pMap, IStorage::TYPE_ALL))
+	{
+		dbg_msg("datafile_bench", "failed to open '%s'", pMap);
+		return -1;
+	}
+	Reader.PrefetchData(0, Reader.NumData());
+
+	unsigned char *pReference = 0;
+	unsigned ReferenceSize = 0;
+	int64 ReferenceTime = 0;
+	int Result = 0;
+	dbg_msg("datafile_bench", "map='%s' datas=%d items=%d rounds=%d processors=%d", pMap, Reader.NumData(), Reader.NumItems(), Rounds, cpu_count());
+
+	for(int Threads = 0; Threads <= 4; Threads++)
+	{
+		int64 Start = time_get();
+		for(int r = 0; r < Rounds; r++)
+		{
+			if(!Rewrite(pStorage, &Reader, Threads))
+			{
+				dbg_msg("datafile_bench", "failed to write '%s'", s_pOutput);
+				return -1;
+			}
+		}
+		int64 Time = time_get()-Start;
+
+		unsigned char *pData;
+		unsigned Size;
+		if(!ReadOutput(pStorage, &pData, &Size))
+			return -1;
+		if(!pReference)
+		{
+			pReference = pData;
+			ReferenceSize = Size;
+			ReferenceTime = Time;
+		}
+		else
+		{
+			if(Size != ReferenceSize || mem_comp(pData, pReference, Size) != 0)
+			{
+				dbg_msg("datafile_bench", "threads=%d wrote a different file", Threads);
+				Result = 1;
+			}
+			mem_free(pData);
+		}
+
+		dbg_msg("datafile_bench", "threads=%d %.3f ms per file, %.2fx", Threads,
+			Time*1000.0/time_freq()/Rounds, (double)ReferenceTime/max(Time, (int64)1));
+	}
+
+	mem_free(pReference);
+	pStorage->RemoveFile(s_pOutput, IStorage::TYPE_SAVE);
+	return Result;
+}
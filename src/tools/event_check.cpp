@@ -0,0 +1,101 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include <game/server/gamecontext.h>
+
+// checks which snapshots the events of the handler go into
+
+// the handler only needs this one to snap, which the check does not do
+int CGameContext::SnapCost(int SnappingClient, vec2 Pos, int Penalty) { return 0; }
+
+static int s_Failed = 0;
+
+static void Expect(bool Cond, const char *pWhat)
+{
+	if(!Cond)
+	{
+		dbg_msg("event_check", "failed: %s", pWhat);
+		s_Failed++;
+	}
+}
+
+static int Count(CEventHandler *pEvents, int SnappingClient, int Tick, int Window, int Type)
+{
+	static int s_aIndices[512];
+	int Num = pEvents->Pending(SnappingClient, Tick, Window, s_aIndices);
+	int Found = 0;
+	for(int i = 0; i < Num; i++)
+		if(pEvents->Type(s_aIndices[i]) == Type)
+			Found++;
+	return Found;
+}
+
+static void AddDeath(CEventHandler *pEvents, int Tick, QuadroMask Mask)
+{
+	CNetEvent_Death *pEvent = (CNetEvent_Death *)pEvents->Add(NETEVENTTYPE_DEATH, sizeof(CNetEvent_Death), Mask, Tick);
+	mem_zero(pEvent, sizeof(*pEvent));
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	static CEventHandler s_Events;
+	const int Window = 5;
+
+	// self kill between two ticks, after the client got its snapshot
+	{
+		s_Events.Clear();
+		int Tick = 100;
+		AddDeath(&s_Events, Tick, QuadroMask(-1ll));
+		Expect(Count(&s_Events, 0, Tick, Window, NETEVENTTYPE_DEATH) == 1, "event of the tick in the snapshot of the tick");
+		Expect(Count(&s_Events, -1, Tick, Window, NETEVENTTYPE_DEATH) == 1, "event of the tick in the demo");
+		Count(&s_Events, 1, Tick, Window, NETEVENTTYPE_DEATH);
+
+		// CL_KILL comes in after the snapshot, still stamped with the same tick
+		AddDeath(&s_Events, Tick, QuadroMask(-1ll));
+		s_Events.Expire(Tick-Window);
+
+		Tick++;
+		Expect(Count(&s_Events, 0, Tick, Window, NETEVENTTYPE_DEATH) == 1, "self kill reaches a client snapped on the previous tick");
+		Expect(Count(&s_Events, -1, Tick, Window, NETEVENTTYPE_DEATH) == 1, "self kill reaches the demo");
+		Expect(Count(&s_Events, 0, Tick, Window, NETEVENTTYPE_DEATH) == 0, "self kill is sent only once");
+		s_Events.Expire(Tick-Window);
+
+		// a client on the lowest snapshot rate still gets it
+		for(int i = 1; i < Window; i++)
+			s_Events.Expire(++Tick-Window);
+		Expect(Count(&s_Events, 1, Tick, Window, NETEVENTTYPE_DEATH) == 1, "self kill reaches a client on the lowest rate");
+	}
+
+	// events masked away from a client
+	{
+		s_Events.Clear();
+		int Tick = 200;
+		Count(&s_Events, 2, Tick, Window, NETEVENTTYPE_DEATH);
+		Count(&s_Events, 3, Tick, Window, NETEVENTTYPE_DEATH);
+		AddDeath(&s_Events, Tick, CmaskOne(2));
+		Tick++;
+		Expect(Count(&s_Events, 3, Tick, Window, NETEVENTTYPE_DEATH) == 0, "masked event stays away from other clients");
+		Expect(Count(&s_Events, 2, Tick, Window, NETEVENTTYPE_DEATH) == 1, "masked event reaches its client");
+	}
+
+	// events older than the window are neither sent nor kept
+	{
+		s_Events.Clear();
+		int Tick = 300;
+		AddDeath(&s_Events, Tick, QuadroMask(-1ll));
+		Tick += Window+1;
+		Expect(Count(&s_Events, 4, Tick, Window, NETEVENTTYPE_DEATH) == 0, "stale event is not sent");
+		s_Events.Expire(Tick-Window);
+		Expect(Count(&s_Events, -1, Tick-Window, Window, NETEVENTTYPE_DEATH) == 0, "stale event is expired");
+	}
+
+	if(s_Failed)
+	{
+		dbg_msg("event_check", "%d checks failed", s_Failed);
+		return 1;
+	}
+	dbg_msg("event_check", "all checks passed");
+	return 0;
+}
@@ -0,0 +1,540 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/storage.h>
+#include <engine/shared/huffman.h>
+#include <engine/shared/network.h>
+
+// fuzzes CHuffman against the codec it replaced, which is kept here as the
+// reference. the compressed bytes, the return values and the decompressed
+// output have to be identical and every stream has to round trip
+
+class CReferenceHuffman
+{
+	enum
+	{
+		HUFFMAN_EOF_SYMBOL = 256,
+
+		HUFFMAN_MAX_SYMBOLS=HUFFMAN_EOF_SYMBOL+1,
+		HUFFMAN_MAX_NODES=HUFFMAN_MAX_SYMBOLS*2-1,
+
+		HUFFMAN_LUTBITS = 10,
+		HUFFMAN_LUTSIZE = (1<<HUFFMAN_LUTBITS),
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE-1)
+	};
+
+	struct CNode
+	{
+		unsigned m_Bits;
+		unsigned m_NumBits;
+		unsigned short m_aLeafs[2];
+		unsigned char m_Symbol;
+	};
+
+	CNode m_aNodes[HUFFMAN_MAX_NODES];
+	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CNode *m_pStartNode;
+	int m_NumNodes;
+
+	void Setbits_r(CNode *pNode, int Bits, unsigned Depth);
+	void ConstructTree(const unsigned *pFrequencies);
+
+public:
+	void Init(const unsigned *pFrequencies);
+	int Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize);
+	int Decompress(const void *pInput, int InputSize, void *pOutput, int OutputSize);
+};
+
+struct CReferenceConstructNode
+{
+	unsigned short m_NodeId;
+	int m_Frequency;
+};
+
+void CReferenceHuffman::Setbits_r(CNode *pNode, int Bits, unsigned Depth)
+{
+	if(pNode->m_aLeafs[1] != 0xffff)
+		Setbits_r(&m_aNodes[pNode->m_aLeafs[1]], Bits|(1<<Depth), Depth+1);
+	if(pNode->m_aLeafs[0] != 0xffff)
+		Setbits_r(&m_aNodes[pNode->m_aLeafs[0]], Bits, Depth+1);
+
+	if(pNode->m_NumBits)
+	{
+		pNode->m_Bits = Bits;
+		pNode->m_NumBits = Depth;
+	}
+}
+
+static void ReferenceBubbleSort(CReferenceConstructNode **ppList, int Size)
+{
+	int Changed = 1;
+	CReferenceConstructNode *pTemp;
+
+	while(Changed)
+	{
+		Changed = 0;
+		for(int i = 0; i < Size-1; i++)
+		{
+			if(ppList[i]->m_Frequency < ppList[i+1]->m_Frequency)
+			{
+				pTemp = ppList[i];
+				ppList[i] = ppList[i+1];
+				ppList[i+1] = pTemp;
+				Changed = 1;
+			}
+		}
+		Size--;
+	}
+}
+
+void CReferenceHuffman::ConstructTree(const unsigned *pFrequencies)
+{
+	CReferenceConstructNode aNodesLeftStorage[HUFFMAN_MAX_SYMBOLS];
+	CReferenceConstructNode *apNodesLeft[HUFFMAN_MAX_SYMBOLS];
+	int NumNodesLeft = HUFFMAN_MAX_SYMBOLS;
+
+	// add the symbols
+	for(int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
+	{
+		m_aNodes[i].m_NumBits = 0xFFFFFFFF;
+		m_aNodes[i].m_Symbol = i;
+		m_aNodes[i].m_aLeafs[0] = 0xffff;
+		m_aNodes[i].m_aLeafs[1] = 0xffff;
+
+		if(i == HUFFMAN_EOF_SYMBOL)
+			aNodesLeftStorage[i].m_Frequency = 1;
+		else
+			aNodesLeftStorage[i].m_Frequency = pFrequencies[i];
+		aNodesLeftStorage[i].m_NodeId = i;
+		apNodesLeft[i] = &aNodesLeftStorage[i];
+
+	}
+
+	m_NumNodes = HUFFMAN_MAX_SYMBOLS;
+
+	// construct the table
+	while(NumNodesLeft > 1)
+	{
+		// we can't rely on stdlib's qsort for this, it can generate different results on different implementations
+		ReferenceBubbleSort(apNodesLeft, NumNodesLeft);
+
+		m_aNodes[m_NumNodes].m_NumBits = 0;
+		m_aNodes[m_NumNodes].m_aLeafs[0] = apNodesLeft[NumNodesLeft-1]->m_NodeId;
+		m_aNodes[m_NumNodes].m_aLeafs[1] = apNodesLeft[NumNodesLeft-2]->m_NodeId;
+		apNodesLeft[NumNodesLeft-2]->m_NodeId = m_NumNodes;
+		apNodesLeft[NumNodesLeft-2]->m_Frequency = apNodesLeft[NumNodesLeft-1]->m_Frequency + apNodesLeft[NumNodesLeft-2]->m_Frequency;
+
+		m_NumNodes++;
+		NumNodesLeft--;
+	}
+
+	// set start node
+	m_pStartNode = &m_aNodes[m_NumNodes-1];
+
+	// build symbol bits
+	Setbits_r(m_pStartNode, 0, 0);
+}
+
+void CReferenceHuffman::Init(const unsigned *pFrequencies)
+{
+	int i;
+
+	// make sure to cleanout every thing
+	mem_zero(this, sizeof(*this));
+
+	// construct the tree
+	ConstructTree(pFrequencies);
+
+	// build decode LUT
+	for(i = 0; i < HUFFMAN_LUTSIZE; i++)
+	{
+		unsigned Bits = i;
+		int k;
+		CNode *pNode = m_pStartNode;
+		for(k = 0; k < HUFFMAN_LUTBITS; k++)
+		{
+			pNode = &m_aNodes[pNode->m_aLeafs[Bits&1]];
+			Bits >>= 1;
+
+			if(!pNode)
+				break;
+
+			if(pNode->m_NumBits)
+			{
+				m_apDecodeLut[i] = pNode;
+				break;
+			}
+		}
+
+		if(k == HUFFMAN_LUTBITS)
+			m_apDecodeLut[i] = pNode;
+	}
+
+}
+
+int CReferenceHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+{
+	// this macro loads a symbol for a byte into bits and bitcount
+#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
+	Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
+	Bitcount += m_aNodes[Sym].m_NumBits;
+
+	// this macro writes the symbol stored in bits and bitcount to the dst pointer
+#define HUFFMAN_MACRO_WRITE() \
+	while(Bitcount >= 8) \
+	{ \
+		*pDst++ = (unsigned char)(Bits&0xff); \
+		if(pDst == pDstEnd) \
+			return -1; \
+		Bits >>= 8; \
+		Bitcount -= 8; \
+	}
+
+	// setup buffer pointers
+	const unsigned char *pSrc = (const unsigned char *)pInput;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
+	unsigned char *pDst = (unsigned char *)pOutput;
+	unsigned char *pDstEnd = pDst + OutputSize;
+
+	// symbol variables
+	unsigned Bits = 0;
+	unsigned Bitcount = 0;
+
+	// make sure that we have data that we want to compress
+	if(InputSize)
+	{
+		// {A} load the first symbol
+		int Symbol = *pSrc++;
+
+		while(pSrc != pSrcEnd)
+		{
+			// {B} load the symbol
+			HUFFMAN_MACRO_LOADSYMBOL(Symbol)
+
+			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
+			Symbol = *pSrc++;
+
+			// {B} write the symbol loaded at
+			HUFFMAN_MACRO_WRITE()
+		}
+
+		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
+		HUFFMAN_MACRO_LOADSYMBOL(Symbol)
+		HUFFMAN_MACRO_WRITE()
+	}
+
+	// write EOF symbol
+	HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL)
+	HUFFMAN_MACRO_WRITE()
+
+	// write out the last bits
+	*pDst++ = Bits;
+
+	// return the size of the output
+	return (int)(pDst - (const unsigned char *)pOutput);
+
+	// remove macros
+#undef HUFFMAN_MACRO_LOADSYMBOL
+#undef HUFFMAN_MACRO_WRITE
+}
+
+int CReferenceHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+{
+	// setup buffer pointers
+	unsigned char *pDst = (unsigned char *)pOutput;
+	unsigned char *pSrc = (unsigned char *)pInput;
+	unsigned char *pDstEnd = pDst + OutputSize;
+	unsigned char *pSrcEnd = pSrc + InputSize;
+
+	unsigned Bits = 0;
+	unsigned Bitcount = 0;
+
+	CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
+	CNode *pNode = 0;
+
+	while(1)
+	{
+		// {A} try to load a node now, this will reduce dependency at location {D}
+		pNode = 0;
+		if(Bitcount >= HUFFMAN_LUTBITS)
+			pNode = m_apDecodeLut[Bits&HUFFMAN_LUTMASK];
+
+		// {B} fill with new bits
+		while(Bitcount < 24 && pSrc != pSrcEnd)
+		{
+			Bits |= (*pSrc++) << Bitcount;
+			Bitcount += 8;
+		}
+
+		// {C} load symbol now if we didn't that earlier at location {A}
+		if(!pNode)
+			pNode = m_apDecodeLut[Bits&HUFFMAN_LUTMASK];
+
+		if(!pNode)
+			return -1;
+
+		// {D} check if we hit a symbol already
+		if(pNode->m_NumBits)
+		{
+			// remove the bits for that symbol
+			Bits >>= pNode->m_NumBits;
+			Bitcount -= pNode->m_NumBits;
+		}
+		else
+		{
+			// remove the bits that the lut checked up for us
+			Bits >>= HUFFMAN_LUTBITS;
+			Bitcount -= HUFFMAN_LUTBITS;
+
+			// walk the tree bit by bit
+			while(1)
+			{
+				// traverse tree
+				pNode = &m_aNodes[pNode->m_aLeafs[Bits&1]];
+
+				// remove bit
+				Bitcount--;
+				Bits >>= 1;
+
+				// check if we hit a symbol
+				if(pNode->m_NumBits)
+					break;
+
+				// no more bits, decoding error
+				if(Bitcount == 0)
+					return -1;
+			}
+		}
+
+		// check for eof
+		if(pNode == pEof)
+			break;
+
+		// output character
+		if(pDst == pDstEnd)
+			return -1;
+		*pDst++ = pNode->m_Symbol;
+	}
+
+	// return the size of the decompressed buffer
+	return (int)(pDst - (const unsigned char *)pOutput);
+}
+
+// the table of CNetBase
+static const unsigned gs_aFreqTable[256+1] = {
+	1<<30,4545,2657,431,1950,919,444,482,2244,617,838,542,715,1814,304,240,754,212,647,186,
+	283,131,146,166,543,164,167,136,179,859,363,113,157,154,204,108,137,180,202,176,
+	872,404,168,134,151,111,113,109,120,126,129,100,41,20,16,22,18,18,17,19,
+	16,37,13,21,362,166,99,78,95,88,81,70,83,284,91,187,77,68,52,68,
+	59,66,61,638,71,157,50,46,69,43,11,24,13,19,10,12,12,20,14,9,
+	20,20,10,10,15,15,12,12,7,19,15,14,13,18,35,19,17,14,8,5,
+	15,17,9,15,14,18,8,10,2173,134,157,68,188,60,170,60,194,62,175,71,
+	148,67,167,78,211,67,156,69,1674,90,174,53,147,89,181,51,174,63,163,80,
+	167,94,128,122,223,153,218,77,200,110,190,73,174,69,145,66,277,143,141,60,
+	136,53,180,57,142,57,158,61,166,112,152,92,26,22,21,28,20,26,30,21,
+	32,27,20,17,23,21,30,22,22,21,27,25,17,27,23,18,39,26,15,21,
+	12,18,18,27,20,18,15,19,11,17,33,12,18,15,19,18,16,26,17,18,
+	9,10,25,22,22,17,20,16,6,16,15,20,14,18,24,335,1517};
+
+static CHuffman s_Huffman;
+static CReferenceHuffman s_Reference;
+static unsigned s_Random = 1;
+static int s_Failed = 0;
+
+static unsigned Random()
+{
+	s_Random ^= s_Random<<13;
+	s_Random ^= s_Random>>17;
+	s_Random ^= s_Random<<5;
+	return s_Random;
+}
+
+static void Fail(const char *pWhat, int Size, int OutputSize)
+{
+	if(s_Failed < 20)
+		dbg_msg("huffman_fuzz", "failed: %s size=%d output_size=%d", pWhat, Size, OutputSize);
+	s_Failed++;
+}
+
+enum
+{
+	KIND_UNIFORM=0,
+	KIND_SNAPSHOT,
+	KIND_TABLE,
+	KIND_RUNS,
+	KIND_RARE,
+	NUM_KINDS,
+};
+
+static void Fill(unsigned char *pData, int Size, int Kind)
+{
+	for(int i = 0; i < Size; i++)
+	{
+		switch(Kind)
+		{
+		case KIND_UNIFORM: pData[i] = Random(); break;
+		// mostly zeros and small packed ints like snapshot deltas
+		case KIND_SNAPSHOT: pData[i] = Random()%4 ? 0 : Random()%8 ? Random()%64 : Random(); break;
+		// the distribution the tree was built for, without the dominating zero
+		case KIND_TABLE:
+		{
+			unsigned Pick = Random()%20000;
+			int s = 1;
+			while(s < 255 && Pick >= gs_aFreqTable[s])
+				Pick -= gs_aFreqTable[s++];
+			pData[i] = s;
+			break;
+		}
+		case KIND_RUNS: pData[i] = i && Random()%8 ? pData[i-1] : Random(); break;
+		// the least frequent bytes have codes longer than the lookup
+		case KIND_RARE: pData[i] = 0xc0+Random()%0x3e; break;
+		}
+	}
+}
+
+static void CheckDecompress(const unsigned char *pStream, int StreamSize, int OutputSize)
+{
+	static unsigned char s_aRef[NET_MAX_PAYLOAD*4], s_aNew[NET_MAX_PAYLOAD*4];
+	int RefSize = s_Reference.Decompress(pStream, StreamSize, s_aRef, OutputSize);
+	int NewSize = s_Huffman.Decompress(pStream, StreamSize, s_aNew, OutputSize);
+	if(RefSize != NewSize)
+		Fail("decompress result", StreamSize, OutputSize);
+	else if(RefSize > 0 && mem_comp(s_aRef, s_aNew, RefSize) != 0)
+		Fail("decompress bytes", StreamSize, OutputSize);
+}
+
+// Compress with a given output size, then the round trip and truncated streams
+static void CheckCompress(const unsigned char *pData, int Size, int OutputSize)
+{
+	static unsigned char s_aRef[NET_MAX_PAYLOAD*4], s_aNew[NET_MAX_PAYLOAD*4], s_aOut[NET_MAX_PAYLOAD*4];
+	int RefSize = s_Reference.Compress(pData, Size, s_aRef, OutputSize);
+	int NewSize = s_Huffman.Compress(pData, Size, s_aNew, OutputSize);
+	if(RefSize != NewSize)
+	{
+		Fail("compress result", Size, OutputSize);
+		return;
+	}
+	if(NewSize < 0)
+		return;
+	if(mem_comp(s_aRef, s_aNew, NewSize) != 0)
+		Fail("compress bytes", Size, OutputSize);
+
+	if(s_Huffman.Decompress(s_aNew, NewSize, s_aOut, Size) != Size || mem_comp(s_aOut, pData, Size) != 0)
+		Fail("round trip", Size, OutputSize);
+
+	CheckDecompress(s_aNew, NewSize, Size);
+	if(Size)
+		CheckDecompress(s_aNew, NewSize, Random()%Size);
+	if(NewSize > 1)
+		CheckDecompress(s_aNew, Random()%NewSize, Size);
+}
+
+// the way CNetBase::SendPacket compresses: the chunks and the token through
+// the encoder, limited to the uncompressed size, against compressing the
+// appended token into the full packet size as before
+static void CheckPacket(const unsigned char *pData, int Size, SECURITY_TOKEN Token)
+{
+	unsigned char aChunks[NET_MAX_PAYLOAD+sizeof(SECURITY_TOKEN)];
+	unsigned char aRef[NET_MAX_PACKETSIZE], aNew[NET_MAX_PACKETSIZE], aOut[NET_MAX_PAYLOAD+sizeof(SECURITY_TOKEN)];
+	int TotalSize = Size;
+	mem_copy(aChunks, pData, Size);
+	if(Token != NET_SECURITY_TOKEN_UNSUPPORTED)
+	{
+		mem_copy(&aChunks[Size], &Token, sizeof(Token));
+		TotalSize += sizeof(Token);
+	}
+
+	int RefSize = s_Reference.Compress(aChunks, TotalSize, aRef, NET_MAX_PACKETSIZE-4);
+	bool RefUsed = RefSize > 0 && RefSize < TotalSize;
+
+	CHuffman::CEncoder Encoder;
+	Encoder.Init(&s_Huffman, aNew, min(TotalSize, NET_MAX_PACKETSIZE-4));
+	Encoder.Write(pData, Size);
+	if(Token != NET_SECURITY_TOKEN_UNSUPPORTED)
+		Encoder.Write(&Token, sizeof(Token));
+	int NewSize = Encoder.Finish();
+	bool NewUsed = NewSize > 0 && NewSize < TotalSize;
+
+	if(RefUsed != NewUsed)
+		Fail("packet compressed or not", TotalSize, NewSize);
+	else if(NewUsed)
+	{
+		if(RefSize != NewSize || mem_comp(aRef, aNew, NewSize) != 0)
+			Fail("packet bytes", TotalSize, NewSize);
+		else if(s_Huffman.Decompress(aNew, NewSize, aOut, sizeof(aOut)) != TotalSize || mem_comp(aOut, aChunks, TotalSize) != 0)
+			Fail("packet round trip", TotalSize, NewSize);
+	}
+}
+
+static void CheckPayload(const unsigned char *pData, int Size)
+{
+	CheckPacket(pData, Size, NET_SECURITY_TOKEN_UNSUPPORTED);
+	CheckPacket(pData, Size, Random());
+	CheckCompress(pData, Size, NET_MAX_PACKETSIZE-4);
+	CheckCompress(pData, Size, Size+1);
+	CheckCompress(pData, Size, 1+Random()%(Size+8));
+}
+
+// records of a dbg_lognetwork dump, type 1 is the chunk data before compression
+static int CheckDump(const char *pFilename)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		dbg_msg("huffman_fuzz", "failed to open '%s'", pFilename);
+		return -1;
+	}
+
+	int Num = 0;
+	int Type, Size;
+	unsigned char aData[NET_MAX_PACKETSIZE];
+	while(io_read(File, &Type, sizeof(Type)) == sizeof(Type) && io_read(File, &Size, sizeof(Size)) == sizeof(Size))
+	{
+		if(Size < 0 || Size > (int)sizeof(aData) || io_read(File, aData, Size) != (unsigned)Size)
+			break;
+		if(Type != 1 || Size > NET_MAX_PAYLOAD)
+			continue;
+		CheckPayload(aData, Size);
+		Num++;
+	}
+	io_close(File);
+	dbg_msg("huffman_fuzz", "checked %d recorded payloads of '%s'", Num, pFilename);
+	return Num;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	s_Huffman.Init(gs_aFreqTable);
+	s_Reference.Init(gs_aFreqTable);
+
+	int Rounds = argc > 1 ? str_toint(argv[1]) : 200000; // ignore_convention
+	for(int i = 2; i < argc; i++) // ignore_convention
+		if(CheckDump(argv[i]) < 0) // ignore_convention
+			return -1;
+
+	unsigned char aData[NET_MAX_PAYLOAD];
+	for(int i = 0; i < Rounds; i++)
+	{
+		// mostly packet sized, sometimes tiny
+		int Size = Random()%4 ? Random()%(NET_MAX_PAYLOAD+1) : Random()%16;
+		Fill(aData, Size, i%NUM_KINDS);
+		CheckPayload(aData, Size);
+
+		// streams that were never compressed
+		unsigned char aStream[256];
+		int StreamSize = Random()%sizeof(aStream);
+		Fill(aStream, StreamSize, KIND_UNIFORM);
+		CheckDecompress(aStream, StreamSize, Random()%(NET_MAX_PAYLOAD+1));
+	}
+
+	if(s_Failed)
+	{
+		dbg_msg("huffman_fuzz", "%d checks failed", s_Failed);
+		return 1;
+	}
+	dbg_msg("huffman_fuzz", "%d random payloads, all checks passed", Rounds);
+	return 0;
+}